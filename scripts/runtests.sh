@@ -65,4 +65,18 @@ for reference_results in ../ref/results/*.res; do
     rm -f "$results"
 done
 
+# In replay mode, the core with the shorter trace keeps replaying it until the
+# other core reaches its target, so it must report more than one replay.
+total_tests=$((total_tests + 1))
+echo -n 'Running test replay.mix2...'
+replays="$(../src/sim -mode 4 -replay 1 ../traces/lbm.mtr.gz ../traces/libq.mtr.gz |
+           awk '/^CORE_0_REPLAYS/ { print $NF }')"
+if [[ -n "$replays" && "$replays" -gt 1 ]]; then
+    echo " $green"'passed'"$reset"
+    passed_tests=$((passed_tests + 1))
+else
+    echo " $red"'failed'"$reset"
+    echo "  $blue"'Expected CORE_0_REPLAYS above 1, got:'"$reset"' '"$replays"
+fi
+
 echo "$blue"'Passed '"$passed_tests"'/'"$total_tests"' tests'"$reset"
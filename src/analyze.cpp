@@ -0,0 +1,482 @@
+// analyze.cpp
+// Defines the functions used to analyze traces without simulating them.
+
+#include "analyze.h"
+#include "core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of bytes in a cache line. */
+extern uint64_t CACHE_LINESIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate the slots of an empty address map.
+ *
+ * @param m The map.
+ * @param num_slots The number of slots (a power of 2).
+ */
+static void addr_map_init(AddrMap *m, uint64_t num_slots)
+{
+    m->slots = (AddrEntry *)calloc(num_slots, sizeof(AddrEntry));
+    m->num_slots = num_slots;
+    m->num_entries = 0;
+}
+
+/**
+ * Find the slot of an address, or the empty slot where it belongs.
+ *
+ * @param slots The slots of the map.
+ * @param num_slots The number of slots (a power of 2).
+ * @param addr The address.
+ * @return The slot.
+ */
+static AddrEntry *addr_map_slot(AddrEntry *slots, uint64_t num_slots,
+                                uint64_t addr)
+{
+    uint64_t index = (addr * 0x9E3779B97F4A7C15ULL) >> 32;
+    for (;; index++)
+    {
+        AddrEntry *e = &slots[index & (num_slots - 1)];
+        if (!e->valid || e->addr == addr)
+        {
+            return e;
+        }
+    }
+}
+
+/**
+ * Find the entry of an address, adding it if it is new.
+ *
+ * @param m The map.
+ * @param addr The address.
+ * @param added Set to whether the address is new.
+ * @return The entry.
+ */
+static AddrEntry *addr_map_get(AddrMap *m, uint64_t addr, bool *added)
+{
+    AddrEntry *e = addr_map_slot(m->slots, m->num_slots, addr);
+    *added = !e->valid;
+    if (e->valid)
+    {
+        return e;
+    }
+
+    // Keep the map at most half full so that probes stay short.
+    if (2 * (m->num_entries + 1) > m->num_slots)
+    {
+        uint64_t num_slots = m->num_slots * 2;
+        AddrEntry *slots = (AddrEntry *)calloc(num_slots, sizeof(AddrEntry));
+        for (uint64_t i = 0; i < m->num_slots; i++)
+        {
+            if (m->slots[i].valid)
+            {
+                *addr_map_slot(slots, num_slots, m->slots[i].addr) =
+                    m->slots[i];
+            }
+        }
+        free(m->slots);
+        m->slots = slots;
+        m->num_slots = num_slots;
+        e = addr_map_slot(m->slots, m->num_slots, addr);
+    }
+
+    e->valid = true;
+    e->addr = addr;
+    m->num_entries++;
+    return e;
+}
+
+/**
+ * Add to the count at an access time of a Fenwick tree.
+ *
+ * @param t The tracker whose tree to update.
+ * @param time The access time, from 0.
+ * @param delta The amount to add.
+ */
+static void reuse_tree_add(ReuseTracker *t, uint64_t time, int delta)
+{
+    for (uint64_t i = time + 1; i <= t->num_times; i += i & (~i + 1))
+    {
+        t->tree[i] += delta;
+    }
+}
+
+/**
+ * Sum the counts of a Fenwick tree before an access time.
+ *
+ * @param t The tracker whose tree to sum.
+ * @param time The access time, from 0.
+ * @return The sum of the counts at times 0 through time - 1.
+ */
+static uint64_t reuse_tree_sum(ReuseTracker *t, uint64_t time)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = time; i > 0; i -= i & (~i + 1))
+    {
+        sum += t->tree[i];
+    }
+    return sum;
+}
+
+/**
+ * Fill a Fenwick tree with a 1 at each of the first count access times.
+ *
+ * @param t The tracker whose tree to fill.
+ * @param count The number of access times marked.
+ */
+static void reuse_tree_fill(ReuseTracker *t, uint64_t count)
+{
+    // Node i covers the times i - lowbit(i) through i - 1.
+    for (uint64_t i = 1; i <= t->num_times; i++)
+    {
+        uint64_t first = i - (i & (~i + 1));
+        t->tree[i] = (count > first) ? ((count < i ? count : i) - first) : 0;
+    }
+}
+
+/**
+ * Initialize a tracker with no accesses.
+ *
+ * @param t The tracker.
+ */
+static void reuse_init(ReuseTracker *t)
+{
+    memset(t, 0, sizeof(ReuseTracker));
+    addr_map_init(&t->map, ANALYZE_INITIAL_SLOTS);
+    t->num_times = ANALYZE_INITIAL_TIMES;
+    t->tree = (uint32_t *)calloc(t->num_times + 1, sizeof(uint32_t));
+}
+
+/**
+ * Renumber the latest access times of the addresses from 0, keeping their
+ * order, once every time of the Fenwick tree has been used. The tree grows
+ * if the addresses fill more than half of it.
+ *
+ * @param t The tracker.
+ */
+static void reuse_compact(ReuseTracker *t)
+{
+    uint64_t *rank = (uint64_t *)calloc(t->num_times, sizeof(uint64_t));
+    for (uint64_t i = 0; i < t->map.num_slots; i++)
+    {
+        if (t->map.slots[i].valid)
+        {
+            rank[t->map.slots[i].last_time] = 1;
+        }
+    }
+
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < t->num_times; i++)
+    {
+        if (rank[i])
+        {
+            rank[i] = count++;
+        }
+    }
+
+    for (uint64_t i = 0; i < t->map.num_slots; i++)
+    {
+        if (t->map.slots[i].valid)
+        {
+            t->map.slots[i].last_time = rank[t->map.slots[i].last_time];
+        }
+    }
+    free(rank);
+
+    if (2 * count > t->num_times)
+    {
+        t->num_times *= 2;
+        free(t->tree);
+        t->tree = (uint32_t *)calloc(t->num_times + 1, sizeof(uint32_t));
+    }
+    reuse_tree_fill(t, count);
+    t->now = count;
+}
+
+/**
+ * Record an access to an address, binning its reuse distance and counting
+ * it in the working set of its window.
+ *
+ * @param t The tracker.
+ * @param addr The line or page accessed.
+ * @param window The window of the access, starting at 1.
+ */
+static void reuse_access(ReuseTracker *t, uint64_t addr, uint64_t window)
+{
+    if (t->now == t->num_times)
+    {
+        reuse_compact(t);
+    }
+
+    bool added;
+    AddrEntry *e = addr_map_get(&t->map, addr, &added);
+    if (added)
+    {
+        t->stat_cold++;
+    }
+    else
+    {
+        // Every address accessed since has its latest access after this
+        // one's.
+        uint64_t distance = reuse_tree_sum(t, t->now) -
+                            reuse_tree_sum(t, e->last_time + 1);
+        unsigned int bin = distance ? 64 - __builtin_clzll(distance) : 0;
+        t->stat_bins[bin]++;
+        reuse_tree_add(t, e->last_time, -1);
+    }
+
+    reuse_tree_add(t, t->now, 1);
+    e->last_time = t->now;
+    t->now++;
+
+    if (e->last_window != window)
+    {
+        e->last_window = window;
+        t->window_addrs++;
+    }
+}
+
+/**
+ * Record the working set of the window that just ended.
+ *
+ * @param ta The analysis of the trace.
+ */
+static void analyze_end_window(TraceAnalysis *ta)
+{
+    if (ta->num_samples == ta->sample_capacity)
+    {
+        ta->sample_capacity = ta->sample_capacity ? 2 * ta->sample_capacity
+                                                  : 64;
+        ta->samples = (WorkingSetSample *)realloc(
+            ta->samples, ta->sample_capacity * sizeof(WorkingSetSample));
+    }
+
+    WorkingSetSample *sample = &ta->samples[ta->num_samples++];
+    sample->inst_end = ta->stat_inst;
+    sample->lines = ta->lines.window_addrs;
+    sample->pages = ta->pages.window_addrs;
+    ta->lines.window_addrs = 0;
+    ta->pages.window_addrs = 0;
+}
+
+/**
+ * Analyze one trace, reading it as a core would.
+ *
+ * @param arg The analysis of the trace.
+ * @return NULL.
+ */
+static void *analyze_trace(void *arg)
+{
+    TraceAnalysis *ta = (TraceAnalysis *)arg;
+    Core *core = core_new(NULL, ta->trace_filename, ta->trace_id);
+    if (core == NULL)
+    {
+        ta->failed = true;
+        return NULL;
+    }
+
+    reuse_init(&ta->lines);
+    reuse_init(&ta->pages);
+    addr_map_init(&ta->inst_lines, ANALYZE_INITIAL_SLOTS);
+
+    uint64_t lines_per_page = PAGE_SIZE / CACHE_LINESIZE;
+    while (!core->trace_done)
+    {
+        bool added;
+        uint64_t window = ta->stat_inst / ta->window + 1;
+        addr_map_get(&ta->inst_lines, core->trace_inst_addr / CACHE_LINESIZE,
+                     &added);
+
+        if (core->trace_inst_type == INST_TYPE_LOAD ||
+            core->trace_inst_type == INST_TYPE_STORE)
+        {
+            uint64_t line_addr = core->trace_ldst_addr / CACHE_LINESIZE;
+            reuse_access(&ta->lines, line_addr, window);
+            reuse_access(&ta->pages, line_addr / lines_per_page, window);
+            if (core->trace_inst_type == INST_TYPE_LOAD)
+            {
+                ta->stat_loads++;
+            }
+            else
+            {
+                ta->stat_stores++;
+            }
+        }
+
+        ta->stat_inst++;
+        if (ta->stat_inst % ta->window == 0)
+        {
+            analyze_end_window(ta);
+        }
+        core_read_trace(core);
+    }
+
+    if (ta->stat_inst % ta->window != 0)
+    {
+        analyze_end_window(ta);
+    }
+
+    core_close_trace(core);
+    free(core->rob);
+    free(core->sb);
+    free(core);
+    return NULL;
+}
+
+/**
+ * Analyze every trace, each on a thread of its own, and wait for them all.
+ *
+ * @param trace_filenames The traces to analyze.
+ * @param num_traces The number of traces.
+ * @param window The number of instructions in a working set window.
+ * @return A pointer to the analyses.
+ */
+Analysis *analyze_traces(const char **trace_filenames,
+                         unsigned int num_traces, uint64_t window)
+{
+    Analysis *a = (Analysis *)calloc(1, sizeof(Analysis));
+    a->traces = (TraceAnalysis *)calloc(num_traces, sizeof(TraceAnalysis));
+    a->num_traces = num_traces;
+
+    for (unsigned int i = 0; i < num_traces; i++)
+    {
+        TraceAnalysis *ta = &a->traces[i];
+        ta->trace_filename = trace_filenames[i];
+        ta->trace_id = i;
+        ta->window = window;
+        if (pthread_create(&ta->thread, NULL, analyze_trace, ta) != 0)
+        {
+            fprintf(stderr, "Error: could not start the analysis of trace "
+                            "%u\n", i);
+            exit(1);
+        }
+    }
+
+    for (unsigned int i = 0; i < num_traces; i++)
+    {
+        pthread_join(a->traces[i].thread, NULL);
+    }
+    return a;
+}
+
+/**
+ * Print the histogram of the reuse distances of a tracker, with the share of
+ * accesses whose distance is below the top of each bin, i.e. the hit rate of
+ * a fully associative LRU cache of that many lines or pages.
+ *
+ * @param t The tracker.
+ * @param header The label of the histogram.
+ */
+static void analyze_print_reuse(ReuseTracker *t, const char *header)
+{
+    unsigned long long total = t->stat_cold;
+    unsigned int last_bin = 0;
+    for (unsigned int i = 0; i < ANALYZE_REUSE_BINS; i++)
+    {
+        total += t->stat_bins[i];
+        if (t->stat_bins[i])
+        {
+            last_bin = i;
+        }
+    }
+
+    printf("\n");
+    printf("%s\n", header);
+    printf("%24s %12s %8s\n", "DISTANCE", "COUNT", "CUM_PERC");
+    printf("%24s %12llu\n", "COLD", t->stat_cold);
+
+    unsigned long long seen = 0;
+    char range[48];
+    for (unsigned int i = 0; i <= last_bin && total > t->stat_cold; i++)
+    {
+        seen += t->stat_bins[i];
+        if (i == 0)
+        {
+            snprintf(range, sizeof(range), "0");
+        }
+        else
+        {
+            unsigned long long low = 1ULL << (i - 1);
+            snprintf(range, sizeof(range), "%llu-%llu", low, 2 * low - 1);
+        }
+        printf("%24s %12llu %8.3f\n", range, t->stat_bins[i],
+               100.0 * (double)seen / (double)total);
+    }
+}
+
+/**
+ * Print the footprint, reuse distance histograms and working sets of every
+ * trace.
+ *
+ * @param a The analyses to print.
+ */
+void analyze_print_stats(Analysis *a)
+{
+    char label[48];
+
+    for (unsigned int i = 0; i < a->num_traces; i++)
+    {
+        TraceAnalysis *ta = &a->traces[i];
+        if (ta->failed)
+        {
+            fprintf(stderr, "Error: could not open trace %s\n",
+                    ta->trace_filename);
+            continue;
+        }
+
+        uint64_t inst_lines = ta->inst_lines.num_entries;
+        uint64_t data_lines = ta->lines.map.num_entries;
+
+        printf("\n");
+        snprintf(label, sizeof(label), "TRACE_%u_FILE", i);
+        printf("%-20s\t\t : %s\n", label, ta->trace_filename);
+        snprintf(label, sizeof(label), "TRACE_%u_INST", i);
+        printf("%-20s\t\t : %10llu\n", label, ta->stat_inst);
+        snprintf(label, sizeof(label), "TRACE_%u_LOADS", i);
+        printf("%-20s\t\t : %10llu\n", label, ta->stat_loads);
+        snprintf(label, sizeof(label), "TRACE_%u_STORES", i);
+        printf("%-20s\t\t : %10llu\n", label, ta->stat_stores);
+        snprintf(label, sizeof(label), "TRACE_%u_INST_LINES", i);
+        printf("%-20s\t\t : %10llu\n", label, (unsigned long long)inst_lines);
+        snprintf(label, sizeof(label), "TRACE_%u_INST_KB", i);
+        printf("%-20s\t\t : %10.3f\n", label,
+               (double)(inst_lines * CACHE_LINESIZE) / 1024.0);
+        snprintf(label, sizeof(label), "TRACE_%u_DATA_LINES", i);
+        printf("%-20s\t\t : %10llu\n", label, (unsigned long long)data_lines);
+        snprintf(label, sizeof(label), "TRACE_%u_DATA_PAGES", i);
+        printf("%-20s\t\t : %10llu\n", label,
+               (unsigned long long)ta->pages.map.num_entries);
+        snprintf(label, sizeof(label), "TRACE_%u_DATA_KB", i);
+        printf("%-20s\t\t : %10.3f\n", label,
+               (double)(data_lines * CACHE_LINESIZE) / 1024.0);
+
+        snprintf(label, sizeof(label), "TRACE_%u_LINE_REUSE (lines)", i);
+        analyze_print_reuse(&ta->lines, label);
+        snprintf(label, sizeof(label), "TRACE_%u_PAGE_REUSE (pages)", i);
+        analyze_print_reuse(&ta->pages, label);
+
+        printf("\n");
+        printf("TRACE_%u_WORKING_SET (windows of %llu instructions)\n", i,
+               (unsigned long long)ta->window);
+        printf("%8s %14s %10s %10s %12s\n", "WINDOW", "INST_END", "LINES",
+               "PAGES", "DATA_KB");
+        for (uint64_t j = 0; j < ta->num_samples; j++)
+        {
+            WorkingSetSample *sample = &ta->samples[j];
+            printf("%8llu %14llu %10llu %10llu %12.3f\n",
+                   (unsigned long long)j, sample->inst_end,
+                   (unsigned long long)sample->lines,
+                   (unsigned long long)sample->pages,
+                   (double)(sample->lines * CACHE_LINESIZE) / 1024.0);
+        }
+    }
+}
@@ -0,0 +1,159 @@
+// analyze.h
+// Declares the trace analyzer, which characterizes traces without simulating
+// them.
+//
+// Each trace is read through the cores' own trace reader on a thread of its
+// own. The analyzer reports the instruction and data footprint, the
+// histograms of the reuse distances of data accesses at line and page
+// granularity, and the data working set of every window of instructions.
+//
+// The reuse distance of an access is the number of distinct lines (or pages)
+// accessed since the last access to the same one, so an access hits a fully
+// associative LRU cache of N lines exactly when its distance is below N. It
+// is found in O(log n) time as in Bennett and Kruskal: a Fenwick tree over
+// access times marks the time of the latest access to every line, and the
+// distance is the number of marks after the previous access to the line. The
+// times are renumbered whenever the tree fills up, so its size follows the
+// number of distinct lines rather than the length of the trace.
+
+#ifndef __ANALYZE_H__
+#define __ANALYZE_H__
+
+#include "types.h"
+#include <pthread.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The number of reuse distance bins: distance 0, then one bin for each power
+ * of two [2^(i-1), 2^i).
+ */
+#define ANALYZE_REUSE_BINS 65
+
+/** The initial number of access times of a Fenwick tree (a power of 2). */
+#define ANALYZE_INITIAL_TIMES (1 << 16)
+
+/** The initial number of slots of an address map (a power of 2). */
+#define ANALYZE_INITIAL_SLOTS (1 << 12)
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** What the analyzer remembers about one line or page. */
+typedef struct AddrEntry
+{
+    bool valid;
+    uint64_t addr;
+
+    /** The time of the latest access to the address, in the Fenwick tree. */
+    uint64_t last_time;
+
+    /** The window of the latest access to the address, starting at 1. */
+    uint64_t last_window;
+} AddrEntry;
+
+/** An open-addressing hash table of lines or pages. */
+typedef struct AddrMap
+{
+    AddrEntry *slots;
+
+    /** The number of slots (a power of 2), and how many are used. */
+    uint64_t num_slots;
+    uint64_t num_entries;
+} AddrMap;
+
+/** The reuse distances and working set of a stream of addresses. */
+typedef struct ReuseTracker
+{
+    AddrMap map;
+
+    /**
+     * A Fenwick tree with a 1 at the time of the latest access to every
+     * address, indexed from 1.
+     */
+    uint32_t *tree;
+    uint64_t num_times;
+    uint64_t now;
+
+    /** The number of first accesses, and the other accesses by distance. */
+    unsigned long long stat_cold;
+    unsigned long long stat_bins[ANALYZE_REUSE_BINS];
+
+    /** The number of distinct addresses accessed in the current window. */
+    uint64_t window_addrs;
+} ReuseTracker;
+
+/** The working set of one window of instructions. */
+typedef struct WorkingSetSample
+{
+    /** The number of instructions up to the end of the window. */
+    unsigned long long inst_end;
+
+    uint64_t lines;
+    uint64_t pages;
+} WorkingSetSample;
+
+/** The analysis of one trace. */
+typedef struct TraceAnalysis
+{
+    const char *trace_filename;
+    unsigned int trace_id;
+    pthread_t thread;
+
+    /** The number of instructions in a working set window. */
+    uint64_t window;
+
+    /** Whether the trace could not be opened. */
+    bool failed;
+
+    unsigned long long stat_inst;
+    unsigned long long stat_loads;
+    unsigned long long stat_stores;
+
+    /** The data accesses, at line and page granularity. */
+    ReuseTracker lines;
+    ReuseTracker pages;
+
+    /** The lines instructions are fetched from. */
+    AddrMap inst_lines;
+
+    /** The data working set of each window so far. */
+    WorkingSetSample *samples;
+    uint64_t num_samples;
+    uint64_t sample_capacity;
+} TraceAnalysis;
+
+/** The analyses of a set of traces. */
+typedef struct Analysis
+{
+    TraceAnalysis *traces;
+    unsigned int num_traces;
+} Analysis;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Analyze every trace, each on a thread of its own, and wait for them all.
+ *
+ * @param trace_filenames The traces to analyze.
+ * @param num_traces The number of traces.
+ * @param window The number of instructions in a working set window.
+ * @return A pointer to the analyses.
+ */
+Analysis *analyze_traces(const char **trace_filenames,
+                         unsigned int num_traces, uint64_t window);
+
+/**
+ * Print the footprint, reuse distance histograms and working sets of every
+ * trace.
+ *
+ * @param a The analyses to print.
+ */
+void analyze_print_stats(Analysis *a);
+
+#endif // __ANALYZE_H__
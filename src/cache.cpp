@@ -21,7 +21,7 @@
  * 
  * This can be used as a timestamp for implementing the LRU replacement policy.
  */
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
 
 /**
  * For static way partitioning, the quota of ways in each set that can be
@@ -34,11 +34,13 @@ extern uint64_t current_cycle;
 extern unsigned int SWP_CORE0_WAYS;
 
 //Part F - Dynamic Way Partitioning Parameters
-uint64_t DWP_CORE0_WAYS = 0;
-uint64_t DWP_CORE1_WAYS = 0;
-uint64_t DWP_SWITCH = 0;
-float MISS_RATE_CORE_0 = 0;
-float MISS_RATE_CORE_1 = 0;
+//Per thread, since the alone runs of the fairness metrics simulate their own
+//L2 caches on threads of their own
+thread_local uint64_t DWP_CORE0_WAYS = 0;
+thread_local uint64_t DWP_CORE1_WAYS = 0;
+thread_local uint64_t DWP_SWITCH = 0;
+thread_local float MISS_RATE_CORE_0 = 0;
+thread_local float MISS_RATE_CORE_1 = 0;
 
 ///////////////////////////////////////////////////////////////////////////////
 //                           FUNCTION DEFINITIONS                            //
@@ -411,6 +413,150 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
 }
 
 
+/**
+ * Reconstruct the address of the line most recently evicted by
+ * cache_install(), i.e. c->last_evicted_line.
+ * 
+ * The victim came from the same set as the line that replaced it, so the set
+ * index is recovered from that line's address.
+ * 
+ * @param c The cache that performed the eviction.
+ * @param line_addr The address of the line whose install caused the eviction
+ *                  (in units of the cache line size).
+ * @return The address of the evicted line (in units of the cache line size).
+ */
+uint64_t cache_evicted_line_addr(Cache *c, uint64_t line_addr)
+{
+    int index_bits = __builtin_log2(c->number_of_sets);
+    uint64_t set_index = extract_index(line_addr, index_bits);
+    return (c->last_evicted_line.tag << index_bits) | set_index;
+}
+
+/**
+ * Invalidate the cache line with the given address, if it is resident.
+ * 
+ * This is used for back-invalidations from an inclusive outer cache. It does
+ * not count as an access and does not update the statistics.
+ * 
+ * @param c The cache to invalidate the line in.
+ * @param line_addr The address of the cache line to invalidate (in units of
+ *                  the cache line size).
+ * @param was_dirty Set to whether the invalidated line was dirty. May be NULL.
+ * @return Whether the line was resident.
+ */
+bool cache_invalidate(Cache *c, uint64_t line_addr, bool *was_dirty)
+{
+    uint64_t set_index = extract_index(line_addr, __builtin_log2(c->number_of_sets));
+    uint64_t tag = extract_tag(line_addr, __builtin_log2(c->number_of_sets));
+
+    CacheSet* set = &c->sets[set_index];
+
+    for(uint64_t i=0; i<c->number_of_ways; i++){
+        CacheLine* line = &set->lines[i];
+        if(line->valid && line->tag == tag){
+            #ifdef DEBUG
+                printf("\t\tBack-invalidating line (index: %ld, dirty: %d)\n", set_index, line->dirty);
+            #endif
+
+            if(was_dirty){
+                *was_dirty = line->dirty;
+            }
+            line->valid = false;
+            line->dirty = false;
+            return true;
+        }
+    }
+
+    if(was_dirty){
+        *was_dirty = false;
+    }
+    return false;
+}
+
+/**
+ * Move the cache line with the given address to the LRU position of its set,
+ * so that it is the next victim unless it is accessed again first.
+ * 
+ * @param c The cache containing the line.
+ * @param line_addr The address of the cache line to demote (in units of the
+ *                  cache line size).
+ */
+void cache_demote(Cache *c, uint64_t line_addr)
+{
+    uint64_t set_index = extract_index(line_addr, __builtin_log2(c->number_of_sets));
+    uint64_t tag = extract_tag(line_addr, __builtin_log2(c->number_of_sets));
+
+    CacheSet* set = &c->sets[set_index];
+
+    for(uint64_t i=0; i<c->number_of_ways; i++){
+        CacheLine* line = &set->lines[i];
+        if(line->valid && line->tag == tag){
+            //Older than any timestamp a real access can produce
+            line->last_access_time = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * Charge a cache with read hits to a resident line that were not simulated
+ * one by one, leaving it as if each had called cache_access().
+ * 
+ * @param c The cache containing the line.
+ * @param line_addr The address of the cache line that was hit (in units of
+ *                  the cache line size).
+ * @param count The number of read hits.
+ * @param last_cycle The cycle of the last of the hits.
+ */
+void cache_charge_hits(Cache *c, uint64_t line_addr, unsigned long long count,
+                       uint64_t last_cycle)
+{
+    uint64_t set_index = extract_index(line_addr, __builtin_log2(c->number_of_sets));
+    uint64_t tag = extract_tag(line_addr, __builtin_log2(c->number_of_sets));
+
+    CacheSet* set = &c->sets[set_index];
+    c->stat_read_access += count;
+
+    for(uint64_t i=0; i<c->number_of_ways; i++){
+        CacheLine* line = &set->lines[i];
+        if(line->valid && line->tag == tag){
+            line->last_access_time = last_cycle;
+            return;
+        }
+    }
+}
+
+/**
+ * Invalidate every line of a cache, as on a flush at a context switch.
+ * 
+ * The caller must write back the dirty lines, whose addresses are returned.
+ * 
+ * @param c The cache to flush.
+ * @param dirty_lines Set to the addresses of the dirty lines (in units of
+ *                    the cache line size). Must have room for every line of
+ *                    the cache.
+ * @return The number of dirty lines.
+ */
+uint64_t cache_flush(Cache *c, uint64_t *dirty_lines)
+{
+    int index_bits = __builtin_log2(c->number_of_sets);
+    uint64_t dirty_count = 0;
+
+    for(uint64_t s=0; s<c->number_of_sets; s++){
+        for(uint64_t i=0; i<c->number_of_ways; i++){
+            CacheLine* line = &c->sets[s].lines[i];
+            if(line->valid && line->dirty){
+                dirty_lines[dirty_count++] = (line->tag << index_bits) | s;
+                c->stat_dirty_evicts++;
+            }
+            line->valid = false;
+            line->dirty = false;
+        }
+    }
+
+    return dirty_count;
+}
+
 /**
  * Print the statistics of the given cache.
  * 
@@ -446,3 +592,38 @@ void cache_print_stats(Cache *c, const char *header)
     printf("%s_WRITE_MISS_PERC \t\t : %10.3f\n", header, write_miss_percent);
     printf("%s_DIRTY_EVICTS    \t\t : %10llu\n", header, c->stat_dirty_evicts);
 }
+
+/**
+ * Add the statistics of the given cache to a registry, under the names
+ * cache_print_stats() prints them with.
+ *
+ * @param c The cache to collect the statistics of.
+ * @param header A label for the cache, which is used as a prefix for each
+ *               statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void cache_collect_stats(Cache *c, const char *header, StatsRegistry *reg)
+{
+    double read_miss_percent = 0.0;
+    double write_miss_percent = 0.0;
+
+    if (c->stat_read_access)
+    {
+        read_miss_percent = 100.0 * (double)(c->stat_read_miss) /
+                            (double)(c->stat_read_access);
+    }
+
+    if (c->stat_write_access)
+    {
+        write_miss_percent = 100.0 * (double)(c->stat_write_miss) /
+                             (double)(c->stat_write_access);
+    }
+
+    stats_add_count(reg, header, "READ_ACCESS", c->stat_read_access);
+    stats_add_count(reg, header, "WRITE_ACCESS", c->stat_write_access);
+    stats_add_count(reg, header, "READ_MISS", c->stat_read_miss);
+    stats_add_count(reg, header, "WRITE_MISS", c->stat_write_miss);
+    stats_add_real(reg, header, "READ_MISS_PERC", read_miss_percent);
+    stats_add_real(reg, header, "WRITE_MISS_PERC", write_miss_percent);
+    stats_add_count(reg, header, "DIRTY_EVICTS", c->stat_dirty_evicts);
+}
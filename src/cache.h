@@ -10,6 +10,7 @@
 #define __CACHE_H__
 
 #include "types.h"
+#include "stats.h"
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
@@ -221,6 +222,70 @@ void cache_install(Cache *c, uint64_t line_addr, bool is_write,
 unsigned int cache_find_victim(Cache *c, unsigned int set_index,
                                unsigned int core_id);
 
+/**
+ * Reconstruct the address of the line most recently evicted by
+ * cache_install(), i.e. c->last_evicted_line.
+ * 
+ * The victim came from the same set as the line that replaced it, so the set
+ * index is recovered from that line's address.
+ * 
+ * @param c The cache that performed the eviction.
+ * @param line_addr The address of the line whose install caused the eviction
+ *                  (in units of the cache line size).
+ * @return The address of the evicted line (in units of the cache line size).
+ */
+uint64_t cache_evicted_line_addr(Cache *c, uint64_t line_addr);
+
+/**
+ * Invalidate the cache line with the given address, if it is resident.
+ * 
+ * This is used for back-invalidations from an inclusive outer cache. It does
+ * not count as an access and does not update the statistics.
+ * 
+ * @param c The cache to invalidate the line in.
+ * @param line_addr The address of the cache line to invalidate (in units of
+ *                  the cache line size).
+ * @param was_dirty Set to whether the invalidated line was dirty. May be NULL.
+ * @return Whether the line was resident.
+ */
+bool cache_invalidate(Cache *c, uint64_t line_addr, bool *was_dirty);
+
+/**
+ * Move the cache line with the given address to the LRU position of its set,
+ * so that it is the next victim unless it is accessed again first.
+ * 
+ * @param c The cache containing the line.
+ * @param line_addr The address of the cache line to demote (in units of the
+ *                  cache line size).
+ */
+void cache_demote(Cache *c, uint64_t line_addr);
+
+/**
+ * Charge a cache with read hits to a resident line that were not simulated
+ * one by one, leaving it as if each had called cache_access().
+ * 
+ * @param c The cache containing the line.
+ * @param line_addr The address of the cache line that was hit (in units of
+ *                  the cache line size).
+ * @param count The number of read hits.
+ * @param last_cycle The cycle of the last of the hits.
+ */
+void cache_charge_hits(Cache *c, uint64_t line_addr, unsigned long long count,
+                       uint64_t last_cycle);
+
+/**
+ * Invalidate every line of a cache, as on a flush at a context switch.
+ * 
+ * The caller must write back the dirty lines, whose addresses are returned.
+ * 
+ * @param c The cache to flush.
+ * @param dirty_lines Set to the addresses of the dirty lines (in units of
+ *                    the cache line size). Must have room for every line of
+ *                    the cache.
+ * @return The number of dirty lines.
+ */
+uint64_t cache_flush(Cache *c, uint64_t *dirty_lines);
+
 /**
  * Print the statistics of the given cache.
  * 
@@ -232,4 +297,15 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
  */
 void cache_print_stats(Cache *c, const char *label);
 
+/**
+ * Add the statistics of the given cache to a registry, under the names
+ * cache_print_stats() prints them with.
+ *
+ * @param c The cache to collect the statistics of.
+ * @param label A label for the cache, which is used as a prefix for each
+ *              statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void cache_collect_stats(Cache *c, const char *label, StatsRegistry *reg);
+
 #endif // __CACHE_H__
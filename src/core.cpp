@@ -6,16 +6,30 @@
 // Defines the functions for the CPU cores.
 
 #include "core.h"
+#include "selfprof.h"
 #include <stdio.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
+extern unsigned int CORE_ROB_SIZE;
+extern unsigned int CORE_ISSUE_WIDTH;
+extern unsigned int CORE_LQ_SIZE;
+extern unsigned int CORE_SB_SIZE;
+extern bool CORE_REPLAY;
+extern unsigned long long CORE_INST_TARGET;
 
 int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
 ssize_t trace_read(Core *core, void *buf, size_t size);
+bool core_read_record(Core *core, uint32_t *inst_addr, uint8_t *inst_type,
+                      uint32_t *ldst_addr);
+void core_cycle_ooo(Core *core);
+void core_drain_stores(Core *core);
+bool core_buffer_store(Core *core, uint64_t addr, uint64_t pc);
+bool core_forward_load(Core *core, uint64_t addr);
 
 Core *core_new(MemorySystem *memsys, const char *trace_filename,
                unsigned int core_id)
@@ -30,10 +44,21 @@ Core *core_new(MemorySystem *memsys, const char *trace_filename,
     Core *core = (Core *)calloc(1, sizeof(Core));
     core->core_id = core_id;
     core->memsys = memsys;
+    core->trace_filename = trace_filename;
     core->trace_fd = trace_fd;
     core->pid = pid;
     core->read_buf_offset = 0;
     core->read_buf_left = 0;
+    core->inst_target = CORE_INST_TARGET;
+    if (CORE_ROB_SIZE)
+    {
+        core->rob = (ROBEntry *)calloc(CORE_ROB_SIZE, sizeof(ROBEntry));
+    }
+    if (CORE_SB_SIZE)
+    {
+        core->sb = (StoreBufferEntry *)calloc(CORE_SB_SIZE,
+                                              sizeof(StoreBufferEntry));
+    }
 
     core_read_trace(core);
     return core;
@@ -46,12 +71,43 @@ void core_cycle(Core *core)
         return;
     }
 
+    if (CORE_ROB_SIZE)
+    {
+        core_cycle_ooo(core);
+        return;
+    }
+
+    // Buffered stores keep draining while the core waits, and after the
+    // trace ends.
+    if (CORE_SB_SIZE)
+    {
+        core_drain_stores(core);
+        if (core->trace_done)
+        {
+            if (core->sb_count == 0)
+            {
+                core->done = true;
+                core->done_inst_count = core->inst_count;
+                core->done_cycle_count = current_cycle;
+            }
+            return;
+        }
+    }
+
     // If core is snoozing on DRAM hits, return.
     if (current_cycle <= core->snooze_end_cycle)
     {
         return;
     }
 
+    // A store cannot complete until the store buffer has room for it.
+    if (CORE_SB_SIZE && core->trace_inst_type == INST_TYPE_STORE &&
+        core->sb_count >= CORE_SB_SIZE)
+    {
+        core->stat_sb_full_cycles++;
+        return;
+    }
+
     core->inst_count++;
 
     uint64_t ifetch_delay = 0;
@@ -59,7 +115,8 @@ void core_cycle(Core *core)
     uint64_t bubble_cycles = 0;
 
     ifetch_delay = memsys_access(core->memsys, core->trace_inst_addr,
-                                 ACCESS_TYPE_IFETCH, core->core_id);
+                                 ACCESS_TYPE_IFETCH, core->core_id,
+                                 core->trace_inst_addr);
     if (ifetch_delay > 1)
     {
         bubble_cycles += (ifetch_delay - 1);
@@ -67,8 +124,16 @@ void core_cycle(Core *core)
 
     if (core->trace_inst_type == INST_TYPE_LOAD)
     {
-        ld_delay = memsys_access(core->memsys, core->trace_ldst_addr,
-                                 ACCESS_TYPE_LOAD, core->core_id);
+        if (core_forward_load(core, core->trace_ldst_addr))
+        {
+            ld_delay = 1;
+        }
+        else
+        {
+            ld_delay = memsys_access(core->memsys, core->trace_ldst_addr,
+                                     ACCESS_TYPE_LOAD, core->core_id,
+                                     core->trace_inst_addr);
+        }
     }
     if (ld_delay > 1)
     {
@@ -77,8 +142,17 @@ void core_cycle(Core *core)
 
     if (core->trace_inst_type == INST_TYPE_STORE)
     {
-        memsys_access(core->memsys, core->trace_ldst_addr, ACCESS_TYPE_STORE,
-                      core->core_id);
+        if (CORE_SB_SIZE)
+        {
+            core_buffer_store(core, core->trace_ldst_addr,
+                              core->trace_inst_addr);
+        }
+        else
+        {
+            memsys_access(core->memsys, core->trace_ldst_addr,
+                          ACCESS_TYPE_STORE, core->core_id,
+                          core->trace_inst_addr);
+        }
     }
     // We don't incur bubbles for store misses.
 
@@ -90,31 +164,305 @@ void core_cycle(Core *core)
     core_read_trace(core);
 }
 
+/**
+ * Simulate one cycle of an out-of-order core.
+ *
+ * Up to CORE_ISSUE_WIDTH finished instructions retire in order from the head
+ * of the ROB. Then up to CORE_ISSUE_WIDTH instructions are fetched from the
+ * trace and dispatched, each executing as soon as it enters the ROB. The
+ * trace carries no register dependences, so loads issue without waiting for
+ * older ones, and misses overlap until the ROB or load queue fills. An
+ * instruction fetch that misses stalls the front end until it returns.
+ * With a store buffer, stores retire into it and retirement stalls while it
+ * is full.
+ *
+ * @param core The core to simulate.
+ */
+void core_cycle_ooo(Core *core)
+{
+    if (CORE_SB_SIZE)
+    {
+        core_drain_stores(core);
+    }
+
+    for (unsigned int i = 0; i < CORE_ISSUE_WIDTH && core->rob_count; i++)
+    {
+        ROBEntry *head = &core->rob[core->rob_head];
+        if (head->done_cycle > current_cycle)
+        {
+            break;
+        }
+        if (head->is_store && !core_buffer_store(core, head->addr, head->pc))
+        {
+            core->stat_sb_full_cycles++;
+            break;
+        }
+        if (head->is_load)
+        {
+            core->lq_count--;
+        }
+        core->rob_head = (core->rob_head + 1) % CORE_ROB_SIZE;
+        core->rob_count--;
+        core->inst_count++;
+    }
+
+    if (core->trace_done)
+    {
+        if (core->rob_count == 0 && core->sb_count == 0)
+        {
+            core->done = true;
+            core->done_inst_count = core->inst_count;
+            core->done_cycle_count = current_cycle;
+        }
+        return;
+    }
+
+    for (unsigned int i = 0; i < CORE_ISSUE_WIDTH && !core->trace_done; i++)
+    {
+        if (!core->fetched)
+        {
+            uint64_t ifetch_delay = memsys_access(
+                core->memsys, core->trace_inst_addr, ACCESS_TYPE_IFETCH,
+                core->core_id, core->trace_inst_addr);
+            core->fetched = true;
+            if (ifetch_delay > 1)
+            {
+                core->fetch_ready_cycle = current_cycle + ifetch_delay - 1;
+            }
+        }
+        if (current_cycle < core->fetch_ready_cycle)
+        {
+            break;
+        }
+
+        bool is_load = (core->trace_inst_type == INST_TYPE_LOAD);
+        if (core->rob_count >= CORE_ROB_SIZE)
+        {
+            core->stat_rob_full_cycles++;
+            break;
+        }
+        if (is_load && core->lq_count >= CORE_LQ_SIZE)
+        {
+            core->stat_lq_full_cycles++;
+            break;
+        }
+
+        ROBEntry *entry =
+            &core->rob[(core->rob_head + core->rob_count) % CORE_ROB_SIZE];
+        entry->done_cycle = current_cycle + 1;
+        entry->is_load = is_load;
+        entry->is_store = false;
+        core->rob_count++;
+
+        if (is_load)
+        {
+            uint64_t ld_delay = 1;
+            if (!core_forward_load(core, core->trace_ldst_addr))
+            {
+                ld_delay = memsys_access(core->memsys, core->trace_ldst_addr,
+                                         ACCESS_TYPE_LOAD, core->core_id,
+                                         core->trace_inst_addr);
+            }
+            core->lq_count++;
+            if (ld_delay > 1)
+            {
+                // Misses issue in order, so their busy periods are merged
+                // against the end of the last one.
+                uint64_t done = current_cycle + ld_delay;
+                entry->done_cycle = done;
+                core->stat_miss_cycles += ld_delay;
+                if (done > core->miss_busy_until)
+                {
+                    uint64_t from = (current_cycle > core->miss_busy_until)
+                                        ? current_cycle
+                                        : core->miss_busy_until;
+                    core->stat_miss_busy_cycles += done - from;
+                    core->miss_busy_until = done;
+                }
+            }
+        }
+
+        // As in the in-order core, stores do not wait for their misses.
+        // With a store buffer they are written once they retire.
+        if (core->trace_inst_type == INST_TYPE_STORE && CORE_SB_SIZE)
+        {
+            entry->is_store = true;
+            entry->addr = core->trace_ldst_addr;
+            entry->pc = core->trace_inst_addr;
+        }
+        else if (core->trace_inst_type == INST_TYPE_STORE)
+        {
+            memsys_access(core->memsys, core->trace_ldst_addr,
+                          ACCESS_TYPE_STORE, core->core_id,
+                          core->trace_inst_addr);
+        }
+
+        core->fetched = false;
+        core_read_trace(core);
+    }
+}
+
+/**
+ * Write buffered stores to the memory system. As under TSO, stores are
+ * written one at a time in program order; the next starts once the previous
+ * one's access completes.
+ *
+ * @param core The core whose store buffer to drain.
+ */
+void core_drain_stores(Core *core)
+{
+    while (core->sb_count)
+    {
+        StoreBufferEntry *head = &core->sb[core->sb_head];
+        if (!core->sb_writing)
+        {
+            uint64_t delay = memsys_access(core->memsys, head->addr,
+                                           ACCESS_TYPE_STORE, core->core_id,
+                                           head->pc);
+            core->sb_writing = true;
+            core->sb_write_end = current_cycle + (delay ? delay : 1);
+            core->stat_sb_write_cycles += core->sb_write_end - current_cycle;
+            core->stat_sb_stores++;
+        }
+        if (core->sb_write_end > current_cycle)
+        {
+            return;
+        }
+
+        core->sb_writing = false;
+        core->sb_head = (core->sb_head + 1) % CORE_SB_SIZE;
+        core->sb_count--;
+    }
+}
+
+/**
+ * Place a store at the tail of the store buffer.
+ *
+ * @param core The core executing the store.
+ * @param addr The address stored to.
+ * @param pc The PC of the store.
+ * @return Whether there was room for the store.
+ */
+bool core_buffer_store(Core *core, uint64_t addr, uint64_t pc)
+{
+    if (core->sb_count >= CORE_SB_SIZE)
+    {
+        return false;
+    }
+
+    StoreBufferEntry *entry =
+        &core->sb[(core->sb_head + core->sb_count) % CORE_SB_SIZE];
+    entry->addr = addr;
+    entry->pc = pc;
+    core->sb_count++;
+    return true;
+}
+
+/**
+ * Check whether a load can take its data from an older store to the same
+ * address instead of accessing the memory system. The store may still be in
+ * the ROB of an out-of-order core, or already in the store buffer.
+ *
+ * @param core The core executing the load.
+ * @param addr The address loaded from.
+ * @return Whether the load was forwarded.
+ */
+bool core_forward_load(Core *core, uint64_t addr)
+{
+    // The load itself is not a store, so the whole ROB can be searched.
+    for (unsigned int i = 0; i < core->rob_count; i++)
+    {
+        ROBEntry *entry = &core->rob[(core->rob_head + i) % CORE_ROB_SIZE];
+        if (entry->is_store && entry->addr == addr)
+        {
+            core->stat_sb_forwards++;
+            return true;
+        }
+    }
+
+    for (unsigned int i = 0; i < core->sb_count; i++)
+    {
+        if (core->sb[(core->sb_head + i) % CORE_SB_SIZE].addr == addr)
+        {
+            core->stat_sb_forwards++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool core_read_record(Core *core, uint32_t *inst_addr, uint8_t *inst_type,
+                      uint32_t *ldst_addr)
+{
+    return trace_read(core, inst_addr, sizeof(*inst_addr)) ==
+               sizeof(*inst_addr) &&
+           trace_read(core, inst_type, sizeof(*inst_type)) ==
+               sizeof(*inst_type) &&
+           trace_read(core, ldst_addr, sizeof(*ldst_addr)) ==
+               sizeof(*ldst_addr);
+}
+
 void core_read_trace(Core *core)
 {
     uint32_t inst_addr;
     uint8_t inst_type;
     uint32_t ldst_addr;
+    uint64_t prof_start = selfprof_begin(SELFPROF_DECODE);
+
+    bool read_ok = core_read_record(core, &inst_addr, &inst_type,
+                                    &ldst_addr);
+
+    // In replay mode, the trace starts over from its first record. The first
+    // pass sets the target if none was given.
+    if (!read_ok && CORE_REPLAY && core->trace_records > 0)
+    {
+        if (core->inst_target == 0)
+        {
+            core->inst_target = core->trace_records;
+        }
+        core_close_trace(core);
+        core->read_buf_offset = 0;
+        core->read_buf_left = 0;
+        if (open_gunzip_pipe(core->trace_filename, &core->trace_fd,
+                             &core->pid) == 0)
+        {
+            core->stat_replays++;
+            read_ok = core_read_record(core, &inst_addr, &inst_type,
+                                       &ldst_addr);
+        }
+    }
 
-    if (trace_read(core, &inst_addr, sizeof(inst_addr)) !=
-            sizeof(inst_addr) ||
-        trace_read(core, &inst_type, sizeof(inst_type)) !=
-            sizeof(inst_type) ||
-        trace_read(core, &ldst_addr, sizeof(ldst_addr)) !=
-            sizeof(ldst_addr))
+    if (read_ok)
     {
-        core->done = true;
-        core->done_inst_count = core->inst_count;
-        core->done_cycle_count = current_cycle;
+        core->trace_records++;
+    }
+    else
+    {
+        // An out-of-order core finishes once its ROB drains, and a core with
+        // a store buffer once its stores are written.
+        core->trace_done = true;
+        if (CORE_ROB_SIZE == 0 && CORE_SB_SIZE == 0)
+        {
+            core->done = true;
+            core->done_inst_count = core->inst_count;
+            core->done_cycle_count = current_cycle;
+        }
     }
 
     core->trace_inst_addr = inst_addr;
     core->trace_inst_type = inst_type;
     core->trace_ldst_addr = ldst_addr;
+    selfprof_end(SELFPROF_DECODE, prof_start);
 }
 
 void core_print_stats(Core *core)
 {
+    Core *live = core;
+    if (core->frozen_copy != NULL)
+    {
+        core = core->frozen_copy;
+    }
+
     double ipc = 0.0;
     if (core->done_cycle_count)
     {
@@ -129,16 +477,149 @@ void core_print_stats(Core *core)
            core->done_cycle_count);
     printf("CORE_%01d_IPC          \t\t : %10.3f\n", core->core_id, ipc);
 
+    if (CORE_ROB_SIZE)
+    {
+        double mlp = 0.0;
+        if (core->stat_miss_busy_cycles)
+        {
+            mlp = (double)(core->stat_miss_cycles) /
+                  (double)(core->stat_miss_busy_cycles);
+        }
+        printf("CORE_%01d_MLP          \t\t : %10.3f\n", core->core_id, mlp);
+        printf("CORE_%01d_ROB_FULL     \t\t : %10llu\n", core->core_id,
+               core->stat_rob_full_cycles);
+        printf("CORE_%01d_LQ_FULL      \t\t : %10llu\n", core->core_id,
+               core->stat_lq_full_cycles);
+    }
+
+    if (CORE_REPLAY)
+    {
+        printf("CORE_%01d_REPLAYS      \t\t : %10llu\n", core->core_id,
+               live->stat_replays);
+    }
+
+    if (CORE_SB_SIZE)
+    {
+        double avg_write = 0.0;
+        if (core->stat_sb_stores)
+        {
+            avg_write = (double)(core->stat_sb_write_cycles) /
+                        (double)(core->stat_sb_stores);
+        }
+        printf("CORE_%01d_SB_FULL      \t\t : %10llu\n", core->core_id,
+               core->stat_sb_full_cycles);
+        printf("CORE_%01d_SB_FORWARDS  \t\t : %10llu\n", core->core_id,
+               core->stat_sb_forwards);
+        printf("CORE_%01d_SB_WRITE_AVG \t\t : %10.3f\n", core->core_id,
+               avg_write);
+    }
+
+    core_close_trace(live);
+}
+
+/**
+ * Add the instructions, cycles and IPC of a core to a registry, under the
+ * names core_print_stats() prints them with.
+ *
+ * @param core The core to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void core_collect_stats(Core *core, StatsRegistry *reg)
+{
+    Core *live = core;
+    if (core->frozen_copy != NULL)
+    {
+        core = core->frozen_copy;
+    }
+
+    double ipc = 0.0;
+    if (core->done_cycle_count)
+    {
+        ipc = (double)(core->done_inst_count) /
+              (double)(core->done_cycle_count);
+    }
+
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "CORE_%01d", core->core_id);
+    stats_add_count(reg, prefix, "INST", core->done_inst_count);
+    stats_add_count(reg, prefix, "CYCLES", core->done_cycle_count);
+    stats_add_real(reg, prefix, "IPC", ipc);
+
+    if (CORE_ROB_SIZE)
+    {
+        double mlp = 0.0;
+        if (core->stat_miss_busy_cycles)
+        {
+            mlp = (double)(core->stat_miss_cycles) /
+                  (double)(core->stat_miss_busy_cycles);
+        }
+        stats_add_real(reg, prefix, "MLP", mlp);
+        stats_add_count(reg, prefix, "ROB_FULL", core->stat_rob_full_cycles);
+        stats_add_count(reg, prefix, "LQ_FULL", core->stat_lq_full_cycles);
+    }
+
+    if (CORE_REPLAY)
+    {
+        stats_add_count(reg, prefix, "REPLAYS", live->stat_replays);
+    }
+
+    if (CORE_SB_SIZE)
+    {
+        double avg_write = 0.0;
+        if (core->stat_sb_stores)
+        {
+            avg_write = (double)(core->stat_sb_write_cycles) /
+                        (double)(core->stat_sb_stores);
+        }
+        stats_add_count(reg, prefix, "SB_FULL", core->stat_sb_full_cycles);
+        stats_add_count(reg, prefix, "SB_FORWARDS", core->stat_sb_forwards);
+        stats_add_real(reg, prefix, "SB_WRITE_AVG", avg_write);
+    }
+}
+
+void core_close_trace(Core *core)
+{
     close(core->trace_fd);
     waitpid(core->pid, NULL, 0);
 }
 
+/**
+ * In replay mode, freeze the statistics of a core once it has retired its
+ * instruction target (or has nothing left to run).
+ *
+ * @param core The core to check.
+ */
+void core_check_target(Core *core)
+{
+    if (core->frozen)
+    {
+        return;
+    }
+
+    if (core->done ||
+        (core->inst_target && core->inst_count >= core->inst_target))
+    {
+        core->frozen = true;
+        if (!core->done)
+        {
+            core->done_inst_count = core->inst_count;
+            core->done_cycle_count = current_cycle;
+        }
+        core->frozen_copy = (Core *)malloc(sizeof(Core));
+        memcpy(core->frozen_copy, core, sizeof(Core));
+        memsys_freeze_core(core->memsys, core->core_id);
+    }
+}
+
 int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
 {
     int status;
     int pipefd[2];
 
-    status = pipe(pipefd);
+    // Other traces are opened while this one is read, possibly from other
+    // threads, so their gunzip processes must not inherit this pipe and
+    // hold it open past the end of the trace.
+    status = pipe2(pipefd, O_CLOEXEC);
     if (status != 0)
     {
         perror("Couldn't create pipe");
@@ -12,12 +12,33 @@
 #include "memsys.h"
 #include <sys/types.h>
 
+/** An instruction in flight in the reorder buffer of an out-of-order core. */
+typedef struct ROBEntry
+{
+    /** The cycle the instruction finishes executing. */
+    uint64_t done_cycle;
+    bool is_load;
+
+    /** For a store headed to the store buffer, its address and PC. */
+    bool is_store;
+    uint64_t addr;
+    uint64_t pc;
+} ROBEntry;
+
+/** A retired store waiting in the store buffer to be written to the L1. */
+typedef struct StoreBufferEntry
+{
+    uint64_t addr;
+    uint64_t pc;
+} StoreBufferEntry;
+
 typedef struct Core
 {
     unsigned int core_id;
 
     MemorySystem *memsys;
 
+    const char *trace_filename;
     int trace_fd;
     pid_t pid;
     uint8_t read_buf[32 * 1024];
@@ -33,15 +54,68 @@ typedef struct Core
     // Used to stall when waiting for data to return from memory.
     uint64_t snooze_end_cycle;
 
+    // Out-of-order model (CORE_ROB_SIZE > 0): the reorder buffer as a ring,
+    // the number of loads in it, and the front end's state. The core is done
+    // once the trace has ended and the ROB has drained.
+    ROBEntry *rob;
+    unsigned int rob_head;
+    unsigned int rob_count;
+    unsigned int lq_count;
+    bool trace_done;
+    bool fetched;
+    uint64_t fetch_ready_cycle;
+
+    // The total latency of loads that missed the L1, the cycles at least one
+    // was outstanding, and the cycle the last one returns.
+    unsigned long long stat_miss_cycles;
+    unsigned long long stat_miss_busy_cycles;
+    uint64_t miss_busy_until;
+
+    // The cycles dispatch stalled on a full ROB and a full load queue.
+    unsigned long long stat_rob_full_cycles;
+    unsigned long long stat_lq_full_cycles;
+
+    // Store buffer (CORE_SB_SIZE > 0) as a ring. Stores leave it one at a
+    // time, in program order; the head is being written while sb_writing,
+    // until sb_write_end.
+    StoreBufferEntry *sb;
+    unsigned int sb_head;
+    unsigned int sb_count;
+    bool sb_writing;
+    uint64_t sb_write_end;
+
+    // The cycles the core stalled on a full store buffer, the loads it
+    // forwarded from older stores in the ROB or store buffer, and the total
+    // cycles its stores took to write.
+    unsigned long long stat_sb_full_cycles;
+    unsigned long long stat_sb_forwards;
+    unsigned long long stat_sb_write_cycles;
+    unsigned long long stat_sb_stores;
+
     unsigned long long inst_count;
     unsigned long long done_inst_count;
     unsigned long long done_cycle_count;
+
+    // Replay mode (CORE_REPLAY): the instructions the core must retire, or 0
+    // until the first pass over its trace has counted the trace's records.
+    // Once the core reaches the target its statistics are frozen, and it
+    // keeps replaying its trace until every core has; frozen_copy is the
+    // core as it was then, whose statistics are reported. Only stat_replays
+    // is read from the live core, as it counts the passes after the freeze.
+    unsigned long long inst_target;
+    unsigned long long trace_records;
+    unsigned long long stat_replays;
+    bool frozen;
+    struct Core *frozen_copy;
 } Core;
 
 Core *core_new(MemorySystem *memsys, const char *trace_filename,
                unsigned int core_id);
 void core_cycle(Core *core);
 void core_print_stats(Core *core);
+void core_collect_stats(Core *core, StatsRegistry *reg);
+void core_close_trace(Core *core);
+void core_check_target(Core *core);
 void core_read_trace(Core *core);
 
 #endif // __CORE_H__
@@ -0,0 +1,277 @@
+// deadblock.cpp
+// Defines the functions used to implement the sampling dead-block predictor.
+
+#include "deadblock.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a dead-block predictor for a cache.
+ *
+ * @param cache_sets The number of sets in the cache.
+ * @param cache_ways The associativity of the cache.
+ * @return A pointer to the predictor.
+ */
+DeadBlockPredictor *dbp_new(uint64_t cache_sets, uint64_t cache_ways)
+{
+    DeadBlockPredictor *p = (DeadBlockPredictor *)calloc(
+        1, sizeof(DeadBlockPredictor));
+    p->cache_sets = cache_sets;
+    p->cache_ways = cache_ways;
+
+    p->sampler_sets = (cache_sets + DBP_SAMPLE_STRIDE - 1) / DBP_SAMPLE_STRIDE;
+    p->sampler = (SamplerEntry *)calloc(p->sampler_sets * cache_ways,
+                                        sizeof(SamplerEntry));
+
+    return p;
+}
+
+/**
+ * Hash the PC and core ID of an access into a signature.
+ *
+ * @param pc The address of the instruction that caused the access.
+ * @param core_id The CPU core ID that requested the access.
+ * @return The signature.
+ */
+static uint64_t dbp_signature(uint64_t pc, unsigned int core_id)
+{
+    return ((pc >> 2) ^ ((uint64_t)core_id << 15)) & 0xffff;
+}
+
+/**
+ * Index one of the skewed prediction tables.
+ *
+ * @param signature The signature to look up.
+ * @param table Which table to index.
+ * @return The index into that table.
+ */
+static unsigned int dbp_index(uint64_t signature, unsigned int table)
+{
+    static const uint64_t multipliers[DBP_NUM_TABLES] = {
+        0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL};
+    return (unsigned int)(((signature + table) * multipliers[table]) >> 52) %
+           DBP_TABLE_SIZE;
+}
+
+/**
+ * Predict whether a line last touched with the given signature is dead.
+ *
+ * @param p The predictor to use.
+ * @param signature The signature to look up.
+ * @return Whether the line is predicted dead.
+ */
+static bool dbp_predict(DeadBlockPredictor *p, uint64_t signature)
+{
+    unsigned int sum = 0;
+    for (unsigned int t = 0; t < DBP_NUM_TABLES; t++)
+    {
+        sum += p->tables[t][dbp_index(signature, t)];
+    }
+    return sum >= DBP_THRESHOLD;
+}
+
+/**
+ * Train the prediction tables with the outcome of a line.
+ *
+ * @param p The predictor to train.
+ * @param signature The signature of the last access to the line.
+ * @param dead Whether the line turned out to be dead.
+ */
+static void dbp_train(DeadBlockPredictor *p, uint64_t signature, bool dead)
+{
+    for (unsigned int t = 0; t < DBP_NUM_TABLES; t++)
+    {
+        uint8_t *counter = &p->tables[t][dbp_index(signature, t)];
+        if (dead && *counter < DBP_COUNTER_MAX)
+        {
+            (*counter)++;
+        }
+        if (!dead && *counter > 0)
+        {
+            (*counter)--;
+        }
+    }
+}
+
+/**
+ * Observe a demand access to the cache and predict whether the line will be
+ * dead if it is filled now.
+ *
+ * If the access falls in a sampled set, the sampler is updated and the
+ * prediction tables are trained.
+ *
+ * @param p The predictor to use.
+ * @param line_addr The address of the cache line being accessed (in units of
+ *                  the cache line size).
+ * @param pc The address of the instruction that caused the access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return Whether the line is predicted dead.
+ */
+bool dbp_access(DeadBlockPredictor *p, uint64_t line_addr, uint64_t pc,
+                unsigned int core_id)
+{
+    uint64_t signature = dbp_signature(pc, core_id);
+    bool predicted_dead = dbp_predict(p, signature);
+
+    uint64_t set_index = line_addr % p->cache_sets;
+    if (set_index % DBP_SAMPLE_STRIDE != 0)
+    {
+        return predicted_dead;
+    }
+
+    SamplerEntry *set = &p->sampler[(set_index / DBP_SAMPLE_STRIDE) *
+                                    p->cache_ways];
+    uint64_t tag = line_addr / p->cache_sets;
+    p->sampler_clock++;
+
+    // A sampler hit means the previous access to the line was not its last.
+    for (uint64_t i = 0; i < p->cache_ways; i++)
+    {
+        SamplerEntry *entry = &set[i];
+        if (entry->valid && entry->tag == tag)
+        {
+            dbp_train(p, entry->signature, false);
+
+            if (!entry->reused)
+            {
+                entry->reused = true;
+                if (entry->predicted_dead)
+                {
+                    p->stat_false_dead++;
+                }
+                else
+                {
+                    p->stat_true_live++;
+                }
+            }
+
+            entry->signature = signature;
+            entry->last_access = p->sampler_clock;
+            return predicted_dead;
+        }
+    }
+
+    // On a sampler miss, the LRU entry's last access was its last.
+    SamplerEntry *victim = &set[0];
+    for (uint64_t i = 0; i < p->cache_ways; i++)
+    {
+        if (!set[i].valid)
+        {
+            victim = &set[i];
+            break;
+        }
+        if (set[i].last_access < victim->last_access)
+        {
+            victim = &set[i];
+        }
+    }
+
+    if (victim->valid)
+    {
+        dbp_train(p, victim->signature, true);
+
+        if (!victim->reused)
+        {
+            if (victim->predicted_dead)
+            {
+                p->stat_true_dead++;
+            }
+            else
+            {
+                p->stat_false_live++;
+            }
+        }
+    }
+
+    victim->valid = true;
+    victim->tag = tag;
+    victim->signature = signature;
+    victim->last_access = p->sampler_clock;
+    victim->predicted_dead = predicted_dead;
+    victim->reused = false;
+
+    return predicted_dead;
+}
+
+/**
+ * Print the statistics of the given predictor.
+ *
+ * @param p The predictor to print the statistics of.
+ * @param header A label for the cache, which is used as a prefix for each
+ *               statistic.
+ */
+void dbp_print_stats(DeadBlockPredictor *p, const char *header)
+{
+    unsigned long long correct = p->stat_true_dead + p->stat_true_live;
+    unsigned long long total = correct + p->stat_false_dead +
+                               p->stat_false_live;
+    double accuracy = 0.0;
+    double coverage = 0.0;
+
+    if (total)
+    {
+        accuracy = 100.0 * (double)correct / (double)total;
+    }
+
+    if (p->stat_true_dead + p->stat_false_live)
+    {
+        coverage = 100.0 * (double)(p->stat_true_dead) /
+                   (double)(p->stat_true_dead + p->stat_false_live);
+    }
+
+    printf("\n");
+    printf("%s_DBP_BYPASS       \t\t : %10llu\n", header, p->stat_bypass);
+    printf("%s_DBP_WB_AROUND    \t\t : %10llu\n", header,
+           p->stat_writeback_around);
+    printf("%s_DBP_LRU_INSERT   \t\t : %10llu\n", header, p->stat_lru_insert);
+    printf("%s_DBP_TRUE_DEAD    \t\t : %10llu\n", header, p->stat_true_dead);
+    printf("%s_DBP_FALSE_DEAD   \t\t : %10llu\n", header, p->stat_false_dead);
+    printf("%s_DBP_TRUE_LIVE    \t\t : %10llu\n", header, p->stat_true_live);
+    printf("%s_DBP_FALSE_LIVE   \t\t : %10llu\n", header, p->stat_false_live);
+    printf("%s_DBP_ACCURACY     \t\t : %10.3f\n", header, accuracy);
+    printf("%s_DBP_COVERAGE     \t\t : %10.3f\n", header, coverage);
+}
+
+/**
+ * Add the statistics of the given predictor to a registry, under the names
+ * dbp_print_stats() prints them with.
+ *
+ * @param p The predictor to collect the statistics of.
+ * @param header A label for the cache, which is used as a prefix for each
+ *               statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void dbp_collect_stats(DeadBlockPredictor *p, const char *header,
+                       StatsRegistry *reg)
+{
+    unsigned long long correct = p->stat_true_dead + p->stat_true_live;
+    unsigned long long total = correct + p->stat_false_dead +
+                               p->stat_false_live;
+    double accuracy = 0.0;
+    double coverage = 0.0;
+
+    if (total)
+    {
+        accuracy = 100.0 * (double)correct / (double)total;
+    }
+
+    if (p->stat_true_dead + p->stat_false_live)
+    {
+        coverage = 100.0 * (double)(p->stat_true_dead) /
+                   (double)(p->stat_true_dead + p->stat_false_live);
+    }
+
+    stats_add_count(reg, header, "DBP_BYPASS", p->stat_bypass);
+    stats_add_count(reg, header, "DBP_WB_AROUND", p->stat_writeback_around);
+    stats_add_count(reg, header, "DBP_LRU_INSERT", p->stat_lru_insert);
+    stats_add_count(reg, header, "DBP_TRUE_DEAD", p->stat_true_dead);
+    stats_add_count(reg, header, "DBP_FALSE_DEAD", p->stat_false_dead);
+    stats_add_count(reg, header, "DBP_TRUE_LIVE", p->stat_true_live);
+    stats_add_count(reg, header, "DBP_FALSE_LIVE", p->stat_false_live);
+    stats_add_real(reg, header, "DBP_ACCURACY", accuracy);
+    stats_add_real(reg, header, "DBP_COVERAGE", coverage);
+}
@@ -0,0 +1,160 @@
+// deadblock.h
+// Declares a sampling dead-block predictor, which predicts from the PC of the
+// missing instruction whether a line filled into a cache will ever be reused.
+//
+// The predictor follows the sampling dead-block predictor (SDBP) of Khan,
+// Jimenez, and Burger. A small tag array (the sampler) shadows a subset of the
+// cache sets. Each sampler entry remembers the signature (hashed PC) of the
+// last access to its line. A sampler hit trains that signature as live, and a
+// sampler eviction trains it as dead. Three skewed tables of 2-bit counters
+// are summed to make a prediction.
+
+#ifndef __DEADBLOCK_H__
+#define __DEADBLOCK_H__
+
+#include "types.h"
+#include "stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** One out of every DBP_SAMPLE_STRIDE cache sets is shadowed by the sampler. */
+#define DBP_SAMPLE_STRIDE 32
+
+/** The number of skewed prediction tables. */
+#define DBP_NUM_TABLES 3
+
+/** The number of 2-bit counters in each prediction table. */
+#define DBP_TABLE_SIZE 4096
+
+/** The maximum value of each saturating counter. */
+#define DBP_COUNTER_MAX 3
+
+/** A line is predicted dead when its summed counters reach this value. */
+#define DBP_THRESHOLD 8
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** What a cache does with a fill that is predicted dead. */
+typedef enum DeadBlockPolicyEnum
+{
+    DBP_OFF = 0,        // Do not use the predictor.
+    DBP_BYPASS = 1,     // Do not install predicted-dead lines.
+    DBP_LRU_INSERT = 2, // Install predicted-dead lines at the LRU position.
+} DeadBlockPolicy;
+
+/** A single entry of the sampler. */
+typedef struct SamplerEntry
+{
+    bool valid;
+
+    uint64_t tag;
+
+    /** The signature of the last access to this line. */
+    uint64_t signature;
+
+    /** Used for LRU replacement within the sampler set. */
+    uint64_t last_access;
+
+    /** The prediction made for this line when it entered the sampler. */
+    bool predicted_dead;
+
+    /** Whether this line has been reused since it entered the sampler. */
+    bool reused;
+} SamplerEntry;
+
+/** A sampling dead-block predictor attached to one cache. */
+typedef struct DeadBlockPredictor
+{
+    /** The number of sets and ways of the cache being predicted for. */
+    uint64_t cache_sets;
+    uint64_t cache_ways;
+
+    /** The sampler sets, each with cache_ways entries. */
+    SamplerEntry *sampler;
+    uint64_t sampler_sets;
+
+    /** A timestamp used for LRU replacement within the sampler. */
+    uint64_t sampler_clock;
+
+    /** The skewed tables of saturating counters. */
+    uint8_t tables[DBP_NUM_TABLES][DBP_TABLE_SIZE];
+
+    /** The number of fills that were predicted dead and bypassed the cache. */
+    unsigned long long stat_bypass;
+
+    /**
+     * The number of writebacks from the level above that missed and were
+     * sent around the cache to memory under the bypass policy.
+     */
+    unsigned long long stat_writeback_around;
+
+    /** The number of fills that were predicted dead and inserted at LRU. */
+    unsigned long long stat_lru_insert;
+
+    /**
+     * The outcomes of sampled lines, classified by the prediction made when
+     * they were filled. A line is dead if it is evicted from the sampler
+     * without being reused.
+     */
+    unsigned long long stat_true_dead;
+    unsigned long long stat_false_dead;
+    unsigned long long stat_true_live;
+    unsigned long long stat_false_live;
+} DeadBlockPredictor;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a dead-block predictor for a cache.
+ *
+ * @param cache_sets The number of sets in the cache.
+ * @param cache_ways The associativity of the cache.
+ * @return A pointer to the predictor.
+ */
+DeadBlockPredictor *dbp_new(uint64_t cache_sets, uint64_t cache_ways);
+
+/**
+ * Observe a demand access to the cache and predict whether the line will be
+ * dead if it is filled now.
+ *
+ * If the access falls in a sampled set, the sampler is updated and the
+ * prediction tables are trained.
+ *
+ * @param p The predictor to use.
+ * @param line_addr The address of the cache line being accessed (in units of
+ *                  the cache line size).
+ * @param pc The address of the instruction that caused the access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return Whether the line is predicted dead.
+ */
+bool dbp_access(DeadBlockPredictor *p, uint64_t line_addr, uint64_t pc,
+                unsigned int core_id);
+
+/**
+ * Print the statistics of the given predictor.
+ *
+ * @param p The predictor to print the statistics of.
+ * @param header A label for the cache, which is used as a prefix for each
+ *               statistic.
+ */
+void dbp_print_stats(DeadBlockPredictor *p, const char *header);
+
+/**
+ * Add the statistics of the given predictor to a registry, under the names
+ * dbp_print_stats() prints them with.
+ *
+ * @param p The predictor to collect the statistics of.
+ * @param header A label for the cache, which is used as a prefix for each
+ *               statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void dbp_collect_stats(DeadBlockPredictor *p, const char *header,
+                       StatsRegistry *reg);
+
+#endif // __DEADBLOCK_H__
@@ -6,57 +6,130 @@
 // Defines the functions used to implement DRAM.
 
 #include "dram.h"
+#include "selfprof.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
 ///////////////////////////////////////////////////////////////////////////////
-//                                 CONSTANTS                                 //
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
 ///////////////////////////////////////////////////////////////////////////////
 
-/** The fixed latency of a DRAM access assumed in part B, in cycles. */
-#define DELAY_SIM_MODE_B 100
+/**
+ * The current mode under which the simulation is running, corresponding to
+ * which part of the lab is being evaluated.
+ */
+extern Mode SIM_MODE;
+
+/** The number of bytes in a cache line. */
+extern uint64_t CACHE_LINESIZE;
+
+/** Which page policy the DRAM should use. */
+extern DRAMPolicy DRAM_PAGE_POLICY;
 
-/** The DRAM activation latency (ACT), in cycles. (Also known as RAS.) */
-#define DELAY_ACT 45
+/** For PAGE_TIMEOUT, the idle cycles after which a bank closes its row. */
+extern uint64_t DRAM_PAGE_TIMEOUT;
 
-/** The DRAM column selection latency (CAS), in cycles. */
-#define DELAY_CAS 45
+/** For PAGE_OPEN_ADAPTIVE, the most hits served before a row is closed. */
+extern unsigned int DRAM_PAGE_CAP;
 
-/** The DRAM precharge latency (PRE), in cycles. */
-#define DELAY_PRE 45
+/** Which scheduler the DRAM controller should use. */
+extern DRAMScheduler DRAM_SCHEDULER;
 
 /**
- * The DRAM bus latency, in cycles.
- * 
- * This is how long it takes for the DRAM to transmit the data via the bus. It
- * is incurred on every DRAM access. (In part B, assume that this is included
- * in the fixed DRAM latency DELAY_SIM_MODE_B.)
+ * The number of waiting writes at which a channel starts draining its write
+ * queues, or 0 to schedule reads and writes together.
  */
-#define DELAY_BUS 10
+extern unsigned int DRAM_WQ_HIGH;
+
+/** How the DRAM controller refreshes the banks. */
+extern DRAMRefresh DRAM_REFRESH;
+
+/** The name of the DRAM timing preset to use. */
+extern const char *DRAM_PRESET;
+
+/** The CPU clock frequency in MHz, used to convert DRAM clocks to cycles. */
+extern unsigned int CPU_FREQ_MHZ;
+
+/** The DRAM geometry: channels, ranks per channel, and banks per rank. */
+extern unsigned int DRAM_CHANNELS;
+extern unsigned int DRAM_RANKS;
+extern unsigned int DRAM_BANK_GROUPS;
+extern unsigned int DRAM_BANKS_PER_GROUP;
 
 /** The row buffer size, in bytes. */
-#define ROW_BUFFER_SIZE 1024
+extern uint64_t DRAM_ROW_SIZE;
+
+/** The address mapping string, such as "RoChRaBaCo". */
+extern const char *DRAM_ADDR_MAP;
 
-/** The number of banks in the DRAM module. */
-#define NUM_BANKS 16
+/** Whether to XOR the bank index with the low bits of the row. */
+extern bool DRAM_XOR_BANKS;
+extern bool DRAM_BUS_MODEL;
+extern bool DRAM_ENERGY;
+extern uint64_t DRAM_POWERDOWN;
+extern bool DRAM_STATS;
+extern uint64_t DRAM_INTERVAL;
+extern unsigned int NUM_CORES;
+extern bool LATENCY_HIST;
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
 
 ///////////////////////////////////////////////////////////////////////////////
-//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+//                              DATA STRUCTURES                              //
 ///////////////////////////////////////////////////////////////////////////////
 
+/** A named set of DRAM timings, given in DRAM clocks. */
+typedef struct DRAMPreset
+{
+    const char *name;
+
+    /**
+     * The DRAM clock period in picoseconds, or 0 if the timings below are
+     * already given in CPU cycles.
+     */
+    unsigned int tCK_ps;
+
+    unsigned int tCL, tCWL, tRCD, tRP, tRAS, tRC, tBURST;
+    unsigned int tCCD_S, tCCD_L, tRRD_S, tRRD_L, tFAW;
+    unsigned int tWTR_S, tWTR_L, tRTP, tWR;
+
+    /**
+     * The refresh interval and the all-bank and same-bank refresh times.
+     * tRFCsb is 0 where the standard has no same-bank refresh.
+     */
+    unsigned int tREFI, tRFC, tRFCsb;
+
+    /** The power-down exit time and the device currents. */
+    unsigned int tXP;
+    DRAMCurrents currents;
+} DRAMPreset;
+
 /**
- * The current mode under which the simulation is running, corresponding to
- * which part of the lab is being evaluated.
+ * The available presets. "lab" reproduces the original fixed ACT, CAS, PRE
+ * and bus delays and places no other constraints on the banks besides the
+ * read-to-write bus turnaround. Its refresh, power-down and currents are
+ * those of DDR4-3200. The currents are typical of 8Gb x8 devices.
  */
-extern Mode SIM_MODE;
-
-/** The number of bytes in a cache line. */
-extern uint64_t CACHE_LINESIZE;
+static const DRAMPreset DRAM_PRESETS[] = {
+    //name         tCK  CL CWL RCD  RP RAS  RC BURST CCD_S/L RRD_S/L FAW WTR_S/L RTP WR   REFI   RFC RFCsb XP
+    //                 {VDD  IDD0 2N 2P 3N 3P 4R   4W   5B}
+    {"lab",          0, 45, 45, 45, 45,  0,  0, 10,  0,  0,  0,  0,  0,  0,  0,  0,  0, 24960, 1120, 416, 20,
+                       {1200, 58, 37, 25, 52, 39, 160, 150, 250}},
+    {"DDR4-2400",  833, 17, 12, 17, 17, 39, 56,  4,  4,  6,  4,  6, 26,  3,  9,  9, 18,  9363,  420,   0,  8,
+                       {1200, 48, 34, 25, 43, 35, 135, 123, 250}},
+    {"DDR4-3200",  625, 22, 16, 22, 22, 52, 74,  4,  4,  8,  4,  8, 34,  4, 12, 12, 24, 12480,  560,   0, 10,
+                       {1200, 58, 37, 25, 52, 39, 160, 150, 250}},
+    {"DDR5-4800",  416, 40, 38, 39, 39, 77, 116, 8,  8, 12,  8, 12, 32,  6, 24, 18, 72,  9360,  708, 312, 18,
+                       {1100, 86, 60, 48, 75, 60, 250, 230, 280}},
+};
 
-/** Which page policy the DRAM should use. */
-extern DRAMPolicy DRAM_PAGE_POLICY;
+/** The number of available presets. */
+#define NUM_DRAM_PRESETS (sizeof(DRAM_PRESETS) / sizeof(DRAM_PRESETS[0]))
 
 ///////////////////////////////////////////////////////////////////////////////
 //                           FUNCTION DEFINITIONS                            //
@@ -69,79 +142,508 @@ extern DRAMPolicy DRAM_PAGE_POLICY;
 // modify its output format, since its output will be used for grading.
 
 /**
- * Allocate and initialize a DRAM module.
- * 
- * This is intended to be implemented in part B.
- * 
- * @return A pointer to the DRAM module.
+ * Find the DRAM timing preset with the given name.
+ *
+ * @param name The name of the preset, compared case-insensitively.
+ * @return The preset, or NULL if there is none with that name.
  */
-DRAM *dram_new()
+static const DRAMPreset *dram_find_preset(const char *name)
 {
-    // TODO: Allocate memory to the data structures and initialize the required
-    //       fields. (You might want to use calloc() for this.)
+    for (unsigned int i = 0; i < NUM_DRAM_PRESETS; i++)
+    {
+        if (strcasecmp(DRAM_PRESETS[i].name, name) == 0)
+        {
+            return &DRAM_PRESETS[i];
+        }
+    }
+    return NULL;
+}
 
-    #ifdef DEBUG
-        printf("Creating DRAM!\n");
-    #endif
+/**
+ * Check whether a DRAM timing preset with the given name exists.
+ *
+ * @param name The name of the preset, such as "DDR4-3200".
+ * @return Whether the preset exists.
+ */
+bool dram_preset_exists(const char *name)
+{
+    return dram_find_preset(name) != NULL;
+}
 
-    //allocating memory for dram
-    DRAM* dram = (DRAM*)calloc(1, sizeof(DRAM));
+/**
+ * Convert a number of DRAM clocks to CPU cycles, rounding up.
+ *
+ * @param preset The preset the clocks belong to.
+ * @param clocks The number of DRAM clocks.
+ * @return The number of CPU cycles.
+ */
+static uint64_t dram_clocks_to_cycles(const DRAMPreset *preset,
+                                      unsigned int clocks)
+{
+    if (preset->tCK_ps == 0)
+    {
+        return clocks;
+    }
+    uint64_t ps = (uint64_t)clocks * preset->tCK_ps;
+    return (ps * CPU_FREQ_MHZ + 999999) / 1000000;
+}
 
-    //allocating memory for Row Buffer Entry
-    dram->RowbufEntry = (RowBuffer*)calloc(NUM_BANKS, sizeof(RowBuffer));
-    
-    //initializing the Row Buffer Entry under each bank
-    for(unsigned int i=0; i<NUM_BANKS; i++){
-        dram->RowbufEntry[i].valid = false;
-        dram->RowbufEntry[i].rowid = 0;
+/**
+ * Load the timings of a preset into a DRAM module.
+ *
+ * @param dram The DRAM module to configure.
+ * @param preset The preset to load.
+ */
+static void dram_load_timing(DRAM *dram, const DRAMPreset *preset)
+{
+    DRAMTiming *t = &dram->timing;
+    t->tCL = dram_clocks_to_cycles(preset, preset->tCL);
+    t->tCWL = dram_clocks_to_cycles(preset, preset->tCWL);
+    t->tRCD = dram_clocks_to_cycles(preset, preset->tRCD);
+    t->tRP = dram_clocks_to_cycles(preset, preset->tRP);
+    t->tRAS = dram_clocks_to_cycles(preset, preset->tRAS);
+    t->tRC = dram_clocks_to_cycles(preset, preset->tRC);
+    t->tBURST = dram_clocks_to_cycles(preset, preset->tBURST);
+    t->tCCD_S = dram_clocks_to_cycles(preset, preset->tCCD_S);
+    t->tCCD_L = dram_clocks_to_cycles(preset, preset->tCCD_L);
+    t->tRRD_S = dram_clocks_to_cycles(preset, preset->tRRD_S);
+    t->tRRD_L = dram_clocks_to_cycles(preset, preset->tRRD_L);
+    t->tFAW = dram_clocks_to_cycles(preset, preset->tFAW);
+    t->tWTR_S = dram_clocks_to_cycles(preset, preset->tWTR_S);
+    t->tWTR_L = dram_clocks_to_cycles(preset, preset->tWTR_L);
+    t->tRTP = dram_clocks_to_cycles(preset, preset->tRTP);
+    t->tWR = dram_clocks_to_cycles(preset, preset->tWR);
+
+    t->tREFI = dram_clocks_to_cycles(preset, preset->tREFI);
+    t->tRFC = dram_clocks_to_cycles(preset, preset->tRFC);
+    t->tRFCsb = dram_clocks_to_cycles(preset, preset->tRFCsb);
+    t->tXP = dram_clocks_to_cycles(preset, preset->tXP);
+    dram->currents = preset->currents;
+
+    // Write data may only follow read data on the bus after two idle clocks.
+    t->tRTW = dram_clocks_to_cycles(preset, preset->tCL + preset->tBURST + 2 -
+                                                preset->tCWL);
+}
+
+/**
+ * Split an address mapping string into its fields.
+ *
+ * @param map The mapping string, such as "RoChRaBaCo".
+ * @param fields Set to the fields, from the most significant bits downward.
+ * @param count Set to the number of fields.
+ * @return Whether every field was recognized and none was repeated.
+ */
+static bool dram_parse_map(const char *map, DRAMField *fields,
+                           unsigned int *count)
+{
+    static const char *names[6] = {"Ro", "Ch", "Ra", "Bg", "Ba", "Co"};
+    bool seen[6] = {false, false, false, false, false, false};
+
+    *count = 0;
+    while (*map != '\0')
+    {
+        unsigned int f = 0;
+        while (f < 6 && strncasecmp(map, names[f], 2) != 0)
+        {
+            f++;
+        }
+        if (f == 6 || seen[f])
+        {
+            return false;
+        }
+
+        seen[f] = true;
+        fields[(*count)++] = (DRAMField)f;
+        map += 2;
     }
+    return true;
+}
 
-    //initializing stats to 0
-    dram->stat_read_access = 0;
-    dram->stat_read_delay = 0;
-    dram->stat_write_access = 0;
-    dram->stat_write_delay = 0;
+/**
+ * Check whether an address mapping string is well formed for the configured
+ * DRAM geometry.
+ *
+ * The string lists the fields Ro (row), Ch (channel), Ra (rank), Bg (bank
+ * group), Ba (bank) and Co (column) from the most to the least significant
+ * bits, such as "RoChRaBaCo". Ro must come first. Without Bg, Ba selects among
+ * all banks of a rank. Ch and Ra may be left out when there is only one
+ * channel or rank.
+ *
+ * @param map The mapping string.
+ * @return Whether the mapping can be used.
+ */
+bool dram_map_valid(const char *map)
+{
+    DRAMField fields[6];
+    unsigned int count;
+    if (!dram_parse_map(map, fields, &count) || count == 0 ||
+        fields[0] != FIELD_ROW)
+    {
+        return false;
+    }
 
-    return dram;
-    
+    bool present[6] = {false, false, false, false, false, false};
+    for (unsigned int i = 0; i < count; i++)
+    {
+        present[fields[i]] = true;
+    }
+
+    return present[FIELD_BANK] && present[FIELD_COLUMN] &&
+           (present[FIELD_CHANNEL] || DRAM_CHANNELS == 1) &&
+           (present[FIELD_RANK] || DRAM_RANKS == 1) &&
+           DRAM_ROW_SIZE >= CACHE_LINESIZE;
 }
 
 /**
- * Access the DRAM at the given cache line address.
- * 
- * Return the delay in cycles incurred by this DRAM access. Also update the
- * DRAM statistics accordingly.
- * 
- * Note that the address is given in units of the cache line size!
- * 
- * This is intended to be implemented in parts B and C. In parts C through F,
- * you may delegate logic to the dram_access_mode_CDEF() functions.
- * 
+ * Set up the address mapping of a DRAM module from DRAM_ADDR_MAP.
+ *
+ * @param dram The DRAM module to configure.
+ */
+static void dram_setup_map(DRAM *dram)
+{
+    DRAMField fields[6];
+    unsigned int count;
+    dram_parse_map(DRAM_ADDR_MAP, fields, &count);
+
+    bool has_group = false;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        has_group = has_group || (fields[i] == FIELD_GROUP);
+    }
+
+    // Store the fields from the least significant bits upward, so that the
+    // row is decoded last and takes the remaining bits.
+    dram->map_count = count;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        DRAMField field = fields[count - 1 - i];
+        unsigned int size = 1;
+        switch (field)
+        {
+        case FIELD_ROW:
+            size = 1;
+            break;
+        case FIELD_CHANNEL:
+            size = DRAM_CHANNELS;
+            break;
+        case FIELD_RANK:
+            size = DRAM_RANKS;
+            break;
+        case FIELD_GROUP:
+            size = DRAM_BANK_GROUPS;
+            break;
+        case FIELD_BANK:
+            size = has_group ? DRAM_BANKS_PER_GROUP : dram->banks_per_rank;
+            break;
+        case FIELD_COLUMN:
+            size = DRAM_ROW_SIZE / CACHE_LINESIZE;
+            break;
+        }
+        dram->map_fields[i] = field;
+        dram->map_bits[i] = __builtin_ctz(size);
+    }
+}
+
+/**
+ * Find where a line lives in the DRAM.
+ *
+ * @param dram The DRAM module.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param loc Set to the location of the line.
+ */
+void dram_map(DRAM *dram, uint64_t line_addr, DRAMAddress *loc)
+{
+    uint64_t value[6] = {0, 0, 0, 0, 0, 0};
+    bool has_group = false;
+
+    for (unsigned int i = 0; i < dram->map_count; i++)
+    {
+        DRAMField field = dram->map_fields[i];
+        if (field == FIELD_ROW)
+        {
+            value[field] = line_addr;
+            continue;
+        }
+        has_group = has_group || (field == FIELD_GROUP);
+        value[field] = line_addr & ((1ULL << dram->map_bits[i]) - 1);
+        line_addr >>= dram->map_bits[i];
+    }
+
+    uint64_t bank = value[FIELD_BANK];
+    if (has_group)
+    {
+        bank += value[FIELD_GROUP] * DRAM_BANKS_PER_GROUP;
+    }
+
+    // Permutation-based interleaving: rows that would conflict in one bank
+    // are spread over different banks.
+    if (DRAM_XOR_BANKS)
+    {
+        bank ^= value[FIELD_ROW] & (dram->banks_per_rank - 1);
+    }
+
+    loc->channel = value[FIELD_CHANNEL];
+    loc->rank = value[FIELD_RANK];
+    loc->bank = bank;
+    loc->group = bank / DRAM_BANKS_PER_GROUP;
+    loc->row = value[FIELD_ROW];
+}
+
+/**
+ * Record how an access found the row buffer of its bank, and train the page
+ * policy state of the bank.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param row The row accessed.
+ * @param outcome How the access found the row buffer.
+ */
+void dram_page_record(DRAM *dram, uint64_t bank, uint64_t row,
+                      RowOutcome outcome)
+{
+    DRAMPageState *page = &dram->pages[bank];
+
+    switch (outcome)
+    {
+    case ROW_HIT:
+        page->stat_hits++;
+        page->hit_run++;
+        break;
+    case ROW_MISS:
+        page->stat_misses++;
+        page->hit_run = 0;
+        break;
+    case ROW_CONFLICT:
+        page->stat_conflicts++;
+        page->hit_run = 0;
+        break;
+    }
+
+    // The predictor learns whether consecutive accesses to the bank go to
+    // the same row, whether or not the row was actually left open.
+    if (page->accessed && page->last_row == row)
+    {
+        if (page->predictor < 3)
+        {
+            page->predictor++;
+        }
+    }
+    else if (page->accessed && page->predictor > 0)
+    {
+        page->predictor--;
+    }
+
+    page->accessed = true;
+    page->last_row = row;
+    page->last_access = current_cycle;
+}
+
+/**
+ * Decide whether a bank keeps its row open after an access, under the
+ * selected page policy.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param hits_waiting Whether more accesses to the open row are known to be
+ *                     waiting.
+ * @return Whether to leave the row open.
+ */
+bool dram_page_keep_open(DRAM *dram, uint64_t bank, bool hits_waiting)
+{
+    DRAMPageState *page = &dram->pages[bank];
+
+    switch (DRAM_PAGE_POLICY)
+    {
+    case CLOSE_PAGE:
+        return false;
+    case PAGE_PREDICT:
+        return page->predictor >= 2;
+    case PAGE_OPEN_ADAPTIVE:
+        // Count the access that opened the row as the first hit.
+        return hits_waiting && page->hit_run + 1 < DRAM_PAGE_CAP;
+    default:
+        // PAGE_TIMEOUT closes the row later, once the bank has been idle.
+        return true;
+    }
+}
+
+/**
+ * Record that a bank opened a row.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param now The cycle of the activation.
+ */
+void dram_power_open(DRAM *dram, uint64_t bank, uint64_t now)
+{
+    DRAMRankPower *power = &dram->power[bank / dram->banks_per_rank];
+    if (power->open_banks++ == 0)
+    {
+        power->active_start = now;
+    }
+    dram->pages[bank].stat_activates++;
+    dram->stat_activates++;
+}
+
+/**
+ * Record that a bank of a rank closed its row.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle of the precharge.
+ */
+void dram_power_close(DRAM *dram, unsigned int rank, uint64_t now)
+{
+    DRAMRankPower *power = &dram->power[rank];
+    if (power->open_banks == 0)
+    {
+        return;
+    }
+
+    // Auto-precharges are recorded ahead of time, so a row may close before
+    // the rank's active period is seen to start.
+    if (--power->open_banks == 0 && now > power->active_start)
+    {
+        power->stat_active_cycles += now - power->active_start;
+    }
+}
+
+/**
+ * Record an access served by a bank, for the per-core, bank parallelism and
+ * bandwidth statistics.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param core_id The CPU core ID that caused the access.
+ * @param is_dram_write Whether the access wrote to DRAM.
+ * @param start The cycle the bank started serving the access.
+ * @param done The cycle the access completed.
+ */
+void dram_record_access(DRAM *dram, uint64_t bank, unsigned int core_id,
+                        bool is_dram_write, uint64_t start, uint64_t done)
+{
+    if (core_id < MAX_CORES)
+    {
+        if (is_dram_write)
+        {
+            dram->stat_core_writes[core_id]++;
+        }
+        else
+        {
+            dram->stat_core_reads[core_id]++;
+        }
+    }
+
+    // Accesses arrive in roughly increasing order, so the busy periods of
+    // the banks are merged against the end of the last one.
+    dram->pages[bank].stat_busy_cycles += done - start;
+    dram->stat_bank_busy += done - start;
+    if (done > dram->busy_until)
+    {
+        uint64_t from = (start > dram->busy_until) ? start : dram->busy_until;
+        dram->stat_any_busy += done - from;
+        dram->busy_until = done;
+    }
+
+    if (DRAM_INTERVAL == 0)
+    {
+        return;
+    }
+
+    uint64_t interval = done / DRAM_INTERVAL;
+    if (interval >= dram->interval_capacity)
+    {
+        unsigned int capacity = dram->interval_capacity ? dram->interval_capacity : 64;
+        while (capacity <= interval)
+        {
+            capacity *= 2;
+        }
+        dram->stat_interval_lines = (unsigned long long*)realloc(
+            dram->stat_interval_lines, capacity * sizeof(unsigned long long));
+        memset(dram->stat_interval_lines + dram->interval_capacity, 0,
+               (capacity - dram->interval_capacity) *
+                   sizeof(unsigned long long));
+        dram->interval_capacity = capacity;
+    }
+    dram->stat_interval_lines[interval]++;
+    if (interval >= dram->interval_count)
+    {
+        dram->interval_count = interval + 1;
+    }
+}
+
+/**
+ * Wake an idle rank for a new access. A rank idle for longer than
+ * DRAM_POWERDOWN cycles has been powered down in the meantime.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle the access arrives.
+ * @return Whether the rank was powered down and must wait tXP.
+ */
+bool dram_power_wake(DRAM *dram, unsigned int rank, uint64_t now)
+{
+    DRAMRankPower *power = &dram->power[rank];
+    if (DRAM_POWERDOWN == 0 || now <= power->idle_since + DRAM_POWERDOWN)
+    {
+        return false;
+    }
+
+    uint64_t cycles = now - power->idle_since - DRAM_POWERDOWN;
+    if (power->open_banks > 0)
+    {
+        power->stat_pd_active_cycles += cycles;
+    }
+    else
+    {
+        power->stat_pd_precharged_cycles += cycles;
+    }
+    dram->stat_powerdowns++;
+    return true;
+}
+
+/**
+ * Record that a rank has become idle.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle its last access completes.
+ */
+void dram_power_sleep(DRAM *dram, unsigned int rank, uint64_t now)
+{
+    DRAMRankPower *power = &dram->power[rank];
+    if (now > power->idle_since)
+    {
+        power->idle_since = now;
+    }
+}
+
+/**
+ * In mode B, access the DRAM at the given cache line address with the fixed
+ * latency of that mode, and update the DRAM statistics.
+ *
  * @param dram The DRAM module to access.
  * @param line_addr The address of the cache line to access (in units of the
  *                  cache line size).
  * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
  * @return The delay in cycles incurred by this DRAM access.
  */
-uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write)
+static uint64_t dram_access_modeB(DRAM *dram, uint64_t line_addr,
+                                  bool is_dram_write, unsigned int core_id)
 {
-    // TODO: Update the appropriate DRAM statistics.
-    // TODO: Call the dram_access_mode_CDEF() function as needed.
-    // TODO: Return the delay in cycles incurred by this DRAM access.
-
-    if(SIM_MODE != SIM_MODE_B){
-        return dram_access_mode_CDEF(dram, line_addr, is_dram_write);
-    }
-
     #ifdef DEBUG
         printf("\tAccessing DRAM! Calculating delay...\n");
     #endif
     
+    uint64_t num_banks = dram->num_channels * dram->banks_per_channel;
+
     //finding bank id
-    uint64_t bank_index = line_addr % NUM_BANKS;
+    uint64_t bank_index = line_addr % num_banks;
 
     //finding row id
-    uint64_t rowid = line_addr / NUM_BANKS;
+    uint64_t rowid = line_addr / num_banks;
 
     //row buffer under the target bank
     RowBuffer* rowbuf = &dram->RowbufEntry[bank_index];
@@ -172,6 +674,8 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write)
         dram->stat_read_access++;
         dram->stat_read_delay += delay;
     }
+    dram_record_access(dram, bank_index, core_id, is_dram_write, current_cycle,
+                       current_cycle + delay);
 
     #ifdef DEBUG
         printf("\t\tDRAM delay: %ld, is_dram_write: %d\n", delay, is_dram_write);
@@ -181,48 +685,223 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write)
 }
 
 /**
- * For parts C through F, access the DRAM at the given cache line address.
- * 
- * Return the delay in cycles incurred by this DRAM access. It is intended that
- * the calling function will be responsible for updating DRAM statistics
- * accordingly.
- * 
- * Note that the address is given in units of the cache line size!
+ * Allocate and initialize a DRAM module.
  * 
- * This is intended to be implemented in part C.
+ * This is intended to be implemented in part B.
  * 
- * @param dram The DRAM module to access.
- * @param line_addr The address of the cache line to access (in units of the
- *                  cache line size).
- * @param is_dram_write Whether this access writes to DRAM.
- * @return The delay in cycles incurred by this DRAM access.
+ * @return A pointer to the DRAM module.
  */
-uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
-                               bool is_dram_write)
+DRAM *dram_new()
 {
-    // Assume a mapping with consecutive lines in the same row and consecutive
-    // row buffers in consecutive rows.
-    // TODO: Use this function to track open rows.
-    // TODO: Compute the delay based on row buffer hit/miss/empty.
-    //finding bank id
-
-    #ifdef DEBUG
-        printf("\tAccessing DRAM! Calculating delay...\n");
-    #endif
-    uint64_t offset_bits = __builtin_log2(ROW_BUFFER_SIZE/CACHE_LINESIZE);
-    uint64_t bank_index = (line_addr>>offset_bits) % NUM_BANKS;//check later about the offset bits
-
-    //finding row id
-    uint64_t rowid = (line_addr>>offset_bits) / NUM_BANKS;
+    // TODO: Allocate memory to the data structures and initialize the required
+    //       fields. (You might want to use calloc() for this.)
 
     #ifdef DEBUG
-        printf("\t\tbank index: %ld, row index: %ld\n", bank_index, rowid);
+        printf("Creating DRAM!\n");
     #endif
 
-    //row buffer under the target bank
-    RowBuffer* rowbuf = &dram->RowbufEntry[bank_index];
+    //allocating memory for dram
+    DRAM* dram = (DRAM*)calloc(1, sizeof(DRAM));
 
-    uint64_t delay = 0;
+    //geometry and address mapping
+    dram->num_channels = DRAM_CHANNELS;
+    dram->banks_per_rank = DRAM_BANK_GROUPS * DRAM_BANKS_PER_GROUP;
+    dram->banks_per_channel = DRAM_RANKS * dram->banks_per_rank;
+    dram_setup_map(dram);
+    unsigned int num_banks = dram->num_channels * dram->banks_per_channel;
+
+    //allocating memory for Row Buffer Entry
+    dram->RowbufEntry = (RowBuffer*)calloc(num_banks, sizeof(RowBuffer));
+    dram->pages = (DRAMPageState*)calloc(num_banks, sizeof(DRAMPageState));
+    dram->power = (DRAMRankPower*)calloc(dram->num_channels * DRAM_RANKS, sizeof(DRAMRankPower));
+    
+    //initializing the Row Buffer Entry under each bank
+    for(unsigned int i=0; i<num_banks; i++){
+        dram->RowbufEntry[i].valid = false;
+        dram->RowbufEntry[i].rowid = 0;
+    }
+
+    //timings of the selected preset (validated when parsing arguments)
+    dram_load_timing(dram, dram_find_preset(DRAM_PRESET));
+
+    //initializing stats to 0
+    dram->stat_read_access = 0;
+    dram->stat_read_delay = 0;
+    dram->stat_write_access = 0;
+    dram->stat_write_delay = 0;
+
+    dram->channels = (DRAMChannel*)calloc(dram->num_channels, sizeof(DRAMChannel));
+
+    //controller queues, only when requests are scheduled
+    dram->scheduled = (DRAM_SCHEDULER != SCHED_NONE);
+
+    if(LATENCY_HIST){
+        dram->delay_hist = (Histogram*)calloc(2, sizeof(Histogram));
+    }
+
+    //access path: the fixed latency of mode B, else through the controllers
+    //or straight to the banks
+    if(SIM_MODE == SIM_MODE_B){
+        dram->access = dram_access_modeB;
+    }
+    else if(dram->scheduled){
+        dram->access = dram_ctrl_access;
+    }
+    else{
+        dram->access = dram_access_mode_CDEF;
+    }
+    for(unsigned int c=0; c<dram->num_channels && dram->scheduled; c++){
+        DRAMChannel* channel = &dram->channels[c];
+        channel->ranks = (DRAMRank*)calloc(DRAM_RANKS, sizeof(DRAMRank));
+        channel->banks = (DRAMBank*)calloc(dram->banks_per_channel, sizeof(DRAMBank));
+        for(unsigned int i=0; i<dram->banks_per_channel; i++){
+            DRAMBank* bank = &channel->banks[i];
+            bank->read_queue.entries = (DRAMRequest*)calloc(DRAM_QUEUE_SIZE, sizeof(DRAMRequest));
+            bank->write_queue.entries = (DRAMRequest*)calloc(DRAM_QUEUE_SIZE, sizeof(DRAMRequest));
+            bank->rank = i / dram->banks_per_rank;
+            bank->group = (i % dram->banks_per_rank) / DRAM_BANKS_PER_GROUP;
+        }
+    }
+
+    //refresh: same-bank refresh cycles through the banks of each group,
+    //falling back to the all-bank tRFC where there is no tRFCsb
+    if(DRAM_REFRESH == REFRESH_SAME_BANK){
+        dram->refresh_interval = dram->timing.tREFI / DRAM_BANKS_PER_GROUP;
+        dram->refresh_duration = dram->timing.tRFCsb ? dram->timing.tRFCsb : dram->timing.tRFC;
+    }
+    else{
+        dram->refresh_interval = dram->timing.tREFI;
+        dram->refresh_duration = dram->timing.tRFC;
+    }
+    for(unsigned int c=0; c<dram->num_channels && dram->scheduled; c++){
+        for(unsigned int r=0; r<DRAM_RANKS; r++){
+            //stagger the ranks so that they do not refresh together
+            dram->channels[c].ranks[r].next_refresh = dram->refresh_interval +
+                r * dram->refresh_interval / DRAM_RANKS;
+        }
+    }
+
+    return dram;
+    
+}
+
+/**
+ * Access the DRAM at the given cache line address.
+ * 
+ * Return the delay in cycles incurred by this DRAM access. Also update the
+ * DRAM statistics accordingly.
+ * 
+ * Note that the address is given in units of the cache line size!
+ * 
+ * This is intended to be implemented in parts B and C. In parts C through F,
+ * you may delegate logic to the dram_access_mode_CDEF() functions.
+ * 
+ * @param dram The DRAM module to access.
+ * @param line_addr The address of the cache line to access (in units of the
+ *                  cache line size).
+ * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
+ * @return The delay in cycles incurred by this DRAM access.
+ */
+uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write,
+                     unsigned int core_id)
+{
+    // TODO: Update the appropriate DRAM statistics.
+    // TODO: Call the dram_access_mode_CDEF() function as needed.
+    // TODO: Return the delay in cycles incurred by this DRAM access.
+
+    uint64_t prof_start = selfprof_begin(SELFPROF_DRAM);
+    uint64_t delay = dram->access(dram, line_addr, is_dram_write, core_id);
+    selfprof_end(SELFPROF_DRAM, prof_start);
+
+    // The controllers count a scheduled access when it is serviced.
+    if (dram->delay_hist != NULL && !dram->scheduled)
+    {
+        histogram_record(&dram->delay_hist[is_dram_write], delay);
+    }
+    return delay;
+}
+
+/**
+ * Reserve a channel's data bus for a line that would otherwise start its
+ * transfer tBURST cycles before the access completes.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel carrying the line.
+ * @param delay The delay of the access with an idle bus.
+ * @return The extra cycles the access waits for the bus.
+ */
+static uint64_t dram_bus_reserve(DRAM *dram, DRAMChannel *channel,
+                                 uint64_t delay)
+{
+    uint64_t start = current_cycle + delay - dram->timing.tBURST;
+    uint64_t wait = 0;
+    if (channel->bus_free > start)
+    {
+        wait = channel->bus_free - start;
+    }
+
+    channel->bus_free = start + wait + dram->timing.tBURST;
+    dram->stat_bus_wait += wait;
+    return wait;
+}
+
+/**
+ * For parts C through F, access the DRAM at the given cache line address.
+ * 
+ * Return the delay in cycles incurred by this DRAM access. It is intended that
+ * the calling function will be responsible for updating DRAM statistics
+ * accordingly.
+ * 
+ * Note that the address is given in units of the cache line size!
+ * 
+ * This is intended to be implemented in part C.
+ * 
+ * @param dram The DRAM module to access.
+ * @param line_addr The address of the cache line to access (in units of the
+ *                  cache line size).
+ * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
+ * @return The delay in cycles incurred by this DRAM access.
+ */
+uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
+                               bool is_dram_write, unsigned int core_id)
+{
+    // The address mapping decides the channel, rank, bank and row. The
+    // default "RoChRaBaCo" with one channel and rank puts consecutive lines
+    // in the same row and consecutive rows in consecutive banks.
+    //finding bank id
+
+    #ifdef DEBUG
+        printf("\tAccessing DRAM! Calculating delay...\n");
+    #endif
+    DRAMAddress loc;
+    dram_map(dram, line_addr, &loc);
+    unsigned int rank_index = loc.channel * DRAM_RANKS + loc.rank;
+    uint64_t bank_index = rank_index * dram->banks_per_rank + loc.bank;
+
+    //an idle rank may have powered down since its last access
+    bool woken = dram_power_wake(dram, rank_index, current_cycle);
+
+    //finding row id
+    uint64_t rowid = loc.row;
+
+    //data transferred over the channel
+    if(is_dram_write){
+        dram->channels[loc.channel].stat_writes++;
+    }
+    else{
+        dram->channels[loc.channel].stat_reads++;
+    }
+
+    #ifdef DEBUG
+        printf("\t\tbank index: %ld, row index: %ld\n", bank_index, rowid);
+    #endif
+
+    //row buffer under the target bank
+    RowBuffer* rowbuf = &dram->RowbufEntry[bank_index];
+
+    uint64_t delay = 0;
 
     if(DRAM_PAGE_POLICY == OPEN_PAGE){
         #ifdef DEBUG
@@ -241,7 +920,8 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
                 #endif
                 //row buffer hit
                 //column access + bus latency
-                delay = DELAY_CAS + DELAY_BUS;
+                delay = dram->timing.tCL + dram->timing.tBURST;
+                dram_page_record(dram, bank_index, rowid, ROW_HIT);
             }
             else{
                 #ifdef DEBUG
@@ -249,7 +929,11 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
                 #endif
                 //row buffer miss
                 //precharge + activate + column access + bus latency
-                delay += DELAY_PRE + DELAY_ACT + DELAY_CAS + DELAY_BUS;
+                delay += dram->timing.tRP + dram->timing.tRCD + dram->timing.tCL +
+                         dram->timing.tBURST;
+                dram_page_record(dram, bank_index, rowid, ROW_CONFLICT);
+                dram_power_close(dram, rank_index, current_cycle);
+                dram_power_open(dram, bank_index, current_cycle);
 
                 //updating the row buffer with current row id
                 rowbuf->rowid = rowid;
@@ -268,7 +952,9 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
             //updating the row as valid
             rowbuf->valid = true;
             //precharge + activate + column access + bus latency
-            delay += DELAY_ACT + DELAY_CAS + DELAY_BUS;
+            delay += dram->timing.tRCD + dram->timing.tCL + dram->timing.tBURST;
+            dram_page_record(dram, bank_index, rowid, ROW_MISS);
+            dram_power_open(dram, bank_index, current_cycle);
         }
         //updating statistics
             if(is_dram_write){
@@ -327,7 +1013,10 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
             //always row buffer miss
 
             //activate + column access + precharge(row close) bus delay
-            delay += DELAY_ACT + DELAY_CAS + DELAY_BUS;
+            delay += dram->timing.tRCD + dram->timing.tCL + dram->timing.tBURST;
+            dram_page_record(dram, bank_index, rowid, ROW_MISS);
+            dram_power_open(dram, bank_index, current_cycle);
+            dram_power_close(dram, rank_index, current_cycle + delay);
 
             //updating row buffer
             rowbuf->valid = false;
@@ -344,12 +1033,482 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
             }
         
     }
+
+    else{
+        //adaptive policies: the row is left open or closed after each access
+        #ifdef DEBUG
+            printf("\t\tUsing adaptive page policy %d!\n", DRAM_PAGE_POLICY);
+        #endif
+
+        //a row left open too long has been closed in the meantime
+        DRAMPageState* page = &dram->pages[bank_index];
+        if(DRAM_PAGE_POLICY == PAGE_TIMEOUT && rowbuf->valid &&
+           current_cycle - page->last_access >= DRAM_PAGE_TIMEOUT){
+            rowbuf->valid = false;
+            dram_power_close(dram, rank_index, page->last_access + DRAM_PAGE_TIMEOUT);
+        }
+
+        RowOutcome outcome = ROW_MISS;
+        if(rowbuf->valid && rowbuf->rowid == rowid){
+            //row buffer hit: column access + bus latency
+            outcome = ROW_HIT;
+            delay = dram->timing.tCL + dram->timing.tBURST;
+        }
+        else if(rowbuf->valid){
+            //row buffer conflict: precharge + activate + column access + bus
+            outcome = ROW_CONFLICT;
+            delay = dram->timing.tRP + dram->timing.tRCD + dram->timing.tCL +
+                    dram->timing.tBURST;
+        }
+        else{
+            //row buffer empty: activate + column access + bus latency
+            delay = dram->timing.tRCD + dram->timing.tCL + dram->timing.tBURST;
+        }
+        dram_page_record(dram, bank_index, rowid, outcome);
+        if(outcome == ROW_CONFLICT){
+            dram_power_close(dram, rank_index, current_cycle);
+        }
+        if(outcome != ROW_HIT){
+            dram_power_open(dram, bank_index, current_cycle);
+        }
+
+        //without a queue, assume another hit may follow
+        rowbuf->valid = dram_page_keep_open(dram, bank_index, true);
+        rowbuf->rowid = rowid;
+        if(!rowbuf->valid){
+            dram_power_close(dram, rank_index, current_cycle + delay);
+        }
+
+        //updating statistics
+        if(is_dram_write){
+            dram->stat_write_access++;
+            dram->stat_write_delay += delay;
+        }
+        else{
+            dram->stat_read_access++;
+            dram->stat_read_delay += delay;
+        }
+    }
+
+    //a rank leaving power-down and transfers queued for the channel's data
+    //bus delay the access further
+    uint64_t wait = 0;
+    if(woken){
+        wait += dram->timing.tXP;
+    }
+    if(DRAM_BUS_MODEL){
+        wait += dram_bus_reserve(dram, &dram->channels[loc.channel], delay + wait);
+    }
+    delay += wait;
+    if(is_dram_write){
+        dram->stat_write_delay += wait;
+    }
+    else{
+        dram->stat_read_delay += wait;
+    }
+    dram_power_sleep(dram, rank_index, current_cycle + delay);
+    dram_record_access(dram, bank_index, core_id, is_dram_write, current_cycle,
+                       current_cycle + delay);
     #ifdef DEBUG
         printf("\t\tDRAM delay: %ld, is_dram_write: %d\n", delay, is_dram_write);
     #endif
     return delay;
 }
 
+/** The energy spent by the DRAM module, in picojoules, and its power. */
+typedef struct DRAMEnergy
+{
+    double act;
+    double rd;
+    double wr;
+    double ref;
+    double bg;
+    double total;
+    double per_access;
+
+    /** The average power in milliwatts. */
+    double avg_power;
+
+    /** The percentage of rank cycles spent powered down. */
+    double pd_share;
+} DRAMEnergy;
+
+/**
+ * Compute the energy spent by the DRAM module and its average power, following
+ * the IDD-based method of Micron's DDR power calculator. I/O and termination
+ * power are not included.
+ *
+ * @param dram The DRAM module to compute the energy of.
+ * @param e The energy to fill in.
+ */
+static void dram_compute_energy(DRAM *dram, DRAMEnergy *e)
+{
+    DRAMTiming *t = &dram->timing;
+    DRAMCurrents *idd = &dram->currents;
+
+    // Currents in mA times volts times nanoseconds give picojoules.
+    double ns = 1000.0 / (double)CPU_FREQ_MHZ;
+    double scale = (double)idd->vdd_mv / 1000.0 * ns * DRAM_RANK_DEVICES;
+
+    // The lab preset has no tRAS or tRC, so bound them by the ACT and PRE
+    // delays.
+    double ras = (double)((t->tRAS > t->tRCD) ? t->tRAS : t->tRCD);
+    double rc = (double)((t->tRC > t->tRCD + t->tRP) ? t->tRC
+                                                     : t->tRCD + t->tRP);
+
+    double act = scale * ((double)idd->idd0 * rc -
+                          ((double)idd->idd3n * ras +
+                           (double)idd->idd2n * (rc - ras)));
+    double rd = scale * ((double)idd->idd4r - idd->idd3n) * t->tBURST;
+    double wr = scale * ((double)idd->idd4w - idd->idd3n) * t->tBURST;
+    double ref = scale * ((double)idd->idd5b - idd->idd3n) * t->tRFC;
+    if (DRAM_REFRESH == REFRESH_SAME_BANK)
+    {
+        // Each same-bank refresh covers one bank of every group.
+        ref /= DRAM_BANKS_PER_GROUP;
+    }
+
+    double e_act = (act > 0.0 ? act : 0.0) * dram->stat_activates;
+    double e_rd = rd * dram->stat_read_access;
+    double e_wr = wr * dram->stat_write_access;
+    double e_ref = ref * dram->stat_refreshes;
+
+    // Background power depends on whether each rank has a row open and
+    // whether it is powered down.
+    double e_bg = 0.0;
+    unsigned long long pd_cycles = 0;
+    unsigned int num_ranks = dram->num_channels * DRAM_RANKS;
+    for (unsigned int r = 0; r < num_ranks; r++)
+    {
+        DRAMRankPower *power = &dram->power[r];
+        double active = (double)power->stat_active_cycles;
+        if (power->open_banks > 0 && current_cycle > power->active_start)
+        {
+            active += (double)(current_cycle - power->active_start);
+        }
+        if (active > (double)current_cycle)
+        {
+            active = (double)current_cycle;
+        }
+
+        double pd_active = (double)power->stat_pd_active_cycles;
+        double pd_pre = (double)power->stat_pd_precharged_cycles;
+        pd_active = (pd_active < active) ? pd_active : active;
+        double precharged = (double)current_cycle - active;
+        pd_pre = (pd_pre < precharged) ? pd_pre : precharged;
+        pd_cycles += power->stat_pd_active_cycles +
+                     power->stat_pd_precharged_cycles;
+
+        e_bg += scale * ((double)idd->idd3n * (active - pd_active) +
+                         (double)idd->idd3p * pd_active +
+                         (double)idd->idd2n * (precharged - pd_pre) +
+                         (double)idd->idd2p * pd_pre);
+    }
+
+    e->act = e_act;
+    e->rd = e_rd;
+    e->wr = e_wr;
+    e->ref = e_ref;
+    e->bg = e_bg;
+    e->total = e_act + e_rd + e_wr + e_ref + e_bg;
+    unsigned long long accesses = dram->stat_read_access +
+                                  dram->stat_write_access;
+    e->per_access = accesses ? e->total / (double)accesses : 0.0;
+    e->avg_power = 0.0;
+    e->pd_share = 0.0;
+    if (current_cycle)
+    {
+        e->avg_power = e->total / ((double)current_cycle * ns);
+        e->pd_share = 100.0 * (double)pd_cycles /
+                      ((double)current_cycle * num_ranks);
+    }
+}
+
+/**
+ * Print the energy spent by the DRAM module and its average power.
+ *
+ * @param dram The DRAM module to print the energy of.
+ */
+static void dram_print_energy(DRAM *dram)
+{
+    DRAMEnergy e;
+    dram_compute_energy(dram, &e);
+
+    printf("DRAM_ACTIVATES       \t\t : %10llu\n", dram->stat_activates);
+    printf("DRAM_POWERDOWNS      \t\t : %10llu\n", dram->stat_powerdowns);
+    printf("DRAM_POWERDOWN_PCT   \t\t : %10.3f\n", e.pd_share);
+    printf("DRAM_ENERGY_ACT_NJ   \t\t : %10.3f\n", e.act / 1000.0);
+    printf("DRAM_ENERGY_RD_NJ    \t\t : %10.3f\n", e.rd / 1000.0);
+    printf("DRAM_ENERGY_WR_NJ    \t\t : %10.3f\n", e.wr / 1000.0);
+    printf("DRAM_ENERGY_REF_NJ   \t\t : %10.3f\n", e.ref / 1000.0);
+    printf("DRAM_ENERGY_BG_NJ    \t\t : %10.3f\n", e.bg / 1000.0);
+    printf("DRAM_ENERGY_TOTAL_NJ \t\t : %10.3f\n", e.total / 1000.0);
+    printf("DRAM_ENERGY_ACCESS_NJ\t\t : %10.3f\n", e.per_access / 1000.0);
+    printf("DRAM_POWER_AVG_MW    \t\t : %10.3f\n", e.avg_power);
+}
+
+/**
+ * Add the energy spent by the DRAM module and its average power to a
+ * registry.
+ *
+ * @param dram The DRAM module to collect the energy of.
+ * @param reg The registry to add the statistics to.
+ */
+static void dram_collect_energy(DRAM *dram, StatsRegistry *reg)
+{
+    DRAMEnergy e;
+    dram_compute_energy(dram, &e);
+
+    stats_add_count(reg, "DRAM", "ACTIVATES", dram->stat_activates);
+    stats_add_count(reg, "DRAM", "POWERDOWNS", dram->stat_powerdowns);
+    stats_add_real(reg, "DRAM", "POWERDOWN_PCT", e.pd_share);
+    stats_add_real(reg, "DRAM", "ENERGY_ACT_NJ", e.act / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_RD_NJ", e.rd / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_WR_NJ", e.wr / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_REF_NJ", e.ref / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_BG_NJ", e.bg / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_TOTAL_NJ", e.total / 1000.0);
+    stats_add_real(reg, "DRAM", "ENERGY_ACCESS_NJ", e.per_access / 1000.0);
+    stats_add_real(reg, "DRAM", "POWER_AVG_MW", e.avg_power);
+}
+
+/**
+ * Print the row buffer outcomes of each bank, and with DRAM_STATS also its
+ * activations, outcome rates and busy time.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+static void dram_print_banks(DRAM *dram)
+{
+    unsigned int num_banks = dram->num_channels * dram->banks_per_channel;
+    for (unsigned int b = 0; b < num_banks; b++)
+    {
+        DRAMPageState *page = &dram->pages[b];
+        printf("DRAM_BANK%u_ROW_HITS    \t\t : %10llu\n", b,
+               page->stat_hits);
+        printf("DRAM_BANK%u_ROW_MISSES  \t\t : %10llu\n", b,
+               page->stat_misses);
+        printf("DRAM_BANK%u_ROW_CONFLICTS\t\t : %10llu\n", b,
+               page->stat_conflicts);
+        if (!DRAM_STATS)
+        {
+            continue;
+        }
+
+        unsigned long long accesses = page->stat_hits + page->stat_misses +
+                                      page->stat_conflicts;
+        double hit_rate = 0.0;
+        double miss_rate = 0.0;
+        double conflict_rate = 0.0;
+        double busy = 0.0;
+        if (accesses)
+        {
+            hit_rate = 100.0 * (double)page->stat_hits / (double)accesses;
+            miss_rate = 100.0 * (double)page->stat_misses / (double)accesses;
+            conflict_rate = 100.0 * (double)page->stat_conflicts /
+                            (double)accesses;
+        }
+        if (current_cycle)
+        {
+            busy = 100.0 * (double)page->stat_busy_cycles /
+                   (double)current_cycle;
+        }
+
+        printf("DRAM_BANK%u_ACTIVATES   \t\t : %10llu\n", b,
+               page->stat_activates);
+        printf("DRAM_BANK%u_HIT_RATE    \t\t : %10.3f\n", b, hit_rate);
+        printf("DRAM_BANK%u_MISS_RATE   \t\t : %10.3f\n", b, miss_rate);
+        printf("DRAM_BANK%u_CONFLICT_RATE\t\t : %10.3f\n", b,
+               conflict_rate);
+        printf("DRAM_BANK%u_BUSY_PCT    \t\t : %10.3f\n", b, busy);
+    }
+}
+
+/**
+ * Add the statistics dram_print_banks() prints to a registry.
+ *
+ * @param dram The DRAM module to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+static void dram_collect_banks(DRAM *dram, StatsRegistry *reg)
+{
+    unsigned int num_banks = dram->num_channels * dram->banks_per_channel;
+    for (unsigned int b = 0; b < num_banks; b++)
+    {
+        DRAMPageState *page = &dram->pages[b];
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "DRAM_BANK%u", b);
+        stats_add_count(reg, prefix, "ROW_HITS", page->stat_hits);
+        stats_add_count(reg, prefix, "ROW_MISSES", page->stat_misses);
+        stats_add_count(reg, prefix, "ROW_CONFLICTS", page->stat_conflicts);
+        if (!DRAM_STATS)
+        {
+            continue;
+        }
+
+        unsigned long long accesses = page->stat_hits + page->stat_misses +
+                                      page->stat_conflicts;
+        double hit_rate = 0.0;
+        double miss_rate = 0.0;
+        double conflict_rate = 0.0;
+        double busy = 0.0;
+        if (accesses)
+        {
+            hit_rate = 100.0 * (double)page->stat_hits / (double)accesses;
+            miss_rate = 100.0 * (double)page->stat_misses / (double)accesses;
+            conflict_rate = 100.0 * (double)page->stat_conflicts /
+                            (double)accesses;
+        }
+        if (current_cycle)
+        {
+            busy = 100.0 * (double)page->stat_busy_cycles /
+                   (double)current_cycle;
+        }
+
+        stats_add_count(reg, prefix, "ACTIVATES", page->stat_activates);
+        stats_add_real(reg, prefix, "HIT_RATE", hit_rate);
+        stats_add_real(reg, prefix, "MISS_RATE", miss_rate);
+        stats_add_real(reg, prefix, "CONFLICT_RATE", conflict_rate);
+        stats_add_real(reg, prefix, "BUSY_PCT", busy);
+    }
+}
+
+/**
+ * Print the per-core and bank parallelism statistics.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+static void dram_print_details(DRAM *dram)
+{
+    for (unsigned int c = 0; c < NUM_CORES && c < MAX_CORES; c++)
+    {
+        unsigned long long lines = dram->stat_core_reads[c] +
+                                   dram->stat_core_writes[c];
+        printf("DRAM_CORE%u_READS     \t\t : %10llu\n", c,
+               dram->stat_core_reads[c]);
+        printf("DRAM_CORE%u_WRITES    \t\t : %10llu\n", c,
+               dram->stat_core_writes[c]);
+        printf("DRAM_CORE%u_BYTES     \t\t : %10llu\n", c,
+               lines * CACHE_LINESIZE);
+    }
+
+    // Bank-level parallelism counts busy banks only while any bank is busy.
+    double busy_avg = 0.0;
+    double blp = 0.0;
+    if (current_cycle)
+    {
+        busy_avg = (double)dram->stat_bank_busy / (double)current_cycle;
+    }
+    if (dram->stat_any_busy)
+    {
+        blp = (double)dram->stat_bank_busy / (double)dram->stat_any_busy;
+    }
+    printf("DRAM_BANKS_BUSY_AVG  \t\t : %10.3f\n", busy_avg);
+    printf("DRAM_BLP             \t\t : %10.3f\n", blp);
+}
+
+/**
+ * Add the statistics dram_print_details() prints to a registry.
+ *
+ * @param dram The DRAM module to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+static void dram_collect_details(DRAM *dram, StatsRegistry *reg)
+{
+    for (unsigned int c = 0; c < NUM_CORES && c < MAX_CORES; c++)
+    {
+        unsigned long long lines = dram->stat_core_reads[c] +
+                                   dram->stat_core_writes[c];
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "DRAM_CORE%u", c);
+        stats_add_count(reg, prefix, "READS", dram->stat_core_reads[c]);
+        stats_add_count(reg, prefix, "WRITES", dram->stat_core_writes[c]);
+        stats_add_count(reg, prefix, "BYTES", lines * CACHE_LINESIZE);
+    }
+
+    double busy_avg = 0.0;
+    double blp = 0.0;
+    if (current_cycle)
+    {
+        busy_avg = (double)dram->stat_bank_busy / (double)current_cycle;
+    }
+    if (dram->stat_any_busy)
+    {
+        blp = (double)dram->stat_bank_busy / (double)dram->stat_any_busy;
+    }
+    stats_add_real(reg, "DRAM", "BANKS_BUSY_AVG", busy_avg);
+    stats_add_real(reg, "DRAM", "BLP", blp);
+}
+
+/**
+ * Print the bytes per cycle transferred in each interval of DRAM_INTERVAL
+ * cycles, as a time series.
+ *
+ * @param dram The DRAM module to print the bandwidth of.
+ */
+static void dram_print_intervals(DRAM *dram)
+{
+    // Writes drained at the end may complete after the last cycle.
+    uint64_t end = (dram->busy_until > current_cycle) ? dram->busy_until
+                                                      : current_cycle;
+
+    printf("DRAM_INTERVAL_CYCLES \t\t : %10llu\n",
+           (unsigned long long)DRAM_INTERVAL);
+    for (unsigned int i = 0; i < dram->interval_count; i++)
+    {
+        uint64_t start = i * DRAM_INTERVAL;
+        uint64_t length = DRAM_INTERVAL;
+        if (start + length > end)
+        {
+            length = end - start;
+        }
+
+        double bandwidth = 0.0;
+        if (length)
+        {
+            bandwidth = (double)(dram->stat_interval_lines[i] *
+                                 CACHE_LINESIZE) /
+                        (double)length;
+        }
+        printf("DRAM_INTERVAL%u_BW    \t\t : %10.3f\n", i, bandwidth);
+    }
+}
+
+/**
+ * Add the statistics dram_print_intervals() prints to a registry.
+ *
+ * @param dram The DRAM module to collect the bandwidth of.
+ * @param reg The registry to add the statistics to.
+ */
+static void dram_collect_intervals(DRAM *dram, StatsRegistry *reg)
+{
+    uint64_t end = (dram->busy_until > current_cycle) ? dram->busy_until
+                                                      : current_cycle;
+
+    stats_add_count(reg, "DRAM", "INTERVAL_CYCLES", DRAM_INTERVAL);
+    for (unsigned int i = 0; i < dram->interval_count; i++)
+    {
+        uint64_t start = i * DRAM_INTERVAL;
+        uint64_t length = DRAM_INTERVAL;
+        if (start + length > end)
+        {
+            length = end - start;
+        }
+
+        double bandwidth = 0.0;
+        if (length)
+        {
+            bandwidth = (double)(dram->stat_interval_lines[i] *
+                                 CACHE_LINESIZE) /
+                        (double)length;
+        }
+
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "DRAM_INTERVAL%u", i);
+        stats_add_real(reg, prefix, "BW", bandwidth);
+    }
+}
+
 /**
  * Print the statistics of the DRAM module.
  * 
@@ -362,6 +1521,12 @@ void dram_print_stats(DRAM *dram)
     double avg_read_delay = 0.0;
     double avg_write_delay = 0.0;
 
+    if (dram->scheduled)
+    {
+        // Posted writes may still be waiting; count them too.
+        dram_ctrl_drain(dram);
+    }
+
     if (dram->stat_read_access)
     {
         avg_read_delay = (double)(dram->stat_read_delay) /
@@ -379,4 +1544,338 @@ void dram_print_stats(DRAM *dram)
     printf("DRAM_WRITE_ACCESS    \t\t : %10llu\n", dram->stat_write_access);
     printf("DRAM_READ_DELAY_AVG  \t\t : %10.3f\n", avg_read_delay);
     printf("DRAM_WRITE_DELAY_AVG \t\t : %10.3f\n", avg_write_delay);
+
+    if (dram->scheduled)
+    {
+        double avg_read_queue_delay = 0.0;
+        double avg_write_queue_delay = 0.0;
+
+        if (dram->stat_read_access)
+        {
+            avg_read_queue_delay = (double)(dram->stat_read_queue_delay) /
+                                   (double)(dram->stat_read_access);
+        }
+
+        if (dram->stat_write_access)
+        {
+            avg_write_queue_delay = (double)(dram->stat_write_queue_delay) /
+                                    (double)(dram->stat_write_access);
+        }
+
+        printf("DRAM_READ_QUEUE_AVG  \t\t : %10.3f\n", avg_read_queue_delay);
+        printf("DRAM_WRITE_QUEUE_AVG \t\t : %10.3f\n", avg_write_queue_delay);
+        printf("DRAM_MAX_PENDING     \t\t : %10u\n", dram->stat_max_pending);
+    }
+
+    if (dram->scheduled && DRAM_WQ_HIGH > 0)
+    {
+        double avg_drain_writes = 0.0;
+        double avg_drain_cycles = 0.0;
+        double avg_drain_read_delay = 0.0;
+
+        if (dram->stat_drains)
+        {
+            avg_drain_writes = (double)(dram->stat_drain_writes) /
+                               (double)(dram->stat_drains);
+            avg_drain_cycles = (double)(dram->stat_drain_cycles) /
+                               (double)(dram->stat_drains);
+        }
+
+        if (dram->stat_read_access)
+        {
+            avg_drain_read_delay = (double)(dram->stat_drain_read_delay) /
+                                   (double)(dram->stat_read_access);
+        }
+
+        printf("DRAM_WRITE_DRAINS    \t\t : %10llu\n", dram->stat_drains);
+        printf("DRAM_DRAIN_WRITES_AVG\t\t : %10.3f\n", avg_drain_writes);
+        printf("DRAM_DRAIN_CYCLES_AVG\t\t : %10.3f\n", avg_drain_cycles);
+        printf("DRAM_DRAIN_READ_DELAY\t\t : %10.3f\n", avg_drain_read_delay);
+    }
+
+    if (dram->scheduled && DRAM_REFRESH != REFRESH_OFF)
+    {
+        double avg_refresh_read_delay = 0.0;
+        if (dram->stat_read_access)
+        {
+            avg_refresh_read_delay = (double)(dram->stat_refresh_read_delay) /
+                                     (double)(dram->stat_read_access);
+        }
+
+        printf("DRAM_REFRESHES       \t\t : %10llu\n", dram->stat_refreshes);
+        printf("DRAM_REFRESH_EARLY   \t\t : %10llu\n",
+               dram->stat_refresh_early);
+        printf("DRAM_REFRESH_READ_AVG\t\t : %10.3f\n",
+               avg_refresh_read_delay);
+        printf("DRAM_REFRESH_READ_MAX\t\t : %10llu\n",
+               dram->stat_refresh_read_max);
+    }
+
+    if (dram->scheduled || DRAM_BUS_MODEL)
+    {
+        // Every channel can move one line per tBURST cycles.
+        unsigned long long lines = dram->stat_read_access +
+                                   dram->stat_write_access;
+        double achieved = 0.0;
+        double peak = 0.0;
+        if (current_cycle)
+        {
+            achieved = (double)(lines * CACHE_LINESIZE) /
+                       (double)current_cycle;
+        }
+        if (dram->timing.tBURST)
+        {
+            peak = (double)(dram->num_channels * CACHE_LINESIZE) /
+                   (double)dram->timing.tBURST;
+        }
+
+        printf("DRAM_BUS_BYTES_CYCLE \t\t : %10.3f\n", achieved);
+        printf("DRAM_BUS_PEAK_BYTES  \t\t : %10.3f\n", peak);
+        printf("DRAM_BUS_UTIL        \t\t : %10.3f\n",
+               (peak > 0.0) ? 100.0 * achieved / peak : 0.0);
+        if (!dram->scheduled)
+        {
+            double avg_bus_wait = 0.0;
+            if (lines)
+            {
+                avg_bus_wait = (double)(dram->stat_bus_wait) / (double)lines;
+            }
+            printf("DRAM_BUS_WAIT_AVG    \t\t : %10.3f\n", avg_bus_wait);
+        }
+    }
+
+    if (DRAM_ENERGY)
+    {
+        dram_print_energy(dram);
+    }
+
+    if (DRAM_STATS)
+    {
+        dram_print_details(dram);
+    }
+
+    if (DRAM_INTERVAL)
+    {
+        dram_print_intervals(dram);
+    }
+
+    if (dram->scheduled || DRAM_PAGE_POLICY >= PAGE_TIMEOUT || DRAM_STATS)
+    {
+        dram_print_banks(dram);
+    }
+
+    // Per-channel traffic is only reported beyond the single unscheduled
+    // channel of the original model.
+    if (!dram->scheduled && dram->num_channels == 1)
+    {
+        return;
+    }
+
+    // Each line occupies its channel's data bus for tBURST cycles.
+    for (unsigned int c = 0; c < dram->num_channels; c++)
+    {
+        DRAMChannel *channel = &dram->channels[c];
+        unsigned long long lines = channel->stat_reads + channel->stat_writes;
+        double utilization = 0.0;
+        if (current_cycle)
+        {
+            utilization = 100.0 * (double)(lines * dram->timing.tBURST) /
+                          (double)current_cycle;
+        }
+
+        printf("DRAM_CH%u_READS       \t\t : %10llu\n", c, channel->stat_reads);
+        printf("DRAM_CH%u_WRITES      \t\t : %10llu\n", c, channel->stat_writes);
+        printf("DRAM_CH%u_BW_UTIL     \t\t : %10.3f\n", c, utilization);
+    }
+}
+
+/**
+ * Add the statistics of the DRAM module to a registry, under the names
+ * dram_print_stats() prints them with.
+ *
+ * @param dram The DRAM module to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void dram_collect_stats(DRAM *dram, StatsRegistry *reg)
+{
+    double avg_read_delay = 0.0;
+    double avg_write_delay = 0.0;
+
+    if (dram->stat_read_access)
+    {
+        avg_read_delay = (double)(dram->stat_read_delay) /
+                         (double)(dram->stat_read_access);
+    }
+
+    if (dram->stat_write_access)
+    {
+        avg_write_delay = (double)(dram->stat_write_delay) /
+                          (double)(dram->stat_write_access);
+    }
+
+    stats_add_count(reg, "DRAM", "READ_ACCESS", dram->stat_read_access);
+    stats_add_count(reg, "DRAM", "WRITE_ACCESS", dram->stat_write_access);
+    stats_add_real(reg, "DRAM", "READ_DELAY_AVG", avg_read_delay);
+    stats_add_real(reg, "DRAM", "WRITE_DELAY_AVG", avg_write_delay);
+
+    if (dram->scheduled)
+    {
+        double avg_read_queue_delay = 0.0;
+        double avg_write_queue_delay = 0.0;
+
+        if (dram->stat_read_access)
+        {
+            avg_read_queue_delay = (double)(dram->stat_read_queue_delay) /
+                                   (double)(dram->stat_read_access);
+        }
+
+        if (dram->stat_write_access)
+        {
+            avg_write_queue_delay = (double)(dram->stat_write_queue_delay) /
+                                    (double)(dram->stat_write_access);
+        }
+
+        stats_add_real(reg, "DRAM", "READ_QUEUE_AVG", avg_read_queue_delay);
+        stats_add_real(reg, "DRAM", "WRITE_QUEUE_AVG", avg_write_queue_delay);
+        stats_add_count(reg, "DRAM", "MAX_PENDING", dram->stat_max_pending);
+    }
+
+    if (dram->scheduled && DRAM_WQ_HIGH > 0)
+    {
+        double avg_drain_writes = 0.0;
+        double avg_drain_cycles = 0.0;
+        double avg_drain_read_delay = 0.0;
+
+        if (dram->stat_drains)
+        {
+            avg_drain_writes = (double)(dram->stat_drain_writes) /
+                               (double)(dram->stat_drains);
+            avg_drain_cycles = (double)(dram->stat_drain_cycles) /
+                               (double)(dram->stat_drains);
+        }
+
+        if (dram->stat_read_access)
+        {
+            avg_drain_read_delay = (double)(dram->stat_drain_read_delay) /
+                                   (double)(dram->stat_read_access);
+        }
+
+        stats_add_count(reg, "DRAM", "WRITE_DRAINS", dram->stat_drains);
+        stats_add_real(reg, "DRAM", "DRAIN_WRITES_AVG", avg_drain_writes);
+        stats_add_real(reg, "DRAM", "DRAIN_CYCLES_AVG", avg_drain_cycles);
+        stats_add_real(reg, "DRAM", "DRAIN_READ_DELAY", avg_drain_read_delay);
+    }
+
+    if (dram->scheduled && DRAM_REFRESH != REFRESH_OFF)
+    {
+        double avg_refresh_read_delay = 0.0;
+        if (dram->stat_read_access)
+        {
+            avg_refresh_read_delay = (double)(dram->stat_refresh_read_delay) /
+                                     (double)(dram->stat_read_access);
+        }
+
+        stats_add_count(reg, "DRAM", "REFRESHES", dram->stat_refreshes);
+        stats_add_count(reg, "DRAM", "REFRESH_EARLY",
+                        dram->stat_refresh_early);
+        stats_add_real(reg, "DRAM", "REFRESH_READ_AVG",
+                       avg_refresh_read_delay);
+        stats_add_count(reg, "DRAM", "REFRESH_READ_MAX",
+                        dram->stat_refresh_read_max);
+    }
+
+    if (dram->scheduled || DRAM_BUS_MODEL)
+    {
+        unsigned long long lines = dram->stat_read_access +
+                                   dram->stat_write_access;
+        double achieved = 0.0;
+        double peak = 0.0;
+        if (current_cycle)
+        {
+            achieved = (double)(lines * CACHE_LINESIZE) /
+                       (double)current_cycle;
+        }
+        if (dram->timing.tBURST)
+        {
+            peak = (double)(dram->num_channels * CACHE_LINESIZE) /
+                   (double)dram->timing.tBURST;
+        }
+
+        stats_add_real(reg, "DRAM", "BUS_BYTES_CYCLE", achieved);
+        stats_add_real(reg, "DRAM", "BUS_PEAK_BYTES", peak);
+        stats_add_real(reg, "DRAM", "BUS_UTIL",
+                       (peak > 0.0) ? 100.0 * achieved / peak : 0.0);
+        if (!dram->scheduled)
+        {
+            double avg_bus_wait = 0.0;
+            if (lines)
+            {
+                avg_bus_wait = (double)(dram->stat_bus_wait) / (double)lines;
+            }
+            stats_add_real(reg, "DRAM", "BUS_WAIT_AVG", avg_bus_wait);
+        }
+    }
+
+    if (DRAM_ENERGY)
+    {
+        dram_collect_energy(dram, reg);
+    }
+
+    if (DRAM_STATS)
+    {
+        dram_collect_details(dram, reg);
+    }
+
+    if (DRAM_INTERVAL)
+    {
+        dram_collect_intervals(dram, reg);
+    }
+
+    if (dram->scheduled || DRAM_PAGE_POLICY >= PAGE_TIMEOUT || DRAM_STATS)
+    {
+        dram_collect_banks(dram, reg);
+    }
+
+    if (dram->scheduled || dram->num_channels > 1)
+    {
+        for (unsigned int c = 0; c < dram->num_channels; c++)
+        {
+            DRAMChannel *channel = &dram->channels[c];
+            unsigned long long lines = channel->stat_reads +
+                                       channel->stat_writes;
+            double utilization = 0.0;
+            if (current_cycle)
+            {
+                utilization = 100.0 * (double)(lines * dram->timing.tBURST) /
+                              (double)current_cycle;
+            }
+
+            char prefix[24];
+            snprintf(prefix, sizeof(prefix), "DRAM_CH%u", c);
+            stats_add_count(reg, prefix, "READS", channel->stat_reads);
+            stats_add_count(reg, prefix, "WRITES", channel->stat_writes);
+            stats_add_real(reg, prefix, "BW_UTIL", utilization);
+        }
+    }
+
+    if (dram->delay_hist != NULL)
+    {
+        histogram_collect_stats(&dram->delay_hist[0], "DRAM_READ_LAT", reg);
+        histogram_collect_stats(&dram->delay_hist[1], "DRAM_WRITE_LAT", reg);
+    }
+}
+
+/**
+ * Print the percentiles of the delays of DRAM reads and writes, if they are
+ * recorded.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+void dram_print_hist_stats(DRAM *dram)
+{
+    if (dram->delay_hist != NULL)
+    {
+        histogram_print_stats(&dram->delay_hist[0], "DRAM_READ_LAT");
+        histogram_print_stats(&dram->delay_hist[1], "DRAM_WRITE_LAT");
+    }
 }
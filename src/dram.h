@@ -10,9 +10,36 @@
 #define __DRAM_H__
 
 #include "types.h"
+#include "stats.h"
+#include "histogram.h"
 // You may add any other #include directives you need here, but make sure they
 // compile on the reference machine!
 
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The fixed latency of a DRAM access assumed in part B, in cycles. */
+#define DELAY_SIM_MODE_B 100
+
+/** The largest number of bank groups a rank may have. */
+#define DRAM_MAX_BANK_GROUPS 16
+
+/** The number of activations allowed within one tFAW window. */
+#define DRAM_FAW_ACTS 4
+
+/**
+ * The most refreshes a rank may postpone while busy, or pull in while idle,
+ * under refresh-aware scheduling.
+ */
+#define DRAM_REFRESH_SLACK 8
+
+/** The number of requests each per-bank controller queue can hold. */
+#define DRAM_QUEUE_SIZE 32
+
+/** The number of x8 devices in a rank, which together drive a 64-bit bus. */
+#define DRAM_RANK_DEVICES 8
+
 ///////////////////////////////////////////////////////////////////////////////
 //                              DATA STRUCTURES                              //
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,6 +51,293 @@ typedef struct RowBuffer{
     uint64_t rowid;
 } RowBuffer;
 
+/**
+ * The DRAM timing parameters, in CPU cycles. They are loaded from a named
+ * preset by dram_new().
+ *
+ * The legacy row buffer model (no scheduler) only uses tRCD, tCL, tRP and
+ * tBURST. The controller enforces all of them.
+ */
+typedef struct DRAMTiming
+{
+    uint64_t tCL;    // RD to first data.
+    uint64_t tCWL;   // WR to first data.
+    uint64_t tRCD;   // ACT to RD/WR.
+    uint64_t tRP;    // PRE to ACT.
+    uint64_t tRAS;   // ACT to PRE.
+    uint64_t tRC;    // ACT to ACT, same bank.
+    uint64_t tBURST; // Data transfer of one cache line.
+    uint64_t tCCD_S; // RD/WR to RD/WR, different bank group.
+    uint64_t tCCD_L; // RD/WR to RD/WR, same bank group.
+    uint64_t tRRD_S; // ACT to ACT, different bank group.
+    uint64_t tRRD_L; // ACT to ACT, same bank group.
+    uint64_t tFAW;   // Window holding at most DRAM_FAW_ACTS activations.
+    uint64_t tWTR_S; // End of write data to RD, different bank group.
+    uint64_t tWTR_L; // End of write data to RD, same bank group.
+    uint64_t tRTP;   // RD to PRE.
+    uint64_t tWR;    // End of write data to PRE.
+    uint64_t tRTW;   // RD to WR, so the bus can turn around.
+    uint64_t tREFI;  // Average interval between all-bank refreshes.
+    uint64_t tRFC;   // Duration of an all-bank refresh.
+    uint64_t tRFCsb; // Duration of a same-bank refresh, or 0 if unsupported.
+    uint64_t tXP;    // Power-down exit to any command.
+} DRAMTiming;
+
+/**
+ * The supply voltage and datasheet IDD currents of one DRAM device, used by
+ * the energy model.
+ */
+typedef struct DRAMCurrents
+{
+    unsigned int vdd_mv; // Supply voltage, in millivolts.
+    unsigned int idd0;   // One bank cycling ACT and PRE, in milliamps.
+    unsigned int idd2n;  // Precharge standby.
+    unsigned int idd2p;  // Precharge power-down.
+    unsigned int idd3n;  // Active standby.
+    unsigned int idd3p;  // Active power-down.
+    unsigned int idd4r;  // Burst read.
+    unsigned int idd4w;  // Burst write.
+    unsigned int idd5b;  // Burst refresh.
+} DRAMCurrents;
+
+/** The fields a line address is split into to locate it in the DRAM. */
+typedef enum DRAMFieldEnum
+{
+    FIELD_ROW = 0,
+    FIELD_CHANNEL = 1,
+    FIELD_RANK = 2,
+    FIELD_GROUP = 3,
+    FIELD_BANK = 4,
+    FIELD_COLUMN = 5,
+} DRAMField;
+
+/** Where a line lives in the DRAM, as decoded by the address mapping. */
+typedef struct DRAMAddress
+{
+    unsigned int channel;
+    unsigned int rank;
+
+    /** The bank group, and the bank within the rank (not within the group). */
+    unsigned int group;
+    unsigned int bank;
+
+    uint64_t row;
+} DRAMAddress;
+
+/** How an access found the row buffer of its bank. */
+typedef enum RowOutcomeEnum
+{
+    ROW_HIT = 0,      // The row was open.
+    ROW_MISS = 1,     // No row was open.
+    ROW_CONFLICT = 2, // Another row was open.
+} RowOutcome;
+
+/**
+ * The power state of one rank. Both DRAM models keep it, for the energy
+ * model and for power-down.
+ */
+typedef struct DRAMRankPower
+{
+    /** The number of banks with an open row, and since when any has had one. */
+    unsigned int open_banks;
+    uint64_t active_start;
+
+    /** The cycle the rank last became idle. */
+    uint64_t idle_since;
+
+    /**
+     * The cycles the rank had a row open, and the cycles it spent powered
+     * down with and without one.
+     */
+    unsigned long long stat_active_cycles;
+    unsigned long long stat_pd_active_cycles;
+    unsigned long long stat_pd_precharged_cycles;
+} DRAMRankPower;
+
+/** The page policy state and row buffer statistics of one bank. */
+typedef struct DRAMPageState
+{
+    /** The cycle of the last access, used by PAGE_TIMEOUT. */
+    uint64_t last_access;
+
+    /** The row of the last access, and whether there has been one. */
+    uint64_t last_row;
+    bool accessed;
+
+    /** A 2-bit counter that predicts a row hit at 2 or more. */
+    unsigned int predictor;
+
+    /** The number of hits since the row was opened. */
+    unsigned int hit_run;
+
+    unsigned long long stat_hits;
+    unsigned long long stat_misses;
+    unsigned long long stat_conflicts;
+
+    /** The number of rows opened in the bank, and the cycles it was busy. */
+    unsigned long long stat_activates;
+    unsigned long long stat_busy_cycles;
+} DRAMPageState;
+
+/** Possible refresh modes of the DRAM controller. */
+typedef enum DRAMRefreshEnum
+{
+    REFRESH_OFF = 0,       // Never refresh.
+    REFRESH_ALL_BANK = 1,  // Refresh every bank of a rank at once.
+    /**
+     * Refresh one bank of every bank group at a time, as DDR5 same-bank
+     * refresh does, while the other banks keep serving requests.
+     */
+    REFRESH_SAME_BANK = 2,
+} DRAMRefresh;
+
+/** Possible request schedulers for the DRAM controller. */
+typedef enum DRAMSchedulerEnum
+{
+    /**
+     * No controller: every access is served the moment it arrives, with a
+     * latency that depends only on the row buffer state.
+     */
+    SCHED_NONE = 0,
+    SCHED_FCFS = 1,       // Serve the oldest request whose bank is ready.
+    SCHED_FRFCFS = 2,     // Serve row hits first, then the oldest request.
+    /**
+     * Like FR-FCFS, but at most DRAM_SCHED_CAP younger row hits may be served
+     * ahead of an older request to the same bank.
+     */
+    SCHED_FRFCFS_CAP = 3,
+} DRAMScheduler;
+
+/** A request waiting in a DRAM controller queue. */
+typedef struct DRAMRequest
+{
+    uint64_t line_addr;
+
+    /** The bank's position in its channel's bank array. */
+    uint64_t bank;
+    uint64_t row;
+    bool is_write;
+    unsigned int core_id;
+
+    /** The cycle the request entered the queue. */
+    uint64_t arrival;
+
+    /** The order in which requests arrived, used to find the oldest one. */
+    uint64_t seq;
+
+    /** Whether a PRE or ACT has been issued on behalf of this request. */
+    bool started;
+
+    /** How the request found its row buffer when it was first served. */
+    RowOutcome outcome;
+
+    /** The cycle the first command for this request was issued. */
+    uint64_t first_cmd;
+} DRAMRequest;
+
+/** A bounded queue of DRAM requests, kept in arrival order. */
+typedef struct DRAMQueue
+{
+    DRAMRequest *entries;
+    unsigned int count;
+} DRAMQueue;
+
+/** The controller's view of one DRAM bank. */
+typedef struct DRAMBank
+{
+    DRAMQueue read_queue;
+    DRAMQueue write_queue;
+
+    /** The rank and bank group this bank belongs to. */
+    unsigned int rank;
+    unsigned int group;
+
+    bool row_open;
+    uint64_t open_row;
+
+    /** The first cycle at which each command may be issued to this bank. */
+    uint64_t next_act;
+    uint64_t next_pre;
+    uint64_t next_col;
+
+    /** The cycle of the last RD or WR to this bank. */
+    uint64_t last_col;
+
+    /** The cycle the last refresh of this bank ends. */
+    uint64_t refresh_end;
+
+    /**
+     * The number of row hits served ahead of the oldest request in this bank
+     * since that request arrived. Used by SCHED_FRFCFS_CAP.
+     */
+    unsigned int bypass_count;
+} DRAMBank;
+
+/** The timing state shared by all banks of one rank. */
+typedef struct DRAMRank
+{
+    /** The number of requests waiting for this rank. */
+    unsigned int pending;
+
+    /**
+     * The cycle the next refresh is due, and for same-bank refresh, which
+     * bank of each group it refreshes.
+     */
+    uint64_t next_refresh;
+    unsigned int refresh_bank;
+
+    /** The cycle of the last ACT, overall and within each bank group. */
+    uint64_t last_act;
+    uint64_t last_act_group[DRAM_MAX_BANK_GROUPS];
+
+    /** The cycles of the last DRAM_FAW_ACTS activations, oldest at faw_head. */
+    uint64_t faw[DRAM_FAW_ACTS];
+    unsigned int faw_head;
+
+    /** The cycle of the last RD or WR, overall and within each bank group. */
+    uint64_t last_col;
+    uint64_t last_col_group[DRAM_MAX_BANK_GROUPS];
+
+    /** The cycle of the last RD. */
+    uint64_t last_rd;
+
+    /** The cycle write data last ended, overall and within each bank group. */
+    uint64_t last_wr_end;
+    uint64_t last_wr_end_group[DRAM_MAX_BANK_GROUPS];
+} DRAMRank;
+
+/** One DRAM channel, with its own controller and data bus. */
+typedef struct DRAMChannel
+{
+    /**
+     * The controller state of each bank, rank by rank. Used when a scheduler
+     * is set.
+     */
+    DRAMBank *banks;
+    DRAMRank *ranks;
+
+    /**
+     * The next cycle at which the controller can issue a command. The
+     * controller is stepped lazily up to the current cycle on each access.
+     */
+    uint64_t ctrl_cycle;
+
+    /** The number of requests, and of writes, waiting in this channel. */
+    unsigned int pending;
+    unsigned int write_pending;
+
+    /** Whether the channel is draining writes, and since which cycle. */
+    bool draining;
+    uint64_t drain_start;
+
+    /** The cycle the data bus becomes free after the last transfer. */
+    uint64_t bus_free;
+
+    /** The number of lines read and written over this channel. */
+    unsigned long long stat_reads;
+    unsigned long long stat_writes;
+} DRAMChannel;
+
 /** A DRAM module. */
 typedef struct DRAM
 {
@@ -33,6 +347,113 @@ typedef struct DRAM
     //contents of row buffer
     RowBuffer* RowbufEntry;
 
+    /** The page policy state of each bank, indexed like RowbufEntry. */
+    DRAMPageState *pages;
+
+    /** The timing parameters of the selected preset. */
+    DRAMTiming timing;
+
+    /**
+     * The address mapping, as fields ordered from the least significant bits
+     * of the line address upward, with the width of each in bits. The row
+     * takes whatever bits are left.
+     */
+    DRAMField map_fields[6];
+    unsigned int map_bits[6];
+    unsigned int map_count;
+
+    /** The geometry of the DRAM module. */
+    unsigned int num_channels;
+    unsigned int banks_per_rank;
+    unsigned int banks_per_channel;
+
+    DRAMChannel *channels;
+
+    /** Whether accesses go through the controllers. */
+    bool scheduled;
+
+    /**
+     * The access path for the mode and controller, chosen once in dram_new()
+     * so that dram_access() does not re-check the configuration.
+     */
+    uint64_t (*access)(struct DRAM *dram, uint64_t line_addr,
+                       bool is_dram_write, unsigned int core_id);
+
+    /** The cycles between refreshes of a rank, and the time each takes. */
+    uint64_t refresh_interval;
+    uint64_t refresh_duration;
+
+    /** The sequence number of the next request to arrive. */
+    uint64_t next_seq;
+
+    /** The number of requests waiting in all queues. */
+    unsigned int pending;
+
+    /** The total number of cycles reads and writes spent queued. */
+    unsigned long long stat_read_queue_delay;
+    unsigned long long stat_write_queue_delay;
+
+    /** The largest number of requests that were waiting at once. */
+    unsigned int stat_max_pending;
+
+    /**
+     * The histograms of the delays of reads and writes (indexed by whether
+     * the access is a write), or NULL if they are not recorded.
+     */
+    Histogram *delay_hist;
+
+    /**
+     * The number of write drains, the writes and cycles they took, and the
+     * total number of cycles reads spent waiting on them.
+     */
+    unsigned long long stat_drains;
+    unsigned long long stat_drain_writes;
+    unsigned long long stat_drain_cycles;
+    unsigned long long stat_drain_read_delay;
+
+    /**
+     * The number of refreshes, and of those pulled in during idle time. The
+     * total and largest time a read waited for a refresh of its bank.
+     */
+    unsigned long long stat_refreshes;
+    unsigned long long stat_refresh_early;
+    unsigned long long stat_refresh_read_delay;
+    unsigned long long stat_refresh_read_max;
+
+    /** The total time accesses waited for a busy data bus. */
+    unsigned long long stat_bus_wait;
+
+    /** The device currents of the selected preset. */
+    DRAMCurrents currents;
+
+    /** The power state of each rank, channel by channel. */
+    DRAMRankPower *power;
+
+    /** The number of activations, and of exits from power-down. */
+    unsigned long long stat_activates;
+    unsigned long long stat_powerdowns;
+
+    /** The number of lines each core read and wrote. */
+    unsigned long long stat_core_reads[MAX_CORES];
+    unsigned long long stat_core_writes[MAX_CORES];
+
+    /**
+     * The total cycles banks spent serving accesses, the cycles at least one
+     * bank was busy, and the last cycle any was.
+     */
+    unsigned long long stat_bank_busy;
+    unsigned long long stat_any_busy;
+    uint64_t busy_until;
+
+    /**
+     * The number of lines transferred in each interval of DRAM_INTERVAL
+     * cycles, with room for interval_capacity intervals, of which
+     * interval_count have been seen.
+     */
+    unsigned long long *stat_interval_lines;
+    unsigned int interval_capacity;
+    unsigned int interval_count;
+
     /**
      * The total number of times DRAM was accessed for a read.
      * You should initialize this to 0 and update it for every DRAM read!
@@ -65,6 +486,21 @@ typedef enum DRAMPolicyEnum
 {
     OPEN_PAGE = 0,  // The DRAM uses an open-page policy.
     CLOSE_PAGE = 1, // The DRAM uses a close-page policy.
+    /**
+     * Each bank keeps its row open until it has been idle for
+     * DRAM_PAGE_TIMEOUT cycles.
+     */
+    PAGE_TIMEOUT = 2,
+    /**
+     * Each bank keeps its row open only if a counter trained on the bank's
+     * history predicts that the next access hits the same row.
+     */
+    PAGE_PREDICT = 3,
+    /**
+     * Each bank keeps its row open while more hits to it are waiting, for at
+     * most DRAM_PAGE_CAP hits in a row.
+     */
+    PAGE_OPEN_ADAPTIVE = 4,
 } DRAMPolicy;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -82,6 +518,115 @@ typedef enum DRAMPolicyEnum
 // The only restriction is that you must not remove dram_print_stats() or
 // modify its output format, since its output will be used for grading.
 
+/**
+ * Check whether a DRAM timing preset with the given name exists.
+ *
+ * @param name The name of the preset, such as "DDR4-3200".
+ * @return Whether the preset exists.
+ */
+bool dram_preset_exists(const char *name);
+
+/**
+ * Check whether an address mapping string is well formed for the configured
+ * DRAM geometry.
+ *
+ * The string lists the fields Ro (row), Ch (channel), Ra (rank), Bg (bank
+ * group), Ba (bank) and Co (column) from the most to the least significant
+ * bits, such as "RoChRaBaCo". Ro must come first. Without Bg, Ba selects among
+ * all banks of a rank. Ch and Ra may be left out when there is only one
+ * channel or rank.
+ *
+ * @param map The mapping string.
+ * @return Whether the mapping can be used.
+ */
+bool dram_map_valid(const char *map);
+
+/**
+ * Find where a line lives in the DRAM.
+ *
+ * @param dram The DRAM module.
+ * @param line_addr The address of the cache line (in units of the cache line
+ *                  size).
+ * @param loc Set to the location of the line.
+ */
+void dram_map(DRAM *dram, uint64_t line_addr, DRAMAddress *loc);
+
+/**
+ * Record how an access found the row buffer of its bank, and train the page
+ * policy state of the bank.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param row The row accessed.
+ * @param outcome How the access found the row buffer.
+ */
+void dram_page_record(DRAM *dram, uint64_t bank, uint64_t row,
+                      RowOutcome outcome);
+
+/**
+ * Decide whether a bank keeps its row open after an access, under the
+ * selected page policy.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param hits_waiting Whether more accesses to the open row are known to be
+ *                     waiting.
+ * @return Whether to leave the row open.
+ */
+bool dram_page_keep_open(DRAM *dram, uint64_t bank, bool hits_waiting);
+
+/**
+ * Record an access served by a bank, for the per-core, bank parallelism and
+ * bandwidth statistics.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param core_id The CPU core ID that caused the access.
+ * @param is_dram_write Whether the access wrote to DRAM.
+ * @param start The cycle the bank started serving the access.
+ * @param done The cycle the access completed.
+ */
+void dram_record_access(DRAM *dram, uint64_t bank, unsigned int core_id,
+                        bool is_dram_write, uint64_t start, uint64_t done);
+
+/**
+ * Record that a bank opened a row.
+ *
+ * @param dram The DRAM module.
+ * @param bank The index of the bank across all channels and ranks.
+ * @param now The cycle of the activation.
+ */
+void dram_power_open(DRAM *dram, uint64_t bank, uint64_t now);
+
+/**
+ * Record that a bank of a rank closed its row.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle of the precharge.
+ */
+void dram_power_close(DRAM *dram, unsigned int rank, uint64_t now);
+
+/**
+ * Wake an idle rank for a new access. A rank idle for longer than
+ * DRAM_POWERDOWN cycles has been powered down in the meantime.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle the access arrives.
+ * @return Whether the rank was powered down and must wait tXP.
+ */
+bool dram_power_wake(DRAM *dram, unsigned int rank, uint64_t now);
+
+/**
+ * Record that a rank has become idle.
+ *
+ * @param dram The DRAM module.
+ * @param rank The index of the rank among all ranks.
+ * @param now The cycle its last access completes.
+ */
+void dram_power_sleep(DRAM *dram, unsigned int rank, uint64_t now);
+
 /**
  * Allocate and initialize a DRAM module.
  * 
@@ -106,9 +651,11 @@ DRAM *dram_new();
  * @param line_addr The address of the cache line to access (in units of the
  *                  cache line size).
  * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
  * @return The delay in cycles incurred by this DRAM access.
  */
-uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write);
+uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write,
+                     unsigned int core_id);
 
 /**
  * For parts C through F, access the DRAM at the given cache line address.
@@ -125,10 +672,36 @@ uint64_t dram_access(DRAM *dram, uint64_t line_addr, bool is_dram_write);
  * @param line_addr The address of the cache line to access (in units of the
  *                  cache line size).
  * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
  * @return The delay in cycles incurred by this DRAM access.
  */
 uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
-                               bool is_dram_write);
+                               bool is_dram_write, unsigned int core_id);
+
+/**
+ * Access the DRAM through the controller, which queues the request and
+ * schedules it against the other waiting requests.
+ * 
+ * Reads return their full delay, including the time spent queued. Writes are
+ * posted: they return 0 and are issued later.
+ * 
+ * @param dram The DRAM module to access.
+ * @param line_addr The address of the cache line to access (in units of the
+ *                  cache line size).
+ * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
+ * @return The delay in cycles incurred by this DRAM access.
+ */
+uint64_t dram_ctrl_access(DRAM *dram, uint64_t line_addr, bool is_dram_write,
+                          unsigned int core_id);
+
+/**
+ * Issue every request still waiting in the controller queues, so that their
+ * delays are included in the statistics.
+ * 
+ * @param dram The DRAM module to drain.
+ */
+void dram_ctrl_drain(DRAM *dram);
 
 /**
  * Print the statistics of the DRAM module.
@@ -139,4 +712,22 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
  */
 void dram_print_stats(DRAM *dram);
 
+/**
+ * Add the statistics of the DRAM module to a registry, under the names
+ * dram_print_stats() prints them with. Call this after
+ * dram_print_stats(), which counts any posted writes still waiting.
+ *
+ * @param dram The DRAM module to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void dram_collect_stats(DRAM *dram, StatsRegistry *reg);
+
+/**
+ * Print the percentiles of the delays of DRAM reads and writes, if they are
+ * recorded.
+ *
+ * @param dram The DRAM module to print the statistics of.
+ */
+void dram_print_hist_stats(DRAM *dram);
+
 #endif // __DRAM_H__
@@ -0,0 +1,1082 @@
+// dramctrl.cpp
+// Defines the functions used to implement the DRAM controller, which queues
+// requests per bank and schedules them instead of serving each access the
+// moment it arrives.
+//
+// Each bank runs a state machine of ACT, RD/WR and PRE commands, and every
+// command waits until the DDR timing constraints of its bank, its bank group
+// and the rank allow it. Each channel has its own controller, which issues at
+// most one command per cycle.
+//
+// The controller is stepped lazily. Each access first catches the controller
+// up to the current cycle, issuing whatever the scheduler would have issued in
+// the meantime. A read then steps the controller forward until the read itself
+// is issued, which yields its queueing delay. Since that runs ahead of the
+// cores, a request that arrives later may still have its commands placed back
+// at its arrival cycle, as long as its bank's timing constraints allow it, so
+// that requests to other banks overlap with the read being waited for.
+
+#include "dram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Which page policy the DRAM should use. */
+extern DRAMPolicy DRAM_PAGE_POLICY;
+
+/** For PAGE_TIMEOUT, the idle cycles after which a bank closes its row. */
+extern uint64_t DRAM_PAGE_TIMEOUT;
+
+/** Which scheduler the DRAM controller should use. */
+extern DRAMScheduler DRAM_SCHEDULER;
+
+/**
+ * For SCHED_FRFCFS_CAP, the number of younger row hits that may be served
+ * ahead of an older request to the same bank.
+ */
+extern unsigned int DRAM_SCHED_CAP;
+
+/**
+ * The number of waiting writes at which a channel starts draining its write
+ * queues, or 0 to schedule reads and writes together.
+ */
+extern unsigned int DRAM_WQ_HIGH;
+
+/** The number of waiting writes at which a write drain ends. */
+extern unsigned int DRAM_WQ_LOW;
+
+/** The number of banks in each bank group. */
+extern unsigned int DRAM_BANKS_PER_GROUP;
+
+/** The number of ranks per channel. */
+extern unsigned int DRAM_RANKS;
+
+/** How the DRAM controller refreshes the banks. */
+extern DRAMRefresh DRAM_REFRESH;
+
+/**
+ * Whether refreshes are postponed while a rank is busy and pulled in while it
+ * is idle.
+ */
+extern bool DRAM_REFRESH_AWARE;
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The DRAM commands the controller issues. */
+typedef enum DRAMCommandEnum
+{
+    CMD_ACT, // Open a row.
+    CMD_PRE, // Close the open row.
+    CMD_RD,  // Read a line from the open row.
+    CMD_WR,  // Write a line to the open row.
+} DRAMCommand;
+
+/** What a single step of the controller issued. */
+typedef enum DRAMIssueEnum
+{
+    ISSUE_NONE,    // No command was ready.
+    ISSUE_COMMAND, // A PRE or ACT was issued.
+    ISSUE_REQUEST, // A RD or WR was issued, serving a request.
+} DRAMIssue;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Remove the request at the given position from a queue, keeping the rest in
+ * arrival order.
+ *
+ * @param queue The queue to remove from.
+ * @param index The position of the request to remove.
+ */
+static void dram_queue_remove(DRAMQueue *queue, unsigned int index)
+{
+    memmove(&queue->entries[index], &queue->entries[index + 1],
+            (queue->count - index - 1) * sizeof(DRAMRequest));
+    queue->count--;
+}
+
+/**
+ * Find the oldest request waiting for the given bank among the requests the
+ * controller is currently serving.
+ *
+ * @param bank The bank to search.
+ * @param serve Whether reads (index 0) and writes (index 1) are being served.
+ * @return The oldest request, or NULL if the bank has none.
+ */
+static DRAMRequest *dram_bank_oldest(DRAMBank *bank, const bool serve[2])
+{
+    DRAMRequest *oldest = NULL;
+    if (serve[0] && bank->read_queue.count > 0)
+    {
+        oldest = &bank->read_queue.entries[0];
+    }
+    if (serve[1] && bank->write_queue.count > 0 &&
+        (oldest == NULL || bank->write_queue.entries[0].seq < oldest->seq))
+    {
+        oldest = &bank->write_queue.entries[0];
+    }
+    return oldest;
+}
+
+/**
+ * Check whether any request waiting for the given bank targets a row.
+ *
+ * @param bank The bank to search.
+ * @param row The row to look for.
+ * @return Whether such a request is waiting.
+ */
+static bool dram_bank_has_row(DRAMBank *bank, uint64_t row)
+{
+    DRAMQueue *queues[2] = {&bank->read_queue, &bank->write_queue};
+    for (unsigned int q = 0; q < 2; q++)
+    {
+        for (unsigned int i = 0; i < queues[q]->count; i++)
+        {
+            if (queues[q]->entries[i].row == row)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Return the later of two cycles.
+ *
+ * @param a The first cycle.
+ * @param b The second cycle.
+ * @return The later cycle.
+ */
+static uint64_t dram_later(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+/**
+ * Find the index of a bank's rank among all ranks, as used by the power
+ * state.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the bank.
+ * @param bank The bank.
+ * @return The index of the rank.
+ */
+static unsigned int dram_rank_index(DRAM *dram, DRAMChannel *channel,
+                                    DRAMBank *bank)
+{
+    return (channel - dram->channels) * DRAM_RANKS + bank->rank;
+}
+
+/**
+ * Find the index of a bank across all channels and ranks, as used by the
+ * page state.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the bank.
+ * @param bank The bank.
+ * @return The index of the bank.
+ */
+static uint64_t dram_bank_index(DRAM *dram, DRAMChannel *channel,
+                                DRAMBank *bank)
+{
+    return (channel - dram->channels) * dram->banks_per_channel +
+           (bank - channel->banks);
+}
+
+/**
+ * Find the earliest cycle at which a command may be issued to a bank, given
+ * the timing state of the bank and of the rank. Column commands also wait
+ * until their data fits on the channel's bus after the previous transfer.
+ *
+ * @param dram The DRAM module the bank belongs to.
+ * @param channel The channel the bank belongs to.
+ * @param bank The bank to issue to.
+ * @param cmd The command to issue.
+ * @return The earliest cycle the command satisfies every timing constraint.
+ */
+static uint64_t dram_cmd_ready(DRAM *dram, DRAMChannel *channel,
+                               DRAMBank *bank, DRAMCommand cmd)
+{
+    DRAMTiming *t = &dram->timing;
+    DRAMRank *rank = &channel->ranks[bank->rank];
+    unsigned int group = bank->group;
+    uint64_t ready = 0;
+
+    switch (cmd)
+    {
+    case CMD_ACT:
+        ready = bank->next_act;
+        ready = dram_later(ready, rank->last_act + t->tRRD_S);
+        ready = dram_later(ready, rank->last_act_group[group] + t->tRRD_L);
+        ready = dram_later(ready, rank->faw[rank->faw_head] + t->tFAW);
+        break;
+    case CMD_PRE:
+        ready = bank->next_pre;
+        break;
+    case CMD_RD:
+        ready = bank->next_col;
+        if (channel->bus_free > t->tCL)
+        {
+            ready = dram_later(ready, channel->bus_free - t->tCL);
+        }
+        ready = dram_later(ready, rank->last_col + t->tCCD_S);
+        ready = dram_later(ready, rank->last_col_group[group] + t->tCCD_L);
+        ready = dram_later(ready, rank->last_wr_end + t->tWTR_S);
+        ready = dram_later(ready,
+                           rank->last_wr_end_group[group] + t->tWTR_L);
+        break;
+    case CMD_WR:
+        ready = bank->next_col;
+        if (channel->bus_free > t->tCWL)
+        {
+            ready = dram_later(ready, channel->bus_free - t->tCWL);
+        }
+        ready = dram_later(ready, rank->last_rd + t->tRTW);
+        ready = dram_later(ready, rank->last_col + t->tCCD_S);
+        ready = dram_later(ready, rank->last_col_group[group] + t->tCCD_L);
+        break;
+    }
+
+    return ready;
+}
+
+/**
+ * Find the command a request needs next, given the state of its bank.
+ *
+ * @param bank The bank of the request.
+ * @param req The request.
+ * @return The next command for the request.
+ */
+static DRAMCommand dram_next_cmd(DRAMBank *bank, DRAMRequest *req)
+{
+    if (bank->row_open && bank->open_row == req->row)
+    {
+        return req->is_write ? CMD_WR : CMD_RD;
+    }
+    return bank->row_open ? CMD_PRE : CMD_ACT;
+}
+
+/**
+ * Choose the command the scheduler issues at the controller's current cycle.
+ *
+ * Every waiting request offers the next command it needs. Of the commands
+ * whose timing constraints are met, FR-FCFS prefers column commands (row
+ * hits) and then the oldest request. A row that still has hits waiting is not
+ * precharged unless the bank has fallen back to FCFS.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel whose queues to search.
+ * @param bank_out Set to the bank of the chosen request.
+ * @param queue_out Set to the queue holding the chosen request.
+ * @param index_out Set to the position of the chosen request in its queue.
+ * @param serve Whether reads (index 0) and writes (index 1) are being served.
+ * @param cmd_out Set to the command to issue for the chosen request.
+ * @param time_out Set to the cycle at which the chosen command issues, which
+ *                 is never after the controller's current cycle.
+ * @param next_ready If no command can be issued, set to the earliest cycle
+ *                   at which one can.
+ * @return Whether a command can be issued this cycle.
+ */
+static bool dram_ctrl_pick(DRAM *dram, DRAMChannel *channel,
+                           const bool serve[2], DRAMBank **bank_out,
+                           DRAMQueue **queue_out, unsigned int *index_out,
+                           DRAMCommand *cmd_out, uint64_t *time_out,
+                           uint64_t *next_ready)
+{
+    DRAMRequest *best = NULL;
+    bool best_hit = false;
+    *next_ready = UINT64_MAX;
+
+    for (unsigned int b = 0; b < dram->banks_per_channel; b++)
+    {
+        DRAMBank *bank = &channel->banks[b];
+        DRAMRequest *oldest = dram_bank_oldest(bank, serve);
+        if (oldest == NULL)
+        {
+            continue;
+        }
+
+        // Once the cap is reached, the bank falls back to FCFS until its
+        // oldest request has been served.
+        bool hits_first = (DRAM_SCHEDULER == SCHED_FRFCFS) ||
+                          (DRAM_SCHEDULER == SCHED_FRFCFS_CAP &&
+                           bank->bypass_count < DRAM_SCHED_CAP);
+
+        DRAMQueue *queues[2] = {&bank->read_queue, &bank->write_queue};
+        bool hit_waiting = false;
+        for (unsigned int q = 0; q < 2 && hits_first && bank->row_open; q++)
+        {
+            if (!serve[q])
+            {
+                continue;
+            }
+            for (unsigned int i = 0; i < queues[q]->count; i++)
+            {
+                if (queues[q]->entries[i].row == bank->open_row)
+                {
+                    hit_waiting = true;
+                }
+            }
+        }
+
+        for (unsigned int q = 0; q < 2; q++)
+        {
+            for (unsigned int i = 0; i < queues[q]->count && serve[q]; i++)
+            {
+                DRAMRequest *req = &queues[q]->entries[i];
+                if (!hits_first && req != oldest)
+                {
+                    continue;
+                }
+
+                DRAMCommand cmd = dram_next_cmd(bank, req);
+                if (cmd == CMD_PRE && hit_waiting)
+                {
+                    continue;
+                }
+
+                uint64_t ready = dram_later(
+                    dram_cmd_ready(dram, channel, bank, cmd), req->arrival);
+                if (ready > channel->ctrl_cycle)
+                {
+                    if (ready < *next_ready)
+                    {
+                        *next_ready = ready;
+                    }
+                    continue;
+                }
+
+                bool hit = hits_first && (cmd == CMD_RD || cmd == CMD_WR);
+                if (best == NULL || (hit && !best_hit) ||
+                    (hit == best_hit && req->seq < best->seq))
+                {
+                    best = req;
+                    best_hit = hit;
+                    *bank_out = bank;
+                    *queue_out = queues[q];
+                    *index_out = i;
+                    *cmd_out = cmd;
+                    *time_out = ready;
+                }
+            }
+        }
+    }
+
+    return best != NULL;
+}
+
+/**
+ * Update the bank and rank state for an activation.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the bank.
+ * @param bank The bank being activated.
+ * @param row The row being opened.
+ * @param now The cycle the ACT is issued.
+ */
+static void dram_do_act(DRAM *dram, DRAMChannel *channel, DRAMBank *bank,
+                        uint64_t row, uint64_t now)
+{
+    DRAMTiming *t = &dram->timing;
+    DRAMRank *rank = &channel->ranks[bank->rank];
+
+    bank->row_open = true;
+    bank->open_row = row;
+    bank->next_col = now + t->tRCD;
+    bank->next_pre = now + t->tRAS;
+    bank->next_act = now + t->tRC;
+
+    rank->last_act = dram_later(rank->last_act, now);
+    rank->last_act_group[bank->group] =
+        dram_later(rank->last_act_group[bank->group], now);
+    rank->faw[rank->faw_head] = now;
+    rank->faw_head = (rank->faw_head + 1) % DRAM_FAW_ACTS;
+    dram_power_open(dram, dram_bank_index(dram, channel, bank), now);
+}
+
+/**
+ * Update the bank state for a precharge.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the bank.
+ * @param bank The bank being precharged.
+ * @param now The cycle the precharge happens.
+ */
+static void dram_do_pre(DRAM *dram, DRAMChannel *channel, DRAMBank *bank,
+                        uint64_t now)
+{
+    if (bank->row_open)
+    {
+        dram_power_close(dram, dram_rank_index(dram, channel, bank), now);
+    }
+    bank->row_open = false;
+    bank->next_act = dram_later(bank->next_act, now + dram->timing.tRP);
+}
+
+/**
+ * Update the bank and rank state for a column command.
+ *
+ * If the page policy closes the row, the command carries an auto-precharge,
+ * which closes the row as soon as tRAS, tRTP and tWR allow.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the bank.
+ * @param bank The bank being accessed.
+ * @param is_write Whether the command is a WR.
+ * @param keep_open Whether the row stays open after the command.
+ * @param now The cycle the command is issued.
+ * @return The cycle the data transfer ends.
+ */
+static uint64_t dram_do_col(DRAM *dram, DRAMChannel *channel, DRAMBank *bank,
+                            bool is_write, bool keep_open, uint64_t now)
+{
+    DRAMTiming *t = &dram->timing;
+    DRAMRank *rank = &channel->ranks[bank->rank];
+    uint64_t done;
+
+    if (is_write)
+    {
+        done = now + t->tCWL + t->tBURST;
+        bank->next_pre = dram_later(bank->next_pre, done + t->tWR);
+        rank->last_wr_end = dram_later(rank->last_wr_end, done);
+        rank->last_wr_end_group[bank->group] =
+            dram_later(rank->last_wr_end_group[bank->group], done);
+    }
+    else
+    {
+        done = now + t->tCL + t->tBURST;
+        bank->next_pre = dram_later(bank->next_pre, now + t->tRTP);
+        rank->last_rd = dram_later(rank->last_rd, now);
+    }
+
+    channel->bus_free = dram_later(channel->bus_free, done);
+    bank->last_col = now;
+    rank->last_col = dram_later(rank->last_col, now);
+    rank->last_col_group[bank->group] =
+        dram_later(rank->last_col_group[bank->group], now);
+
+    if (!keep_open)
+    {
+        dram_do_pre(dram, channel, bank, bank->next_pre);
+    }
+
+    return done;
+}
+
+/**
+ * Start or end a write drain on a channel, based on how many writes are
+ * waiting, and decide which requests the scheduler may serve.
+ *
+ * Reads have priority and writes wait in the write queues. Once
+ * DRAM_WQ_HIGH writes are waiting, or a bank's write queue is full, the
+ * channel serves only writes until no more than DRAM_WQ_LOW remain. Writes
+ * are also served whenever no reads are waiting.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel to update.
+ * @param serve Set to whether reads (index 0) and writes (index 1) may be
+ *              served.
+ */
+static void dram_ctrl_update_drain(DRAM *dram, DRAMChannel *channel,
+                                   bool serve[2])
+{
+    serve[0] = true;
+    serve[1] = true;
+    if (DRAM_WQ_HIGH == 0)
+    {
+        return;
+    }
+
+    uint64_t now = channel->ctrl_cycle;
+    if (!channel->draining)
+    {
+        bool full = channel->write_pending >= DRAM_WQ_HIGH;
+        for (unsigned int b = 0; b < dram->banks_per_channel && !full; b++)
+        {
+            full = channel->banks[b].write_queue.count >= DRAM_QUEUE_SIZE;
+        }
+
+        if (full)
+        {
+            channel->draining = true;
+            channel->drain_start = now;
+            dram->stat_drains++;
+        }
+    }
+    else if (channel->write_pending <= DRAM_WQ_LOW)
+    {
+        // Every read that waited during the drain was held back by it.
+        for (unsigned int b = 0; b < dram->banks_per_channel; b++)
+        {
+            DRAMQueue *queue = &channel->banks[b].read_queue;
+            for (unsigned int i = 0; i < queue->count; i++)
+            {
+                uint64_t from = dram_later(channel->drain_start,
+                                           queue->entries[i].arrival);
+                if (from < now)
+                {
+                    dram->stat_drain_read_delay += now - from;
+                }
+            }
+        }
+
+        channel->draining = false;
+        dram->stat_drain_cycles += now - channel->drain_start;
+    }
+
+    serve[0] = !channel->draining;
+    serve[1] = channel->draining ||
+               channel->pending == channel->write_pending;
+}
+
+/**
+ * Check whether a bank is refreshed by its rank's next refresh.
+ *
+ * @param rank The rank of the bank.
+ * @param index The bank's position within its rank.
+ * @return Whether the next refresh covers the bank.
+ */
+static bool dram_refresh_covers(DRAMRank *rank, unsigned int index)
+{
+    return DRAM_REFRESH == REFRESH_ALL_BANK ||
+           index % DRAM_BANKS_PER_GROUP == rank->refresh_bank;
+}
+
+/**
+ * Find the cycle at which a rank's next refresh must start.
+ *
+ * Under refresh-aware scheduling, a busy rank postpones the refresh for as
+ * long as DRAM_REFRESH_SLACK allows.
+ *
+ * @param dram The DRAM module.
+ * @param rank The rank to check.
+ * @return The cycle.
+ */
+static uint64_t dram_refresh_trigger(DRAM *dram, DRAMRank *rank)
+{
+    if (DRAM_REFRESH_AWARE && rank->pending > 0)
+    {
+        return rank->next_refresh +
+               (DRAM_REFRESH_SLACK - 1) * dram->refresh_interval;
+    }
+    return rank->next_refresh;
+}
+
+/**
+ * Find the earliest cycle a rank's next refresh can start, once the banks it
+ * covers have been precharged.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the rank.
+ * @param r The index of the rank in the channel.
+ * @param earliest The earliest cycle the refresh may start.
+ * @return The cycle.
+ */
+static uint64_t dram_refresh_start(DRAM *dram, DRAMChannel *channel,
+                                   unsigned int r, uint64_t earliest)
+{
+    DRAMRank *rank = &channel->ranks[r];
+    uint64_t start = earliest;
+
+    for (unsigned int b = 0; b < dram->banks_per_rank; b++)
+    {
+        DRAMBank *bank = &channel->banks[r * dram->banks_per_rank + b];
+        if (!dram_refresh_covers(rank, b))
+        {
+            continue;
+        }
+
+        uint64_t ready = bank->next_act;
+        if (bank->row_open)
+        {
+            ready = dram_later(bank->next_pre, earliest) + dram->timing.tRP;
+        }
+        start = dram_later(start, ready);
+    }
+
+    return start;
+}
+
+/**
+ * Refresh the banks covered by a rank's next refresh: close their rows and
+ * block them until the refresh ends.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel of the rank.
+ * @param r The index of the rank in the channel.
+ * @param start The cycle the refresh starts.
+ */
+static void dram_do_refresh(DRAM *dram, DRAMChannel *channel, unsigned int r,
+                            uint64_t start)
+{
+    DRAMRank *rank = &channel->ranks[r];
+    uint64_t end = start + dram->refresh_duration;
+
+    for (unsigned int b = 0; b < dram->banks_per_rank; b++)
+    {
+        DRAMBank *bank = &channel->banks[r * dram->banks_per_rank + b];
+        if (!dram_refresh_covers(rank, b))
+        {
+            continue;
+        }
+
+        if (bank->row_open)
+        {
+            dram_power_close(dram, dram_rank_index(dram, channel, bank),
+                             start);
+        }
+        bank->row_open = false;
+        bank->next_act = dram_later(bank->next_act, end);
+        bank->refresh_end = end;
+    }
+
+    rank->next_refresh += dram->refresh_interval;
+    rank->refresh_bank = (rank->refresh_bank + 1) % DRAM_BANKS_PER_GROUP;
+    dram->stat_refreshes++;
+
+    #ifdef DEBUG
+        printf("\t\tDRAM REF (cycle: %lu, rank: %u, end: %lu)\n",
+               start, r, end);
+    #endif
+}
+
+/**
+ * Issue a refresh to a rank of the channel whose refresh has become due.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel to check.
+ * @param next_trigger Set to the earliest cycle a refresh becomes due, if
+ *                     none is due now.
+ * @return Whether a refresh was issued.
+ */
+static bool dram_ctrl_refresh(DRAM *dram, DRAMChannel *channel,
+                              uint64_t *next_trigger)
+{
+    *next_trigger = UINT64_MAX;
+    if (DRAM_REFRESH == REFRESH_OFF)
+    {
+        return false;
+    }
+
+    for (unsigned int r = 0; r < DRAM_RANKS; r++)
+    {
+        uint64_t trigger = dram_refresh_trigger(dram, &channel->ranks[r]);
+        if (trigger <= channel->ctrl_cycle)
+        {
+            dram_do_refresh(dram, channel, r,
+                            dram_refresh_start(dram, channel, r, trigger));
+            return true;
+        }
+        if (trigger < *next_trigger)
+        {
+            *next_trigger = trigger;
+        }
+    }
+    return false;
+}
+
+/**
+ * Issue the refreshes that fall into an idle period of the channel, which
+ * ends when the next request arrives.
+ *
+ * Under refresh-aware scheduling, up to DRAM_REFRESH_SLACK refreshes are also
+ * pulled in ahead of time, as long as they end before the idle period does.
+ *
+ * @param dram The DRAM module.
+ * @param channel The idle channel.
+ * @param until The cycle the idle period ends.
+ */
+static void dram_ctrl_refresh_idle(DRAM *dram, DRAMChannel *channel,
+                                   uint64_t until)
+{
+    if (DRAM_REFRESH == REFRESH_OFF)
+    {
+        return;
+    }
+
+    for (unsigned int r = 0; r < DRAM_RANKS; r++)
+    {
+        DRAMRank *rank = &channel->ranks[r];
+
+        while (rank->next_refresh < until)
+        {
+            dram_do_refresh(dram, channel, r,
+                            dram_refresh_start(dram, channel, r,
+                                               rank->next_refresh));
+        }
+
+        while (DRAM_REFRESH_AWARE &&
+               rank->next_refresh < channel->ctrl_cycle +
+                                        DRAM_REFRESH_SLACK *
+                                            dram->refresh_interval)
+        {
+            uint64_t start = dram_refresh_start(dram, channel, r,
+                                                channel->ctrl_cycle);
+            if (start + dram->refresh_duration > until)
+            {
+                break;
+            }
+            dram_do_refresh(dram, channel, r, start);
+            dram->stat_refresh_early++;
+        }
+    }
+}
+
+/**
+ * Issue one command, if the scheduler finds one, and advance the controller
+ * past the cycle used to issue it.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel to issue on.
+ * @param issued Set to the request served, if a RD or WR was issued.
+ * @param done Set to the cycle at which the served request completes.
+ * @param next_ready If nothing was issued, set to the earliest cycle at which
+ *                   a command can be.
+ * @return What kind of command was issued, if any.
+ */
+static DRAMIssue dram_ctrl_issue(DRAM *dram, DRAMChannel *channel,
+                                 DRAMRequest *issued, uint64_t *done,
+                                 uint64_t *next_ready)
+{
+    DRAMBank *bank = NULL;
+    DRAMQueue *queue;
+    unsigned int index;
+    DRAMCommand cmd;
+    uint64_t now = 0;
+    bool serve[2];
+
+    uint64_t next_trigger;
+    if (dram_ctrl_refresh(dram, channel, &next_trigger))
+    {
+        return ISSUE_COMMAND;
+    }
+
+    dram_ctrl_update_drain(dram, channel, serve);
+    if (!dram_ctrl_pick(dram, channel, serve, &bank, &queue, &index, &cmd,
+                        &now, next_ready))
+    {
+        if (next_trigger < *next_ready)
+        {
+            *next_ready = next_trigger;
+        }
+        return ISSUE_NONE;
+    }
+
+    // Only a command at the current cycle occupies the command bus; one
+    // placed back in time fills a cycle that was left idle.
+    DRAMRequest *req = &queue->entries[index];
+    if (now == channel->ctrl_cycle)
+    {
+        channel->ctrl_cycle++;
+    }
+
+    if (cmd == CMD_ACT || cmd == CMD_PRE)
+    {
+        if (!req->started)
+        {
+            req->started = true;
+            req->first_cmd = now;
+            req->outcome = (cmd == CMD_PRE) ? ROW_CONFLICT : ROW_MISS;
+
+            // A read whose bank was refreshed while it waited was held up
+            // until the refresh ended. Only the time from the later of its
+            // arrival and the refresh's start is the refresh's doing.
+            if (!req->is_write && bank->refresh_end > req->arrival)
+            {
+                uint64_t start = bank->refresh_end - dram->refresh_duration;
+                uint64_t from = dram_later(req->arrival, start);
+                uint64_t end = (bank->refresh_end < now) ? bank->refresh_end
+                                                         : now;
+                uint64_t wait = (end > from) ? end - from : 0;
+                dram->stat_refresh_read_delay += wait;
+                if (wait > dram->stat_refresh_read_max)
+                {
+                    dram->stat_refresh_read_max = wait;
+                }
+            }
+        }
+
+        if (cmd == CMD_ACT)
+        {
+            dram_do_act(dram, channel, bank, req->row, now);
+        }
+        else
+        {
+            dram_do_pre(dram, channel, bank, now);
+        }
+
+        #ifdef DEBUG
+            printf("\t\tDRAM %s (cycle: %lu, bank: %lu, row: %lu)\n",
+                   (cmd == CMD_ACT) ? "ACT" : "PRE", now, req->bank, req->row);
+        #endif
+
+        return ISSUE_COMMAND;
+    }
+
+    DRAMRequest *oldest = dram_bank_oldest(bank, serve);
+    if (oldest->seq == req->seq)
+    {
+        bank->bypass_count = 0;
+    }
+    else
+    {
+        bank->bypass_count++;
+    }
+
+    *issued = *req;
+    dram_queue_remove(queue, index);
+
+    uint64_t page = dram_bank_index(dram, channel, bank);
+    dram_page_record(dram, page, issued->row,
+                     issued->started ? issued->outcome : ROW_HIT);
+    bool keep_open = dram_page_keep_open(
+        dram, page, dram_bank_has_row(bank, issued->row));
+    *done = dram_do_col(dram, channel, bank, issued->is_write, keep_open, now);
+    channel->pending--;
+    if (--channel->ranks[bank->rank].pending == 0)
+    {
+        dram_power_sleep(dram, dram_rank_index(dram, channel, bank), *done);
+    }
+    dram->pending--;
+    if (issued->is_write)
+    {
+        channel->write_pending--;
+        if (channel->draining)
+        {
+            dram->stat_drain_writes++;
+        }
+    }
+
+    uint64_t queue_delay = (issued->started ? issued->first_cmd : now) -
+                           issued->arrival;
+    if (issued->is_write)
+    {
+        dram->stat_write_access++;
+        dram->stat_write_delay += *done - issued->arrival;
+        dram->stat_write_queue_delay += queue_delay;
+        channel->stat_writes++;
+    }
+    else
+    {
+        dram->stat_read_access++;
+        dram->stat_read_delay += *done - issued->arrival;
+        dram->stat_read_queue_delay += queue_delay;
+        channel->stat_reads++;
+    }
+    if (dram->delay_hist != NULL)
+    {
+        histogram_record(&dram->delay_hist[issued->is_write],
+                         *done - issued->arrival);
+    }
+    dram_record_access(dram, page, issued->core_id, issued->is_write,
+                       issued->started ? issued->first_cmd : now, *done);
+
+    #ifdef DEBUG
+        printf("\t\tDRAM %s (cycle: %lu, bank: %lu, row: %lu, queued: %lu, done: %lu)\n",
+               issued->is_write ? "WR" : "RD", now, issued->bank, issued->row,
+               queue_delay, *done);
+    #endif
+
+    return ISSUE_REQUEST;
+}
+
+/**
+ * Step a channel's controller until it reaches the given cycle, issuing
+ * commands along the way.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel to step.
+ * @param target The cycle to step to.
+ */
+static void dram_ctrl_advance(DRAM *dram, DRAMChannel *channel,
+                              uint64_t target)
+{
+    DRAMRequest issued;
+    uint64_t done;
+    uint64_t next;
+
+    while (channel->ctrl_cycle < target)
+    {
+        if (channel->pending == 0)
+        {
+            dram_ctrl_refresh_idle(dram, channel, target);
+            channel->ctrl_cycle = target;
+            break;
+        }
+
+        if (dram_ctrl_issue(dram, channel, &issued, &done, &next) ==
+            ISSUE_NONE)
+        {
+            channel->ctrl_cycle = (next < target) ? next : target;
+        }
+    }
+}
+
+/**
+ * Step a channel's controller until the request with the given sequence
+ * number is served.
+ *
+ * @param dram The DRAM module.
+ * @param channel The channel holding the request.
+ * @param seq The sequence number of the request to wait for.
+ * @return The cycle at which that request completes.
+ */
+static uint64_t dram_ctrl_wait(DRAM *dram, DRAMChannel *channel, uint64_t seq)
+{
+    DRAMRequest issued;
+    uint64_t done;
+    uint64_t next;
+
+    for (;;)
+    {
+        DRAMIssue result = dram_ctrl_issue(dram, channel, &issued, &done,
+                                           &next);
+        if (result == ISSUE_REQUEST && issued.seq == seq)
+        {
+            return done;
+        }
+        if (result == ISSUE_NONE)
+        {
+            channel->ctrl_cycle = next;
+        }
+    }
+}
+
+/**
+ * Access the DRAM through the controller, which queues the request and
+ * schedules it against the other waiting requests.
+ *
+ * Reads return their full delay, including the time spent queued. Writes are
+ * posted: they return 0 and are issued later.
+ *
+ * @param dram The DRAM module to access.
+ * @param line_addr The address of the cache line to access (in units of the
+ *                  cache line size).
+ * @param is_dram_write Whether this access writes to DRAM.
+ * @param core_id The CPU core ID that caused this access.
+ * @return The delay in cycles incurred by this DRAM access.
+ */
+uint64_t dram_ctrl_access(DRAM *dram, uint64_t line_addr, bool is_dram_write,
+                          unsigned int core_id)
+{
+    DRAMAddress loc;
+    dram_map(dram, line_addr, &loc);
+
+    DRAMChannel *channel = &dram->channels[loc.channel];
+    dram_ctrl_advance(dram, channel, current_cycle);
+
+    uint64_t bank_index = loc.rank * dram->banks_per_rank + loc.bank;
+    DRAMBank *bank = &channel->banks[bank_index];
+    DRAMQueue *queue = is_dram_write ? &bank->write_queue : &bank->read_queue;
+
+    // Under PAGE_TIMEOUT, a row left idle for long enough has been closed in
+    // the meantime.
+    if (DRAM_PAGE_POLICY == PAGE_TIMEOUT && bank->row_open &&
+        bank->read_queue.count + bank->write_queue.count == 0)
+    {
+        uint64_t close_at = dram_later(bank->next_pre,
+                                       bank->last_col + DRAM_PAGE_TIMEOUT);
+        if (close_at <= current_cycle)
+        {
+            dram_do_pre(dram, channel, bank, close_at);
+        }
+    }
+
+    // A rank that has powered down while idle takes tXP to wake up.
+    DRAMRank *rank = &channel->ranks[bank->rank];
+    if (rank->pending == 0 &&
+        dram_power_wake(dram, dram_rank_index(dram, channel, bank),
+                        current_cycle))
+    {
+        uint64_t awake = current_cycle + dram->timing.tXP;
+        for (unsigned int b = 0; b < dram->banks_per_rank; b++)
+        {
+            DRAMBank *other = &channel->banks[bank->rank * dram->banks_per_rank +
+                                              b];
+            other->next_act = dram_later(other->next_act, awake);
+            other->next_pre = dram_later(other->next_pre, awake);
+            other->next_col = dram_later(other->next_col, awake);
+        }
+    }
+
+    // A full queue stalls the requester until the scheduler makes room.
+    while (queue->count >= DRAM_QUEUE_SIZE)
+    {
+        DRAMRequest issued;
+        uint64_t done;
+        uint64_t next;
+        if (dram_ctrl_issue(dram, channel, &issued, &done, &next) ==
+            ISSUE_NONE)
+        {
+            channel->ctrl_cycle = next;
+        }
+    }
+
+    DRAMRequest *req = &queue->entries[queue->count++];
+    req->line_addr = line_addr;
+    req->bank = bank_index;
+    req->row = loc.row;
+    req->is_write = is_dram_write;
+    req->core_id = core_id;
+    req->arrival = current_cycle;
+    req->seq = dram->next_seq++;
+    req->started = false;
+
+    channel->pending++;
+    rank->pending++;
+    dram->pending++;
+    if (is_dram_write)
+    {
+        channel->write_pending++;
+    }
+    if (dram->pending > dram->stat_max_pending)
+    {
+        dram->stat_max_pending = dram->pending;
+    }
+
+    if (is_dram_write)
+    {
+        return 0;
+    }
+
+    uint64_t done = dram_ctrl_wait(dram, channel, req->seq);
+    return done - current_cycle;
+}
+
+/**
+ * Issue every request still waiting in the controller queues, so that their
+ * delays are included in the statistics.
+ *
+ * @param dram The DRAM module to drain.
+ */
+void dram_ctrl_drain(DRAM *dram)
+{
+    DRAMRequest issued;
+    uint64_t done;
+    uint64_t next;
+
+    for (unsigned int c = 0; c < dram->num_channels; c++)
+    {
+        DRAMChannel *channel = &dram->channels[c];
+        while (channel->pending > 0)
+        {
+            if (dram_ctrl_issue(dram, channel, &issued, &done, &next) ==
+                ISSUE_NONE)
+            {
+                channel->ctrl_cycle = next;
+            }
+        }
+    }
+}
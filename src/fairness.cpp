@@ -0,0 +1,223 @@
+// fairness.cpp
+// Defines the functions used to simulate traces alone and compute the
+// multiprogram fairness metrics.
+
+#include "fairness.h"
+#include "memsys.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number of this thread. */
+extern thread_local uint64_t current_cycle;
+
+/** Whether cores replay their traces until all reach their targets. */
+extern bool CORE_REPLAY;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Simulate one trace alone until it finishes, or in replay mode until it
+ * reaches its instruction target.
+ *
+ * @param arg The alone run.
+ * @return NULL.
+ */
+static void *fairness_alone_run(void *arg)
+{
+    AloneRun *run = (AloneRun *)arg;
+
+    MemorySystem *sys = memsys_new();
+    Core *core = (sys != NULL)
+                     ? core_new(sys, run->trace_filename, run->core_id)
+                     : NULL;
+    if (core == NULL)
+    {
+        run->failed = true;
+        return NULL;
+    }
+
+    for (current_cycle = 0; !(CORE_REPLAY ? core->frozen : core->done);
+         current_cycle++)
+    {
+        core_cycle(core);
+        if (CORE_REPLAY)
+        {
+            core_check_target(core);
+        }
+    }
+
+    run->inst_count = core->done_inst_count;
+    run->cycle_count = core->done_cycle_count;
+    core_close_trace(core);
+    return NULL;
+}
+
+/**
+ * Start simulating each trace alone, on a thread of its own.
+ *
+ * @param trace_filenames The trace of each core.
+ * @param num_cores The number of cores.
+ * @param serial Whether to simulate the runs one at a time.
+ * @return A pointer to the alone runs.
+ */
+Fairness *fairness_start(const char **trace_filenames, unsigned int num_cores,
+                         bool serial)
+{
+    Fairness *f = (Fairness *)calloc(1, sizeof(Fairness));
+    f->num_runs = num_cores;
+    f->serial = serial;
+
+    for (unsigned int i = 0; i < num_cores; i++)
+    {
+        AloneRun *run = &f->runs[i];
+        run->trace_filename = trace_filenames[i];
+        run->core_id = i;
+
+        if (serial)
+        {
+            srand(42);
+        }
+        if (pthread_create(&run->thread, NULL, fairness_alone_run, run) != 0)
+        {
+            fprintf(stderr, "Error: could not start the alone run of core "
+                            "%u\n", i);
+            exit(1);
+        }
+        if (serial)
+        {
+            pthread_join(run->thread, NULL);
+        }
+    }
+
+    return f;
+}
+
+/**
+ * Wait for every alone run to finish.
+ *
+ * @param f The alone runs.
+ */
+void fairness_wait(Fairness *f)
+{
+    for (unsigned int i = 0; i < f->num_runs && !f->serial; i++)
+    {
+        pthread_join(f->runs[i].thread, NULL);
+    }
+}
+
+/**
+ * Compute the IPC of each trace alone, its slowdown in the mix, and the
+ * weighted speedup, harmonic speedup and maximum slowdown of the mix.
+ *
+ * @param f The alone runs, which must have finished.
+ * @param cores The cores that simulated the mix.
+ * @param ipc_alone The IPC of each trace alone, which is filled in.
+ * @param slowdown The slowdown of each trace, which is filled in.
+ * @param metrics The weighted speedup, harmonic speedup and maximum
+ *                slowdown, which are filled in.
+ */
+static void fairness_compute(Fairness *f, Core **cores, double *ipc_alone,
+                             double *slowdown, double *metrics)
+{
+    double weighted_speedup = 0.0;
+    double inverse_sum = 0.0;
+    double max_slowdown = 0.0;
+
+    for (unsigned int i = 0; i < f->num_runs; i++)
+    {
+        AloneRun *run = &f->runs[i];
+        double ipc_shared = 0.0;
+        ipc_alone[i] = 0.0;
+        slowdown[i] = 0.0;
+        if (!run->failed && run->cycle_count)
+        {
+            ipc_alone[i] = (double)(run->inst_count) /
+                           (double)(run->cycle_count);
+        }
+        if (cores[i]->done_cycle_count)
+        {
+            ipc_shared = (double)(cores[i]->done_inst_count) /
+                         (double)(cores[i]->done_cycle_count);
+        }
+        if (ipc_alone[i] > 0.0 && ipc_shared > 0.0)
+        {
+            slowdown[i] = ipc_alone[i] / ipc_shared;
+            weighted_speedup += ipc_shared / ipc_alone[i];
+            inverse_sum += slowdown[i];
+        }
+        if (slowdown[i] > max_slowdown)
+        {
+            max_slowdown = slowdown[i];
+        }
+    }
+
+    double harmonic_speedup = 0.0;
+    if (inverse_sum > 0.0)
+    {
+        harmonic_speedup = (double)(f->num_runs) / inverse_sum;
+    }
+
+    metrics[0] = weighted_speedup;
+    metrics[1] = harmonic_speedup;
+    metrics[2] = max_slowdown;
+}
+
+/**
+ * Print the IPC of each trace alone, its slowdown in the mix, and the
+ * weighted speedup, harmonic speedup and maximum slowdown of the mix.
+ *
+ * @param f The alone runs, which must have finished.
+ * @param cores The cores that simulated the mix.
+ */
+void fairness_print_stats(Fairness *f, Core **cores)
+{
+    double ipc_alone[MAX_CORES];
+    double slowdown[MAX_CORES];
+    double metrics[3];
+    fairness_compute(f, cores, ipc_alone, slowdown, metrics);
+
+    printf("\n");
+    for (unsigned int i = 0; i < f->num_runs; i++)
+    {
+        printf("CORE_%01u_IPC_ALONE    \t\t : %10.3f\n", i, ipc_alone[i]);
+        printf("CORE_%01u_SLOWDOWN     \t\t : %10.3f\n", i, slowdown[i]);
+    }
+
+    printf("WEIGHTED_SPEEDUP     \t\t : %10.3f\n", metrics[0]);
+    printf("HARMONIC_SPEEDUP     \t\t : %10.3f\n", metrics[1]);
+    printf("MAX_SLOWDOWN         \t\t : %10.3f\n", metrics[2]);
+}
+
+/**
+ * Add the fairness statistics of the mix to a registry, under the names
+ * fairness_print_stats() prints them with.
+ *
+ * @param f The alone runs, which must have finished.
+ * @param cores The cores that simulated the mix.
+ * @param reg The registry to add the statistics to.
+ */
+void fairness_collect_stats(Fairness *f, Core **cores, StatsRegistry *reg)
+{
+    double ipc_alone[MAX_CORES];
+    double slowdown[MAX_CORES];
+    double metrics[3];
+    fairness_compute(f, cores, ipc_alone, slowdown, metrics);
+
+    char prefix[16];
+    for (unsigned int i = 0; i < f->num_runs; i++)
+    {
+        snprintf(prefix, sizeof(prefix), "CORE_%01u", i);
+        stats_add_real(reg, prefix, "IPC_ALONE", ipc_alone[i]);
+        stats_add_real(reg, prefix, "SLOWDOWN", slowdown[i]);
+    }
+
+    stats_add_real(reg, NULL, "WEIGHTED_SPEEDUP", metrics[0]);
+    stats_add_real(reg, NULL, "HARMONIC_SPEEDUP", metrics[1]);
+    stats_add_real(reg, NULL, "MAX_SLOWDOWN", metrics[2]);
+}
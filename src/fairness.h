@@ -0,0 +1,93 @@
+// fairness.h
+// Declares the alone runs behind the multiprogram fairness metrics.
+//
+// Each trace of a mix is also simulated alone, on the same core of a memory
+// system of its own, with every other core idle. Comparing a trace's IPC in
+// the mix with its IPC alone gives its slowdown, from which the weighted
+// speedup (the sum of IPC_shared / IPC_alone), the harmonic speedup (the
+// number of traces over the sum of IPC_alone / IPC_shared) and the maximum
+// slowdown follow. The alone runs execute on threads of their own while the
+// mix is simulated.
+
+#ifndef __FAIRNESS_H__
+#define __FAIRNESS_H__
+
+#include "types.h"
+#include "core.h"
+#include <pthread.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The simulation of one trace alone. */
+typedef struct AloneRun
+{
+    const char *trace_filename;
+    unsigned int core_id;
+    pthread_t thread;
+
+    /** The instructions and cycles the trace took to reach its target. */
+    unsigned long long inst_count;
+    unsigned long long cycle_count;
+
+    /** Whether the run could not be simulated. */
+    bool failed;
+} AloneRun;
+
+/** The alone runs of every trace of a mix. */
+typedef struct Fairness
+{
+    AloneRun runs[MAX_CORES];
+    unsigned int num_runs;
+
+    /** Whether the runs were simulated one at a time, before the mix. */
+    bool serial;
+} Fairness;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Start simulating each trace alone, on a thread of its own.
+ *
+ * With serial set, the runs are simulated one at a time and have finished
+ * when this returns. This keeps them reproducible when the caches replace
+ * randomly, since rand() is shared by all threads.
+ *
+ * @param trace_filenames The trace of each core.
+ * @param num_cores The number of cores.
+ * @param serial Whether to simulate the runs one at a time.
+ * @return A pointer to the alone runs.
+ */
+Fairness *fairness_start(const char **trace_filenames, unsigned int num_cores,
+                         bool serial);
+
+/**
+ * Wait for every alone run to finish.
+ *
+ * @param f The alone runs.
+ */
+void fairness_wait(Fairness *f);
+
+/**
+ * Print the IPC of each trace alone, its slowdown in the mix, and the
+ * weighted speedup, harmonic speedup and maximum slowdown of the mix.
+ *
+ * @param f The alone runs, which must have finished.
+ * @param cores The cores that simulated the mix.
+ */
+void fairness_print_stats(Fairness *f, Core **cores);
+
+/**
+ * Add the fairness statistics of the mix to a registry, under the names
+ * fairness_print_stats() prints them with.
+ *
+ * @param f The alone runs, which must have finished.
+ * @param cores The cores that simulated the mix.
+ * @param reg The registry to add the statistics to.
+ */
+void fairness_collect_stats(Fairness *f, Core **cores, StatsRegistry *reg);
+
+#endif // __FAIRNESS_H__
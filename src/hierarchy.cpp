@@ -0,0 +1,633 @@
+// hierarchy.cpp
+// Defines the functions used to build and access a configurable cache
+// hierarchy.
+
+#include "hierarchy.h"
+#include "selfprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of bytes in a cache line. */
+extern uint64_t CACHE_LINESIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Which accesses a cache level serves. */
+typedef enum HierCacheTypeEnum
+{
+    HIER_TYPE_INST = 0,
+    HIER_TYPE_DATA = 1,
+    HIER_TYPE_UNIFIED = 2,
+} HierCacheType;
+
+/** One line of the configuration file. */
+typedef struct HierCacheSpec
+{
+    /** Shorter than HIER_NAME_LEN to leave room for a core ID suffix. */
+    char name[16];
+    unsigned int level;
+    HierCacheType type;
+    bool shared;
+    uint64_t size_kb;
+    uint64_t assoc;
+    uint64_t latency;
+    ReplacementPolicy repl;
+    InclusionPolicy inclusion;
+} HierCacheSpec;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+static uint64_t hier_cache_access(Hierarchy *h, HierCache *hc,
+                                  uint64_t line_addr, bool is_write,
+                                  unsigned int core_id, bool *fill_dirty);
+static void hier_writeback(Hierarchy *h, HierCache *hc, uint64_t line_addr,
+                           bool dirty, unsigned int core_id);
+static void hier_evict(Hierarchy *h, HierCache *hc, uint64_t line_addr,
+                       unsigned int core_id);
+
+/**
+ * Parse one non-comment line of the configuration file.
+ *
+ * @param line The line to parse.
+ * @param spec The spec to fill in.
+ * @return An error message, or NULL on success.
+ */
+static const char *hier_parse_spec(const char *line, HierCacheSpec *spec)
+{
+    char type[16];
+    char sharing[16];
+    char inclusion[16];
+    unsigned int level;
+    unsigned long long size_kb, assoc, latency;
+    int repl;
+
+    if (sscanf(line, "%15s %u %15s %15s %llu %llu %llu %d %15s", spec->name,
+               &level, type, sharing, &size_kb, &assoc, &latency, &repl,
+               inclusion) != 9)
+    {
+        return "expected 9 fields";
+    }
+
+    spec->level = level;
+    spec->size_kb = size_kb;
+    spec->assoc = assoc;
+    spec->latency = latency;
+
+    if (strcasecmp(type, "inst") == 0)
+    {
+        spec->type = HIER_TYPE_INST;
+    }
+    else if (strcasecmp(type, "data") == 0)
+    {
+        spec->type = HIER_TYPE_DATA;
+    }
+    else if (strcasecmp(type, "unified") == 0)
+    {
+        spec->type = HIER_TYPE_UNIFIED;
+    }
+    else
+    {
+        return "type must be inst, data, or unified";
+    }
+
+    if (strcasecmp(sharing, "private") == 0)
+    {
+        spec->shared = false;
+    }
+    else if (strcasecmp(sharing, "shared") == 0)
+    {
+        spec->shared = true;
+    }
+    else
+    {
+        return "sharing must be private or shared";
+    }
+
+    if (repl < 0 || repl > 3)
+    {
+        return "repl must be between 0 and 3";
+    }
+    spec->repl = (ReplacementPolicy)repl;
+
+    if (strcasecmp(inclusion, "nine") == 0)
+    {
+        spec->inclusion = INCLUSION_NINE;
+    }
+    else if (strcasecmp(inclusion, "inclusive") == 0)
+    {
+        spec->inclusion = INCLUSION_INCLUSIVE;
+    }
+    else if (strcasecmp(inclusion, "exclusive") == 0)
+    {
+        spec->inclusion = INCLUSION_EXCLUSIVE;
+    }
+    else
+    {
+        return "inclusion must be nine, inclusive, or exclusive";
+    }
+
+    if (level < 1 || level > HIER_MAX_LEVELS)
+    {
+        return "level out of range";
+    }
+    if (assoc < 1 || assoc > MAX_WAYS_PER_CACHE_SET)
+    {
+        return "assoc out of range";
+    }
+    if (size_kb * 1024 < assoc * CACHE_LINESIZE)
+    {
+        return "size_kb is smaller than one set";
+    }
+
+    return NULL;
+}
+
+/**
+ * Check that the parsed specs describe a well-formed hierarchy.
+ *
+ * @param specs The specs, one per configuration line.
+ * @param num_specs The number of specs.
+ * @param num_cores The number of cores.
+ * @param num_levels Set to the number of cache levels.
+ * @return An error message, or NULL on success.
+ */
+static const char *hier_check_specs(HierCacheSpec *specs,
+                                    unsigned int num_specs,
+                                    unsigned int num_cores,
+                                    unsigned int *num_levels)
+{
+    unsigned int levels = 0;
+    for (unsigned int i = 0; i < num_specs; i++)
+    {
+        if (specs[i].level > levels)
+        {
+            levels = specs[i].level;
+        }
+    }
+
+    for (unsigned int level = 1; level <= levels; level++)
+    {
+        unsigned int count[3] = {0, 0, 0};
+        bool shared = false;
+        for (unsigned int i = 0; i < num_specs; i++)
+        {
+            if (specs[i].level == level)
+            {
+                count[specs[i].type]++;
+                shared = specs[i].shared;
+            }
+        }
+
+        bool split = (count[HIER_TYPE_INST] == 1 && count[HIER_TYPE_DATA] == 1 &&
+                      count[HIER_TYPE_UNIFIED] == 0);
+        bool unified = (count[HIER_TYPE_INST] == 0 &&
+                        count[HIER_TYPE_DATA] == 0 &&
+                        count[HIER_TYPE_UNIFIED] == 1);
+        if (level == 1 && !split && !unified)
+        {
+            return "level 1 must be one unified cache or one inst and one "
+                   "data cache";
+        }
+        if (level > 1 && !unified)
+        {
+            return "every level after 1 must be exactly one unified cache";
+        }
+
+        for (unsigned int i = 0; i < num_specs; i++)
+        {
+            if (specs[i].level != level)
+            {
+                continue;
+            }
+            if (specs[i].shared != shared)
+            {
+                return "the inst and data caches must have the same sharing";
+            }
+            if (level == 1 && specs[i].inclusion == INCLUSION_EXCLUSIVE)
+            {
+                return "level 1 cannot be exclusive";
+            }
+            if ((specs[i].repl == SWP || specs[i].repl == DWP) &&
+                num_cores > 2)
+            {
+                return "SWP and DWP split a cache between two cores";
+            }
+            for (unsigned int j = 0; j < num_specs; j++)
+            {
+                if (specs[j].level > level && specs[i].shared &&
+                    !specs[j].shared)
+                {
+                    return "a private level cannot sit below a shared level";
+                }
+            }
+        }
+    }
+
+    if (levels == 0)
+    {
+        return "no caches specified";
+    }
+
+    *num_levels = levels;
+    return NULL;
+}
+
+/**
+ * Find the instance of the given level that serves the given core.
+ *
+ * @param h The hierarchy to search.
+ * @param level The level to find.
+ * @param is_data Whether the instance must serve data (1) or instruction
+ *                fetches (0).
+ * @param core_id The core that must be served.
+ * @param types The type of each instance in h->caches.
+ * @param owners The core owning each instance in h->caches, or MAX_CORES for
+ *               shared instances.
+ * @return The instance, or NULL if the hierarchy has no such level.
+ */
+static HierCache *hier_find(Hierarchy *h, unsigned int level, int is_data,
+                            unsigned int core_id, HierCacheType *types,
+                            unsigned int *owners)
+{
+    for (unsigned int i = 0; i < h->num_caches; i++)
+    {
+        HierCache *hc = &h->caches[i];
+        if (hc->level != level)
+        {
+            continue;
+        }
+        if (owners[i] != MAX_CORES && owners[i] != core_id)
+        {
+            continue;
+        }
+        if (types[i] != HIER_TYPE_UNIFIED && (int)types[i] != is_data)
+        {
+            continue;
+        }
+        return hc;
+    }
+    return NULL;
+}
+
+/**
+ * Build a cache hierarchy from the given configuration file.
+ *
+ * Print a message to stderr if the file cannot be read or is malformed.
+ *
+ * @param filename The path of the configuration file.
+ * @param num_cores The number of cores, i.e. instances of each private cache.
+ * @param dram The DRAM module to place behind the last level.
+ * @return A pointer to the hierarchy, or NULL on error.
+ */
+Hierarchy *hier_new(const char *filename, unsigned int num_cores, DRAM *dram)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        perror("Couldn't open hierarchy configuration");
+        return NULL;
+    }
+
+    HierCacheSpec specs[HIER_MAX_LEVELS * 2];
+    unsigned int num_specs = 0;
+    unsigned int line_number = 0;
+    char line[256];
+    const char *error = NULL;
+
+    while (error == NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        line_number++;
+
+        char *text = line;
+        while (*text == ' ' || *text == '\t')
+        {
+            text++;
+        }
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0')
+        {
+            continue;
+        }
+
+        if (num_specs >= HIER_MAX_LEVELS * 2)
+        {
+            error = "too many caches";
+            break;
+        }
+        error = hier_parse_spec(text, &specs[num_specs]);
+        num_specs++;
+    }
+    fclose(file);
+
+    if (error != NULL)
+    {
+        fprintf(stderr, "Error: %s:%u: %s\n", filename, line_number, error);
+        return NULL;
+    }
+
+    Hierarchy *h = (Hierarchy *)calloc(1, sizeof(Hierarchy));
+    error = hier_check_specs(specs, num_specs, num_cores, &h->num_levels);
+    if (error != NULL)
+    {
+        fprintf(stderr, "Error: %s: %s\n", filename, error);
+        free(h);
+        return NULL;
+    }
+
+    h->dram = dram;
+
+    // Instantiate the caches level by level. owners[] records the core each
+    // private instance belongs to (MAX_CORES for shared instances).
+    HierCacheType types[HIER_MAX_CACHES];
+    unsigned int owners[HIER_MAX_CACHES];
+
+    for (unsigned int level = 1; level <= h->num_levels; level++)
+    {
+        for (unsigned int i = 0; i < num_specs; i++)
+        {
+            HierCacheSpec *spec = &specs[i];
+            if (spec->level != level)
+            {
+                continue;
+            }
+
+            unsigned int instances = spec->shared ? 1 : num_cores;
+            for (unsigned int core_id = 0; core_id < instances; core_id++)
+            {
+                HierCache *hc = &h->caches[h->num_caches];
+                if (spec->shared)
+                {
+                    snprintf(hc->name, sizeof(hc->name), "%.15s", spec->name);
+                }
+                else
+                {
+                    snprintf(hc->name, sizeof(hc->name), "%.15s_%u", spec->name,
+                             core_id);
+                }
+                hc->cache = cache_new(spec->size_kb * 1024, spec->assoc,
+                                      CACHE_LINESIZE, spec->repl);
+                hc->level = level;
+                hc->latency = spec->latency;
+                hc->inclusion = spec->inclusion;
+
+                types[h->num_caches] = spec->type;
+                owners[h->num_caches] = spec->shared ? MAX_CORES : core_id;
+                hc->owner = owners[h->num_caches];
+                h->num_caches++;
+            }
+        }
+    }
+
+    // Link each instance to the next level on its miss path.
+    for (unsigned int i = 0; i < h->num_caches; i++)
+    {
+        HierCache *hc = &h->caches[i];
+        unsigned int core_id = (owners[i] == MAX_CORES) ? 0 : owners[i];
+        hc->next = hier_find(h, hc->level + 1, 1, core_id, types, owners);
+    }
+
+    // Every instance is an upper cache of everything on its miss path.
+    for (unsigned int i = 0; i < h->num_caches; i++)
+    {
+        HierCache *upper = &h->caches[i];
+        for (HierCache *lower = upper->next; lower != NULL;
+             lower = lower->next)
+        {
+            lower->uppers[lower->num_uppers++] = upper;
+        }
+    }
+
+    for (unsigned int core_id = 0; core_id < num_cores; core_id++)
+    {
+        h->entry[core_id][0] = hier_find(h, 1, 0, core_id, types, owners);
+        h->entry[core_id][1] = hier_find(h, 1, 1, core_id, types, owners);
+    }
+
+    #ifdef DEBUG
+        for (unsigned int i = 0; i < h->num_caches; i++)
+        {
+            printf("Hierarchy cache %s (level: %u, next: %s, uppers: %u)\n",
+                   h->caches[i].name, h->caches[i].level,
+                   h->caches[i].next ? h->caches[i].next->name : "DRAM",
+                   h->caches[i].num_uppers);
+        }
+    #endif
+
+    return h;
+}
+
+/**
+ * Access the given cache line through the hierarchy.
+ *
+ * Return the delay in cycles incurred by this access. Writebacks caused by
+ * the access are done off the critical path.
+ *
+ * @param h The hierarchy to access.
+ * @param line_addr The (physical) address of the cache line to access (in
+ *                  units of the cache line size).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by this access.
+ */
+uint64_t hier_access(Hierarchy *h, uint64_t line_addr, AccessType type,
+                     unsigned int core_id)
+{
+    HierCache *hc = h->entry[core_id][type != ACCESS_TYPE_IFETCH];
+    bool fill_dirty = false;
+
+    return hier_cache_access(h, hc, line_addr, type == ACCESS_TYPE_STORE,
+                             core_id, &fill_dirty);
+}
+
+/**
+ * Perform a demand access to one cache of the hierarchy, fetching the line
+ * from the levels below on a miss.
+ *
+ * @param h The hierarchy being accessed.
+ * @param hc The cache to access.
+ * @param line_addr The address of the cache line to access.
+ * @param is_write Whether this access writes the line (only for stores at the
+ *                 first level).
+ * @param core_id The CPU core ID that requested this access.
+ * @param fill_dirty Set to whether the line handed to the level above is
+ *                   dirty, which happens when it leaves an exclusive cache.
+ * @return The delay in cycles incurred by this access.
+ */
+static uint64_t hier_cache_access(Hierarchy *h, HierCache *hc,
+                                  uint64_t line_addr, bool is_write,
+                                  unsigned int core_id, bool *fill_dirty)
+{
+    uint64_t delay = hc->latency;
+    bool dirty = false;
+
+    #ifdef DEBUG
+        printf("\tAccessing %s (line_addr: %lu)\n", hc->name, line_addr);
+    #endif
+
+    CacheResult outcome = cache_access(hc->cache, line_addr, is_write,
+                                       core_id);
+    if (outcome == HIT)
+    {
+        if (hc->inclusion == INCLUSION_EXCLUSIVE)
+        {
+            // The line moves up to the requester, taking its dirty data.
+            cache_invalidate(hc->cache, line_addr, &dirty);
+        }
+        *fill_dirty = dirty;
+        return delay;
+    }
+
+    if (hc->next != NULL)
+    {
+        // Only the first level times the levels below it, since they nest.
+        uint64_t prof_start = 0;
+        if (hc->level == 1)
+        {
+            prof_start = selfprof_begin(SELFPROF_L2);
+        }
+        delay += hier_cache_access(h, hc->next, line_addr, false, core_id,
+                                   &dirty);
+        selfprof_end(SELFPROF_L2, prof_start);
+    }
+    else
+    {
+        delay += dram_access(h->dram, line_addr, false, core_id);
+    }
+
+    if (hc->inclusion != INCLUSION_EXCLUSIVE)
+    {
+        #ifdef DEBUG
+            printf("\tInstalling line in %s!\n", hc->name);
+        #endif
+        cache_install(hc->cache, line_addr, is_write || dirty, core_id);
+        hier_evict(h, hc, line_addr, core_id);
+
+        // This cache now owns the dirty data.
+        dirty = false;
+    }
+
+    *fill_dirty = dirty;
+    return delay;
+}
+
+/**
+ * Write a line evicted from the level above into the given cache.
+ *
+ * Dirty lines are writebacks and count as write accesses. Clean lines only
+ * reach exclusive caches, which are filled by victims.
+ *
+ * @param h The hierarchy being accessed.
+ * @param hc The cache receiving the line.
+ * @param line_addr The address of the evicted line.
+ * @param dirty Whether the evicted line is dirty.
+ * @param core_id The CPU core ID whose access caused the eviction.
+ */
+static void hier_writeback(Hierarchy *h, HierCache *hc, uint64_t line_addr,
+                           bool dirty, unsigned int core_id)
+{
+    if (dirty)
+    {
+        if (cache_access(hc->cache, line_addr, true, core_id) == HIT)
+        {
+            return;
+        }
+    }
+    else
+    {
+        // Another core may have already left this line here.
+        bool was_dirty = false;
+        cache_invalidate(hc->cache, line_addr, &was_dirty);
+        dirty = was_dirty;
+    }
+
+    #ifdef DEBUG
+        printf("\tWriting back line to %s (dirty: %d)\n", hc->name, dirty);
+    #endif
+
+    // Victims are full lines, so there is nothing to fetch from below.
+    cache_install(hc->cache, line_addr, dirty, core_id);
+    hier_evict(h, hc, line_addr, core_id);
+}
+
+/**
+ * Handle the line evicted by the most recent install into the given cache:
+ * back-invalidate the levels above if the cache is inclusive, then pass the
+ * line down if it is dirty or the next level is exclusive.
+ *
+ * @param h The hierarchy being accessed.
+ * @param hc The cache that performed the install.
+ * @param line_addr The address of the line that was installed.
+ * @param core_id The CPU core ID whose access caused the eviction.
+ */
+static void hier_evict(Hierarchy *h, HierCache *hc, uint64_t line_addr,
+                       unsigned int core_id)
+{
+    if (!hc->cache->last_evicted_line.valid)
+    {
+        return;
+    }
+
+    uint64_t victim_addr = cache_evicted_line_addr(hc->cache, line_addr);
+    bool dirty = hc->cache->last_evicted_line.dirty;
+
+    if (hc->inclusion == INCLUSION_INCLUSIVE)
+    {
+        for (unsigned int i = 0; i < hc->num_uppers; i++)
+        {
+            bool upper_dirty = false;
+            cache_invalidate(hc->uppers[i]->cache, victim_addr, &upper_dirty);
+            dirty = dirty || upper_dirty;
+        }
+    }
+
+    if (hc->next == NULL)
+    {
+        if (dirty)
+        {
+            dram_access(h->dram, victim_addr, true, core_id);
+        }
+    }
+    else if (dirty || hc->next->inclusion == INCLUSION_EXCLUSIVE)
+    {
+        hier_writeback(h, hc->next, victim_addr, dirty, core_id);
+    }
+}
+
+/**
+ * Print the statistics of every cache in the hierarchy and of the DRAM.
+ *
+ * @param h The hierarchy to print the statistics of.
+ */
+void hier_print_stats(Hierarchy *h)
+{
+    for (unsigned int i = 0; i < h->num_caches; i++)
+    {
+        cache_print_stats(h->caches[i].cache, h->caches[i].name);
+    }
+    dram_print_stats(h->dram);
+}
+
+/**
+ * Add the statistics of every cache in the hierarchy and of the DRAM to a
+ * registry.
+ *
+ * @param h The hierarchy to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void hier_collect_stats(Hierarchy *h, StatsRegistry *reg)
+{
+    for (unsigned int i = 0; i < h->num_caches; i++)
+    {
+        cache_collect_stats(h->caches[i].cache, h->caches[i].name, reg);
+    }
+    dram_collect_stats(h->dram, reg);
+}
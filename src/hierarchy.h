@@ -0,0 +1,159 @@
+// hierarchy.h
+// Declares a cache hierarchy that is built from a configuration file instead
+// of being fixed by the simulation mode.
+//
+// The configuration file lists one cache per line. Blank lines and lines
+// starting with '#' are ignored. Each cache line has nine fields:
+//
+//   name  level  type  sharing  size_kb  assoc  latency  repl  inclusion
+//
+//   name       A label used as the statistics prefix, e.g. L2. Private caches
+//              get the core ID appended, e.g. L2_0.
+//   level      The level of the cache, starting at 1 for the caches the core
+//              accesses directly. Levels must be numbered without gaps.
+//   type       inst, data, or unified. Only level 1 may be split into an inst
+//              and a data cache; every other level must be unified.
+//   sharing    private (one instance per core) or shared (one instance for
+//              all cores). A private level cannot sit below a shared one.
+//   size_kb    The capacity in KB.
+//   assoc      The associativity.
+//   latency    The hit latency in cycles.
+//   repl       The replacement policy [0: LRU, 1: random, 2: SWP, 3: DWP].
+//              SWP and DWP need at most two cores.
+//   inclusion  nine (non-inclusive non-exclusive), inclusive (evictions
+//              back-invalidate every cache above), or exclusive (holds only
+//              lines evicted from the levels above).
+//
+// The last level is backed by the DRAM module. See configs/ for examples.
+
+#ifndef __HIERARCHY_H__
+#define __HIERARCHY_H__
+
+#include "types.h"
+#include "cache.h"
+#include "dram.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The maximum number of cache levels in a hierarchy. */
+#define HIER_MAX_LEVELS 8
+
+/** The maximum number of cache instances in a hierarchy. */
+#define HIER_MAX_CACHES (HIER_MAX_LEVELS * MAX_CORES * 2)
+
+/** The maximum length of a cache name, including the core ID suffix. */
+#define HIER_NAME_LEN 32
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Possible inclusion policies of a cache level. */
+typedef enum InclusionPolicyEnum
+{
+    INCLUSION_NINE = 0,      // Neither inclusive nor exclusive.
+    INCLUSION_INCLUSIVE = 1, // Evictions back-invalidate the levels above.
+    INCLUSION_EXCLUSIVE = 2, // Filled only by victims of the levels above.
+} InclusionPolicy;
+
+/** A single cache instance within the hierarchy. */
+typedef struct HierCache
+{
+    /** The statistics label of this instance, e.g. L2_0. */
+    char name[HIER_NAME_LEN];
+
+    Cache *cache;
+
+    /** The level of this cache, starting at 1. */
+    unsigned int level;
+
+    /** The core this cache is private to, or MAX_CORES if it is shared. */
+    unsigned int owner;
+
+    /** The hit latency of this cache in cycles. */
+    uint64_t latency;
+
+    InclusionPolicy inclusion;
+
+    /** The next cache on the miss path, or NULL if misses go to DRAM. */
+    struct HierCache *next;
+
+    /**
+     * Every cache above this one that can hold its lines. These are
+     * back-invalidated when an inclusive cache evicts a line.
+     */
+    struct HierCache *uppers[HIER_MAX_CACHES];
+    unsigned int num_uppers;
+} HierCache;
+
+/** A cache hierarchy built from a configuration file. */
+typedef struct Hierarchy
+{
+    /** Every cache instance, ordered by level and then by core ID. */
+    HierCache caches[HIER_MAX_CACHES];
+    unsigned int num_caches;
+
+    /** The number of cache levels. */
+    unsigned int num_levels;
+
+    /**
+     * The first cache accessed by each core, indexed by core ID and then by
+     * whether the access is for data (0 for instruction fetches).
+     */
+    HierCache *entry[MAX_CORES][2];
+
+    /** The DRAM module behind the last level. */
+    DRAM *dram;
+} Hierarchy;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Build a cache hierarchy from the given configuration file.
+ *
+ * Print a message to stderr if the file cannot be read or is malformed.
+ *
+ * @param filename The path of the configuration file.
+ * @param num_cores The number of cores, i.e. instances of each private cache.
+ * @param dram The DRAM module to place behind the last level.
+ * @return A pointer to the hierarchy, or NULL on error.
+ */
+Hierarchy *hier_new(const char *filename, unsigned int num_cores, DRAM *dram);
+
+/**
+ * Access the given cache line through the hierarchy.
+ *
+ * Return the delay in cycles incurred by this access. Writebacks caused by
+ * the access are done off the critical path.
+ *
+ * @param h The hierarchy to access.
+ * @param line_addr The (physical) address of the cache line to access (in
+ *                  units of the cache line size).
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @return The delay in cycles incurred by this access.
+ */
+uint64_t hier_access(Hierarchy *h, uint64_t line_addr, AccessType type,
+                     unsigned int core_id);
+
+/**
+ * Print the statistics of every cache in the hierarchy and of the DRAM.
+ *
+ * @param h The hierarchy to print the statistics of.
+ */
+void hier_print_stats(Hierarchy *h);
+
+/**
+ * Add the statistics of every cache in the hierarchy and of the DRAM to a
+ * registry.
+ *
+ * @param h The hierarchy to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void hier_collect_stats(Hierarchy *h, StatsRegistry *reg);
+
+#endif // __HIERARCHY_H__
@@ -0,0 +1,125 @@
+// histogram.cpp
+// Defines the functions used to report latency histograms.
+
+#include "histogram.h"
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of percentiles reported for each histogram. */
+#define HIST_NUM_PERCENTILES 4
+
+/** The percentiles reported, and the suffixes of their names. */
+static const double hist_percentiles[HIST_NUM_PERCENTILES] = {50.0, 90.0,
+                                                              99.0, 99.9};
+static const char *hist_suffixes[HIST_NUM_PERCENTILES] = {"P50", "P90",
+                                                          "P99", "P999"};
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Find the largest value a bucket holds.
+ *
+ * @param index The index of the bucket.
+ * @return The largest value of the bucket.
+ */
+static uint64_t histogram_bucket_max(unsigned int index)
+{
+    if (index < 2 * HIST_SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    unsigned int shift = index / HIST_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(HIST_SUB_BUCKETS + index % HIST_SUB_BUCKETS)
+                   << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * Find a percentile of the values counted in a histogram.
+ *
+ * @param h The histogram.
+ * @param percentile The percentile, between 0 and 100.
+ * @return The largest value of the bucket holding the percentile, or at most
+ *         the largest value counted.
+ */
+uint64_t histogram_percentile(Histogram *h, double percentile)
+{
+    if (h->count == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the value at the percentile, counting from 1.
+    double exact_rank = percentile / 100.0 * (double)(h->count);
+    unsigned long long rank = (unsigned long long)exact_rank;
+    if ((double)rank < exact_rank)
+    {
+        rank++;
+    }
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    unsigned long long seen = 0;
+    for (unsigned int i = 0; i < HIST_NUM_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t value = histogram_bucket_max(i);
+            return (value < h->max) ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Print the 50th, 90th, 99th and 99.9th percentiles and the maximum of a
+ * histogram.
+ *
+ * @param h The histogram to print the statistics of.
+ * @param header A label for the histogram, which is used as a prefix for
+ *               each statistic.
+ */
+void histogram_print_stats(Histogram *h, const char *header)
+{
+    char label[48];
+
+    printf("\n");
+    for (unsigned int i = 0; i < HIST_NUM_PERCENTILES; i++)
+    {
+        snprintf(label, sizeof(label), "%s_%s", header, hist_suffixes[i]);
+        printf("%-20s\t\t : %10llu\n", label,
+               (unsigned long long)histogram_percentile(h,
+                                                        hist_percentiles[i]));
+    }
+    snprintf(label, sizeof(label), "%s_MAX", header);
+    printf("%-20s\t\t : %10llu\n", label, (unsigned long long)h->max);
+}
+
+/**
+ * Add the percentiles and maximum of a histogram to a registry, under the
+ * names histogram_print_stats() prints them with.
+ *
+ * @param h The histogram to collect the statistics of.
+ * @param header A label for the histogram, which is used as a prefix for
+ *               each statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void histogram_collect_stats(Histogram *h, const char *header,
+                             StatsRegistry *reg)
+{
+    for (unsigned int i = 0; i < HIST_NUM_PERCENTILES; i++)
+    {
+        stats_add_count(reg, header, hist_suffixes[i],
+                        histogram_percentile(h, hist_percentiles[i]));
+    }
+    stats_add_count(reg, header, "MAX", h->max);
+}
@@ -0,0 +1,106 @@
+// histogram.h
+// Declares the latency histograms, which report the tail of a delay
+// distribution rather than only its average.
+//
+// The buckets are log-linear, as in HDR histograms: the values below
+// HIST_SUB_BUCKETS * 2 have a bucket each, and every power of two above that
+// is split into HIST_SUB_BUCKETS equal buckets. A bucket is thus never wider
+// than 1/HIST_SUB_BUCKETS of its values, and finding one takes a count of
+// leading zeros and a few shifts.
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include "types.h"
+#include "stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The log2 of the number of buckets each power of two is split into. */
+#define HIST_SUB_BITS 3
+
+/** The number of buckets each power of two is split into. */
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+
+/** The number of buckets, enough for any 64-bit value. */
+#define HIST_NUM_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A histogram of delays in cycles. */
+typedef struct Histogram
+{
+    unsigned long long buckets[HIST_NUM_BUCKETS];
+    unsigned long long count;
+    uint64_t max;
+} Histogram;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Count one value in a histogram.
+ *
+ * This is on the path of every memory access, so it is defined here to be
+ * inlined.
+ *
+ * @param h The histogram.
+ * @param value The value to count.
+ */
+static inline void histogram_record(Histogram *h, uint64_t value)
+{
+    unsigned int index = (unsigned int)value;
+    if (value >= 2 * HIST_SUB_BUCKETS)
+    {
+        // The shift keeps the top HIST_SUB_BITS + 1 bits of the value.
+        unsigned int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+        index = (shift + 1) * HIST_SUB_BUCKETS +
+                ((value >> shift) & (HIST_SUB_BUCKETS - 1));
+    }
+
+    h->buckets[index]++;
+    h->count++;
+    if (value > h->max)
+    {
+        h->max = value;
+    }
+}
+
+/**
+ * Find a percentile of the values counted in a histogram.
+ *
+ * @param h The histogram.
+ * @param percentile The percentile, between 0 and 100.
+ * @return The largest value of the bucket holding the percentile, or at most
+ *         the largest value counted.
+ */
+uint64_t histogram_percentile(Histogram *h, double percentile);
+
+/**
+ * Print the 50th, 90th, 99th and 99.9th percentiles and the maximum of a
+ * histogram.
+ *
+ * @param h The histogram to print the statistics of.
+ * @param header A label for the histogram, which is used as a prefix for
+ *               each statistic.
+ */
+void histogram_print_stats(Histogram *h, const char *header);
+
+/**
+ * Add the percentiles and maximum of a histogram to a registry, under the
+ * names histogram_print_stats() prints them with.
+ *
+ * @param h The histogram to collect the statistics of.
+ * @param header A label for the histogram, which is used as a prefix for
+ *               each statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void histogram_collect_stats(Histogram *h, const char *header,
+                             StatsRegistry *reg);
+
+#endif // __HISTOGRAM_H__
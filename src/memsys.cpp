@@ -1,18 +1,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 // You will need to modify this file to implement parts B through F.         //
 //                                                                           //
-// In part B, it is intended that you implement the following functions:     //
-// - memsys_access_modeBC() (used in parts B and C)                          //
+// In parts B through F, the accesses go through the following functions:    //
+// - memsys_access_l1() (the L1 caches of parts B through F)                 //
 // - memsys_l2_access() (used in parts B through F)                          //
 //                                                                           //
-// In part D, it is intended that you implement the following function:      //
-// - memsys_access_modeDEF() (used in parts D, E, and F)                     //
+// memsys_new() picks the instantiation of memsys_access_l1() for the mode.  //
 ///////////////////////////////////////////////////////////////////////////////
 
 // memsys.cpp
 // Defines the functions for the memory system.
 
 #include "memsys.h"
+#include "selfprof.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,9 +23,6 @@
 //                                 CONSTANTS                                 //
 ///////////////////////////////////////////////////////////////////////////////
 
-/** The number of bytes in a page. */
-#define PAGE_SIZE 4096
-
 /** The hit time of the data cache in cycles. */
 #define DCACHE_HIT_LATENCY 1
 
@@ -35,6 +32,24 @@
 /** The hit time of the L2 cache in cycles. */
 #define L2CACHE_HIT_LATENCY 10
 
+/** The hit time of the L2 TLB in cycles, after an L1 TLB miss. */
+#define STLB_HIT_LATENCY 7
+
+/** The number of levels of the page table, for 4 KB pages. */
+#define PT_LEVELS 4
+
+/** The number of virtual page number bits indexing each page table level. */
+#define PT_INDEX_BITS 9
+
+/** The size in bytes of a page table entry. */
+#define PT_ENTRY_SIZE 8
+
+/**
+ * The first physical frame of the page tables, above all frames handed out
+ * by memsys_convert_vpn_to_pfn().
+ */
+#define PT_BASE_FRAME (1ULL << 32)
+
 ///////////////////////////////////////////////////////////////////////////////
 //                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
 ///////////////////////////////////////////////////////////////////////////////
@@ -75,14 +90,48 @@ extern ReplacementPolicy L2CACHE_REPL;
 /** The number of cores being simulated. */
 extern unsigned int NUM_CORES;
 
-#define DELAY_SIM_MODE_B 100;
+/**
+ * The cache hierarchy configuration file, or NULL to use the fixed hierarchy
+ * of the current mode.
+ */
+extern const char *HIER_CONFIG;
+
+/** What the L2 cache does with fills that are predicted dead. */
+extern DeadBlockPolicy L2_DBP_POLICY;
+
+/** Whether translations go through TLBs and page walks. */
+extern bool TLB_ENABLED;
+
+/** The entries of each L1 ITLB and DTLB, and their associativity. */
+extern uint64_t ITLB_ENTRIES;
+extern uint64_t DTLB_ENTRIES;
+extern uint64_t L1TLB_ASSOC;
+
+/** The entries of the shared L2 TLB, and its associativity. */
+extern uint64_t STLB_ENTRIES;
+extern uint64_t STLB_ASSOC;
+
+/** The entries of each core's fully associative page-walk cache, or 0. */
+extern uint64_t PWC_ENTRIES;
+
+/** Whether pages are 2 MB instead of 4 KB. */
+extern bool TLB_LARGE_PAGES;
+
+/** How physical frames are chosen for virtual pages in mode 4. */
+extern PageAllocPolicy PAGE_ALLOC_POLICY;
+
+/** Whether the delays of accesses are recorded in histograms. */
+extern bool LATENCY_HIST;
+
+/** The size of physical memory in MB, for the page allocators. */
+extern uint64_t PHYS_MEM_MB;
 
 /**
  * The current clock cycle number.
  * 
  * This can be used as a timestamp for implementing the LRU replacement policy.
  */
-extern uint64_t current_cycle;
+extern thread_local uint64_t current_cycle;
 
 ///////////////////////////////////////////////////////////////////////////////
 //                           FUNCTION DEFINITIONS                            //
@@ -107,17 +156,412 @@ uint64_t find_line_address_from_tag_index_mem(uint64_t tag, uint64_t index, uint
     return line_address;
 }
 
+/**
+ * Allocate the page-frame allocator of the memory system, unless the fixed
+ * mapping is used.
+ *
+ * Page colors are taken from the shared L2 cache, or from the last level of
+ * the configured hierarchy.
+ *
+ * @param sys The memory system to add it to.
+ * @return Whether the allocation policy can be used.
+ */
+static bool memsys_new_page_alloc(MemorySystem *sys)
+{
+    if (PAGE_ALLOC_POLICY == PAGE_ALLOC_FIXED)
+    {
+        return true;
+    }
+
+    Cache *llc = sys->l2cache;
+    if (sys->hier != NULL)
+    {
+        llc = sys->hier->caches[sys->hier->num_caches - 1].cache;
+    }
+    uint64_t num_colors = llc->number_of_sets * CACHE_LINESIZE / PAGE_SIZE;
+    if (num_colors == 0)
+    {
+        num_colors = 1;
+    }
+
+    sys->page_alloc = page_alloc_new(PAGE_ALLOC_POLICY,
+                                     PHYS_MEM_MB * 1024 * 1024 / PAGE_SIZE,
+                                     num_colors, sys->dram,
+                                     PAGE_SIZE / CACHE_LINESIZE);
+    return sys->page_alloc != NULL;
+}
+
+/**
+ * Allocate the TLBs and page-walk caches of the memory system, if TLBs are
+ * enabled.
+ *
+ * @param sys The memory system to add them to.
+ */
+static void memsys_new_tlbs(MemorySystem *sys)
+{
+    if (!TLB_ENABLED)
+    {
+        return;
+    }
+
+    sys->stlb = tlb_new(STLB_ENTRIES, STLB_ASSOC);
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        sys->itlb[i] = tlb_new(ITLB_ENTRIES, L1TLB_ASSOC);
+        sys->dtlb[i] = tlb_new(DTLB_ENTRIES, L1TLB_ASSOC);
+        if (PWC_ENTRIES)
+        {
+            sys->pwc[i] = tlb_new(PWC_ENTRIES, PWC_ENTRIES);
+        }
+    }
+}
+
+/**
+ * Translate a virtual line address to a physical one, as in parts D, E, and
+ * F, adding the delay of the TLBs and page walks if TLB is set.
+ *
+ * @param sys The memory system being used.
+ * @param v_line_addr The virtual address of the cache line.
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
+ * @param delay Incremented by the delay of the translation.
+ * @return The physical address of the cache line.
+ */
+template <bool TLB>
+static uint64_t memsys_translate_line(MemorySystem *sys, uint64_t v_line_addr,
+                                      AccessType type, unsigned int core_id,
+                                      uint64_t pc, uint64_t *delay)
+{
+    uint64_t lines_per_page = PAGE_SIZE / CACHE_LINESIZE;
+    uint64_t vpn = v_line_addr / lines_per_page;
+    uint64_t pfn = memsys_convert_vpn_to_pfn(sys, vpn, core_id);
+    if (TLB)
+    {
+        *delay += memsys_translate(sys, vpn, type, core_id, pc);
+    }
+    return (pfn * lines_per_page) + (v_line_addr % lines_per_page);
+}
+
+/**
+ * Access the shared L2 cache and DRAM after an L1 miss or dirty eviction, or
+ * queue the access for the main thread if DEFER is set.
+ *
+ * @param sys The memory system being used.
+ * @param line_addr The address of the cache line to access.
+ * @param is_writeback Whether this access is a writeback from the L1.
+ * @param type The type of the access that missed the L1.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
+ * @return The delay in cycles, assumed to be an L2 hit if DEFER is set.
+ */
+template <bool DEFER>
+static uint64_t memsys_shared_access(MemorySystem *sys, uint64_t line_addr,
+                                     bool is_writeback, AccessType type,
+                                     unsigned int core_id, uint64_t pc)
+{
+    if (!DEFER)
+    {
+        return memsys_l2_access(sys, line_addr, is_writeback, core_id, pc);
+    }
+
+    SharedQueue *q = sys->shared_queue[core_id];
+    assert(q->tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) < q->size);
+
+    SharedRequest *req = &q->entries[q->tail & (q->size - 1)];
+    req->cycle = current_cycle;
+    req->line_addr = line_addr;
+    req->pc = pc;
+    req->type = type;
+    req->is_writeback = is_writeback;
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+
+    return L2CACHE_HIT_LATENCY;
+}
+
+/**
+ * Access the fixed hierarchy of modes B through F: the L1 cache of the core
+ * for the access type, then the shared L2 cache and DRAM.
+ *
+ * The configuration is fixed by the template arguments, so that memsys_new()
+ * can pick the instantiation for the mode once.
+ *
+ * @param sys The memory system to use for the access.
+ * @param line_addr The address of the cache line to access, virtual if
+ *                  TRANSLATE is set.
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
+ * @return The delay in cycles incurred by this memory access.
+ */
+template <bool TRANSLATE, bool TLB, bool DEFER>
+static uint64_t memsys_access_l1(MemorySystem *sys, uint64_t line_addr,
+                                 AccessType type, unsigned int core_id,
+                                 uint64_t pc)
+{
+    uint64_t delay = 0;
+
+    #ifdef DEBUG
+        printf("\nAccessing memory (line_addr: %ld, AccessType: %d, core_id: %d)\n", line_addr, type, core_id);
+    #endif
+
+    if (TRANSLATE)
+    {
+        line_addr = memsys_translate_line<TLB>(sys, line_addr, type, core_id,
+                                               pc, &delay);
+    }
+
+    bool is_data = (type != ACCESS_TYPE_IFETCH);
+    bool is_write = (type == ACCESS_TYPE_STORE);
+    Cache *l1 = sys->l1[core_id][is_data];
+
+    CacheResult l1_output = cache_access(l1, line_addr, is_write, core_id);
+    delay += is_data ? DCACHE_HIT_LATENCY : ICACHE_HIT_LATENCY;
+
+    if (l1_output == MISS)
+    {
+        delay += memsys_shared_access<DEFER>(sys, line_addr, false, type,
+                                             core_id, pc);
+
+        #ifdef DEBUG
+            printf("\tInstalling line in L1 cache!\n");
+        #endif
+        cache_install(l1, line_addr, is_write, core_id);
+
+        // Instruction caches are never dirty, so only data misses write back.
+        if (is_data && l1->last_evicted_line.valid &&
+            l1->last_evicted_line.dirty)
+        {
+            uint64_t index_bits = __builtin_log2(l1->number_of_sets);
+            uint64_t ind = extract_index_mem(line_addr, index_bits);
+            uint64_t evicted_line_address = find_line_address_from_tag_index_mem(l1->last_evicted_line.tag, ind, index_bits);
+
+            #ifdef DEBUG
+                printf("\tEvicted L1 entry was dirty! Performing writeback (addr: %ld)\n", evicted_line_address);
+            #endif
+
+            memsys_shared_access<DEFER>(sys, evicted_line_address, true, type,
+                                        core_id, pc);
+        }
+    }
+
+    return delay;
+}
+
+/**
+ * Access the hierarchy built from a configuration file, translating the
+ * address first if TRANSLATE is set.
+ *
+ * @param sys The memory system to use for the access.
+ * @param line_addr The address of the cache line to access.
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
+ * @return The delay in cycles incurred by this memory access.
+ */
+template <bool TRANSLATE, bool TLB>
+static uint64_t memsys_access_composed(MemorySystem *sys, uint64_t line_addr,
+                                       AccessType type, unsigned int core_id,
+                                       uint64_t pc)
+{
+    uint64_t delay = 0;
+    if (TRANSLATE)
+    {
+        line_addr = memsys_translate_line<TLB>(sys, line_addr, type, core_id,
+                                               pc, &delay);
+    }
+    return delay + hier_access(sys->hier, line_addr, type, core_id);
+}
+
+/**
+ * End the instruction fetch run of a core, charging its hits to the L1
+ * instruction cache and L1 TLB of the core.
+ *
+ * @tparam TRANSLATE Whether the run's line is virtual and must be translated,
+ *                   as in modes D through F.
+ * @tparam TLB Whether the hits are also charged to the core's L1 TLB.
+ * @param sys The memory system.
+ * @param core_id The CPU core ID whose run ends.
+ */
+template <bool TRANSLATE, bool TLB>
+static void memsys_end_ifetch_run(MemorySystem *sys, unsigned int core_id)
+{
+    IfetchRun *run = &sys->ifetch_run[core_id];
+    if (run->valid && run->hits)
+    {
+        uint64_t line_addr = run->line_addr;
+        if (TRANSLATE)
+        {
+            uint64_t lines_per_page = PAGE_SIZE / CACHE_LINESIZE;
+            uint64_t vpn = line_addr / lines_per_page;
+            uint64_t pfn = memsys_convert_vpn_to_pfn(sys, vpn, core_id);
+            line_addr = (pfn * lines_per_page) + (line_addr % lines_per_page);
+            if (TLB)
+            {
+                uint64_t page = TLB_LARGE_PAGES ? (vpn >> PT_INDEX_BITS) : vpn;
+                tlb_charge_hits(sys->itlb[core_id], page, sys->asid[core_id],
+                                run->hits);
+            }
+        }
+        cache_charge_hits(sys->l1[core_id][0], line_addr, run->hits,
+                          run->last_cycle);
+    }
+    run->valid = false;
+    run->hits = 0;
+}
+
+/**
+ * Choose the access path of the memory system for the mode, the hierarchy
+ * and whether TLBs are enabled, so that memsys_access() does not re-check
+ * the configuration on every access. The end of an instruction fetch run is
+ * chosen alike.
+ *
+ * @param sys The memory system, with its caches allocated.
+ */
+static void memsys_select_access(MemorySystem *sys)
+{
+    sys->end_ifetch_run = memsys_end_ifetch_run<false, false>;
+    if (sys->hier != NULL)
+    {
+        if (!sys->hier_translate)
+        {
+            sys->access = memsys_access_composed<false, false>;
+        }
+        else if (TLB_ENABLED)
+        {
+            sys->access = memsys_access_composed<true, true>;
+        }
+        else
+        {
+            sys->access = memsys_access_composed<true, false>;
+        }
+        return;
+    }
+
+    if (SIM_MODE == SIM_MODE_A)
+    {
+        sys->access = memsys_access_modeA;
+        return;
+    }
+
+    // In modes B and C the cores share the L1 caches.
+    for (unsigned int i = 0; i < MAX_CORES; i++)
+    {
+        if (SIM_MODE == SIM_MODE_DEF)
+        {
+            sys->l1[i][0] = sys->icache_coreid[i];
+            sys->l1[i][1] = sys->dcache_coreid[i];
+        }
+        else
+        {
+            sys->l1[i][0] = sys->icache;
+            sys->l1[i][1] = sys->dcache;
+        }
+    }
+
+    if (SIM_MODE != SIM_MODE_DEF)
+    {
+        sys->access = memsys_access_l1<false, false, false>;
+    }
+    else if (TLB_ENABLED)
+    {
+        sys->access = memsys_access_l1<true, true, false>;
+        sys->end_ifetch_run = memsys_end_ifetch_run<true, true>;
+    }
+    else
+    {
+        sys->access = memsys_access_l1<true, false, false>;
+        sys->end_ifetch_run = memsys_end_ifetch_run<true, false>;
+    }
+}
+
+/**
+ * Read the counts the per-PC profiler attributes to an access: the misses of
+ * the L1 cache it goes to and of the cache below, and the reads of DRAM.
+ *
+ * @param sys The memory system.
+ * @param core_id The CPU core ID making the access.
+ * @param is_data Whether the access is a load or store.
+ * @param counts The L1 misses, L2 read misses and DRAM reads, filled in.
+ * @return The hit latency of the L1 cache, or 0 if it has no timing.
+ */
+static uint64_t memsys_profile_counts(MemorySystem *sys, unsigned int core_id,
+                                      bool is_data, uint64_t *counts)
+{
+    Cache *l1 = NULL;
+    Cache *l2 = NULL;
+    uint64_t hit_latency = 0;
+    if (sys->hier != NULL)
+    {
+        HierCache *hc = sys->hier->entry[core_id][is_data];
+        l1 = hc->cache;
+        l2 = (hc->next != NULL) ? hc->next->cache : NULL;
+        hit_latency = hc->latency;
+    }
+    else if (SIM_MODE == SIM_MODE_A)
+    {
+        l1 = is_data ? sys->dcache : NULL;
+    }
+    else
+    {
+        l1 = sys->l1[core_id][is_data];
+        l2 = sys->l2cache;
+        hit_latency = is_data ? DCACHE_HIT_LATENCY : ICACHE_HIT_LATENCY;
+    }
+
+    counts[0] = (l1 != NULL) ? l1->stat_read_miss + l1->stat_write_miss : 0;
+    counts[1] = (l2 != NULL) ? l2->stat_read_miss : 0;
+    counts[2] = (sys->dram != NULL) ? sys->dram->stat_read_access : 0;
+    return hit_latency;
+}
 
 /**
  * Allocate and initialize the memory system.
  * 
  * This is implemented for you, but you may modify it as needed.
  * 
- * @return A pointer to the memory system.
+ * @return A pointer to the memory system, or NULL if the cache hierarchy
+ *         configuration could not be loaded.
  */
 MemorySystem *memsys_new()
 {
     MemorySystem *sys = (MemorySystem *)calloc(1, sizeof(MemorySystem));
+    for (unsigned int i = 0; i < MAX_CORES; i++)
+    {
+        sys->asid[i] = i;
+    }
+    if (LATENCY_HIST)
+    {
+        sys->delay_hist = (Histogram *)calloc(MAX_CORES * 3,
+                                              sizeof(Histogram));
+    }
+
+    if (HIER_CONFIG != NULL)
+    {
+        // The configuration file replaces the caches of every mode. The mode
+        // still selects the DRAM model and address translation.
+        sys->dram = dram_new();
+        sys->hier = hier_new(HIER_CONFIG, NUM_CORES, sys->dram);
+        sys->hier_translate = (SIM_MODE == SIM_MODE_DEF);
+        if (sys->hier == NULL)
+        {
+            free(sys->delay_hist);
+            free(sys->dram);
+            free(sys);
+            return NULL;
+        }
+        if (sys->hier_translate && !memsys_new_page_alloc(sys))
+        {
+            free(sys->hier);
+            free(sys->delay_hist);
+            free(sys->dram);
+            free(sys);
+            return NULL;
+        }
+        memsys_new_tlbs(sys);
+        memsys_select_access(sys);
+        return sys;
+    }
 
     if (SIM_MODE == SIM_MODE_A)
     {
@@ -147,9 +591,29 @@ MemorySystem *memsys_new()
                                               CACHE_LINESIZE, REPL_POLICY);
             sys->icache_coreid[i] = cache_new(ICACHE_SIZE, ICACHE_ASSOC,
                                               CACHE_LINESIZE, REPL_POLICY);
+            snprintf(sys->l1_name[i][0], HIER_NAME_LEN, "ICACHE_%u", i);
+            snprintf(sys->l1_name[i][1], HIER_NAME_LEN, "DCACHE_%u", i);
+        }
+        if (!memsys_new_page_alloc(sys))
+        {
+            free(sys->delay_hist);
+            free(sys->dram);
+            free(sys);
+            return NULL;
         }
     }
 
+    memsys_new_tlbs(sys);
+    memsys_select_access(sys);
+    sys->ifetch_runs = (SIM_MODE == SIM_MODE_DEF ||
+                        (SIM_MODE != SIM_MODE_A && NUM_CORES == 1));
+
+    if (sys->l2cache != NULL && L2_DBP_POLICY != DBP_OFF)
+    {
+        sys->l2_dbp = dbp_new(sys->l2cache->number_of_sets,
+                              sys->l2cache->number_of_ways);
+    }
+
     return sys;
 }
 
@@ -165,51 +629,101 @@ MemorySystem *memsys_new()
  * @param addr The address to access (in bytes).
  * @param type The type of memory access.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return The delay in cycles incurred by this memory access.
  */
 uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
-                       unsigned int core_id)
+                       unsigned int core_id, uint64_t pc)
 {
     uint64_t delay = 0;
+    uint64_t prof_start = selfprof_begin(SELFPROF_L1);
 
     // All cache transactions happen at line granularity, so we convert the
     // byte address to a cache line address.
     uint64_t line_addr = addr / CACHE_LINESIZE;
 
-    if (SIM_MODE == SIM_MODE_A)
+    // A fetch from the same line as the core's previous fetch hits the L1
+    // instruction cache; only its latency is needed now.
+    IfetchRun *run = &sys->ifetch_run[core_id];
+    bool is_ifetch = (type == ACCESS_TYPE_IFETCH) && sys->ifetch_runs;
+    if (is_ifetch && run->valid && run->line_addr == line_addr)
     {
-        delay = memsys_access_modeA(sys, line_addr, type, core_id);
+        run->hits++;
+        run->last_cycle = current_cycle;
+        sys->stat_ifetch_access[core_id]++;
+        sys->stat_ifetch_delay[core_id] += ICACHE_HIT_LATENCY;
+        if (sys->delay_hist != NULL)
+        {
+            histogram_record(&sys->delay_hist[core_id * 3 + type],
+                             ICACHE_HIT_LATENCY);
+        }
+        if (sys->pc_prof != NULL)
+        {
+            pcprof_record(sys->pc_prof, pc, sys->asid[core_id], type, 0, 0, 0,
+                          ICACHE_HIT_LATENCY, 0);
+        }
+        selfprof_end(SELFPROF_L1, prof_start);
+        return ICACHE_HIT_LATENCY;
     }
 
-    if (SIM_MODE == SIM_MODE_B || SIM_MODE == SIM_MODE_C)
+    if (is_ifetch)
     {
-        delay = memsys_access_modeBC(sys, line_addr, type, core_id);
+        sys->end_ifetch_run(sys, core_id);
     }
 
-    if (SIM_MODE == SIM_MODE_DEF)
+    uint64_t before[3];
+    uint64_t hit_latency = 0;
+    if (sys->pc_prof != NULL)
+    {
+        hit_latency = memsys_profile_counts(sys, core_id,
+                                            type != ACCESS_TYPE_IFETCH,
+                                            before);
+    }
+
+    delay = sys->access(sys, line_addr, type, core_id, pc);
+
+    if (sys->pc_prof != NULL)
+    {
+        uint64_t after[3];
+        memsys_profile_counts(sys, core_id, type != ACCESS_TYPE_IFETCH,
+                              after);
+        pcprof_record(sys->pc_prof, pc, sys->asid[core_id], type,
+                      after[0] - before[0], after[1] - before[1],
+                      after[2] - before[2], delay,
+                      (delay > hit_latency) ? delay - hit_latency : 0);
+    }
+
+    if (is_ifetch)
     {
-        delay = memsys_access_modeDEF(sys, line_addr, type, core_id);
+        run->valid = true;
+        run->line_addr = line_addr;
     }
 
     // Update the statistics.
     if (type == ACCESS_TYPE_IFETCH)
     {
-        sys->stat_ifetch_access++;
-        sys->stat_ifetch_delay += delay;
+        sys->stat_ifetch_access[core_id]++;
+        sys->stat_ifetch_delay[core_id] += delay;
     }
 
     if (type == ACCESS_TYPE_LOAD)
     {
-        sys->stat_load_access++;
-        sys->stat_load_delay += delay;
+        sys->stat_load_access[core_id]++;
+        sys->stat_load_delay[core_id] += delay;
     }
 
     if (type == ACCESS_TYPE_STORE)
     {
-        sys->stat_store_access++;
-        sys->stat_store_delay += delay;
+        sys->stat_store_access[core_id]++;
+        sys->stat_store_delay[core_id] += delay;
+    }
+
+    if (sys->delay_hist != NULL)
+    {
+        histogram_record(&sys->delay_hist[core_id * 3 + type], delay);
     }
 
+    selfprof_end(SELFPROF_L1, prof_start);
     return delay;
 }
 
@@ -226,10 +740,12 @@ uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
  *                  cache line size, i.e., excluding the line offset bits).
  * @param type The type of memory access.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return Always 0 in this mode.
  */
 uint64_t memsys_access_modeA(MemorySystem *sys, uint64_t line_addr,
-                             AccessType type, unsigned int core_id)
+                             AccessType type, unsigned int core_id,
+                             uint64_t pc)
 {
     bool needs_dcache_access = false;
     bool is_write = false;
@@ -266,106 +782,6 @@ uint64_t memsys_access_modeA(MemorySystem *sys, uint64_t line_addr,
     return 0;
 }
 
-/**
- * In mode B or C, access the given memory address from an instruction fetch or
- * load/store.
- * 
- * Return the delay in cycles incurred by this memory access. It is intended
- * that the calling function will be responsible for updating the statistics
- * accordingly.
- * 
- * This is intended to be implemented in part B.
- * 
- * @param sys The memory system to use for the access.
- * @param line_addr The address of the cache line to access (in units of the
- *                  cache line size, i.e., excluding the line offset bits).
- * @param type The type of memory access.
- * @param core_id The CPU core ID that requested this access.
- * @return The delay in cycles incurred by this memory access.
- */
-uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
-                              AccessType type, unsigned int core_id)
-{
-    uint64_t delay = 0;
-    CacheResult l1_output;
-    #ifdef DEBUG
-        printf("\nAccessing memory in mode BC (line_addr: %ld, AccessType: %d, core_id: %d)\n", line_addr, type, core_id);
-    #endif
-
-    #ifdef DEBUG
-        printf("\tAccessing L1 cache!\n");
-    #endif
-
-    if (type == ACCESS_TYPE_IFETCH)
-    {
-        // TODO: Simulate the instruction fetch and update delay accordingly.
-        l1_output = cache_access(sys->icache, line_addr, false, core_id);
-        delay += ICACHE_HIT_LATENCY;
-
-        if (l1_output == MISS){
-            //accessing L2 cache
-            delay += memsys_l2_access(sys, line_addr, false, core_id);
-
-            #ifdef DEBUG
-                printf("\tInstalling line in L1 cache!\n");
-            #endif
-            cache_install(sys->icache, line_addr, false, core_id);
-        }
-    }
-    //if(type == ACCESS_TYPE_LOAD || type == ACCESS_TYPE_STORE)
-    else{
-        bool is_write = (type == ACCESS_TYPE_STORE);
-        l1_output = cache_access(sys->dcache, line_addr, is_write, core_id);
-        delay += DCACHE_HIT_LATENCY;
-
-        if(l1_output == MISS){
-            delay += memsys_l2_access(sys, line_addr, false, core_id);
-
-            #ifdef DEBUG
-                printf("\tInstalling line in L1 cache!\n");
-            #endif
-            cache_install(sys->dcache, line_addr, is_write, core_id);
-        }
-
-        //Write back to L2 cache - Using Victim Line
-        if(sys->dcache->last_evicted_line.valid && sys->dcache->last_evicted_line.dirty && !l1_output){
-            uint64_t index_bits = __builtin_log2(sys->dcache->number_of_sets);
-            uint64_t ind = extract_index_mem(line_addr, index_bits);
-            uint64_t evicted_line_address = find_line_address_from_tag_index_mem(sys->dcache->last_evicted_line.tag, ind, index_bits);
-
-            #ifdef DEBUG
-                //printf("\tline addr: %ld, tag: %ld, index: %ld\n", line_addr, sys->dcache->last_evicted_line.tag, ind);
-                printf("\tEvicted L1 entry was dirty! Performing writeback (addr: %ld)\n", evicted_line_address);
-            #endif
-
-            //cache_install(sys->l2cache, evicted_line_address, sys->dcache->last_evicted_line.dirty, core_id);
-            memsys_l2_access(sys, evicted_line_address, sys->dcache->last_evicted_line.dirty, core_id);
-        }
-    }
-    
-    
-    /*
-    if (type == ACCESS_TYPE_LOAD)
-    {
-        // TODO: Simulate the data load and update delay accordingly.
-        CacheResult l1_output = cache_access(sys->dcache, line_addr, false, core_id);
-
-        delay += DCACHE_HIT_LATENCY;
-
-        if(l1_output == MISS){
-            delay += memsys_l2_access(sys, line_addr, false, core_id);
-        }
-    }
-
-    if (type == ACCESS_TYPE_STORE)
-    {
-        // TODO: Simulate the data store and update delay accordingly.
-    }
-    */
-
-    return delay;
-}
-
 /**
  * Access the given address through the shared L2 cache.
  * 
@@ -380,12 +796,15 @@ uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
  *                  offset bits).
  * @param is_writeback Whether this access is a writeback from an L1 cache.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return The delay in cycles incurred by this access.
  */
 uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
-                          bool is_writeback, unsigned int core_id)
+                          bool is_writeback, unsigned int core_id,
+                          uint64_t pc)
 {
     uint64_t delay = L2CACHE_HIT_LATENCY;
+    uint64_t prof_start = selfprof_begin(SELFPROF_L2);
 
     #ifdef DEBUG
         printf("\tAccessing L2 cache!\n");
@@ -400,19 +819,48 @@ uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
 
     //Accessing L2 cache
     CacheResult l2_output = cache_access(sys->l2cache, line_addr, is_writeback, core_id);
+    bool installed = false;
 
-    if(l2_output == MISS){
+    //Every demand access trains the dead-block predictor through its sampler
+    bool predicted_dead = false;
+    if(sys->l2_dbp != NULL && !is_writeback){
+        predicted_dead = dbp_access(sys->l2_dbp, line_addr, pc, core_id);
+    }
+
+    if(l2_output == MISS && is_writeback && sys->l2_dbp != NULL && L2_DBP_POLICY == DBP_BYPASS){
+        //A writeback that misses goes around L2 to DRAM rather than
+        //allocating. Its line either bypassed L2 on the way in or was
+        //evicted from L2 while L1 still held it.
+        dram_access(sys->dram, line_addr, true, core_id);
+        sys->l2_dbp->stat_writeback_around++;
+    }
+    else if(l2_output == MISS){
         //when L2 misses, DRAM is accessed
-        delay += dram_access(sys->dram, line_addr, false);
+        delay += dram_access(sys->dram, line_addr, false, core_id);
 
-        //installing the new line in L2 cache
-        #ifdef DEBUG
-            printf("\tInstalling line in L2 cache!\n");
-        #endif
-        cache_install(sys->l2cache, line_addr, is_writeback, core_id);
+        if(predicted_dead && L2_DBP_POLICY == DBP_BYPASS){
+            //The line goes straight to L1 without displacing anything in L2
+            #ifdef DEBUG
+                printf("\tBypassing L2 cache for predicted-dead line!\n");
+            #endif
+            sys->l2_dbp->stat_bypass++;
+        }
+        else{
+            //installing the new line in L2 cache
+            #ifdef DEBUG
+                printf("\tInstalling line in L2 cache!\n");
+            #endif
+            cache_install(sys->l2cache, line_addr, is_writeback, core_id);
+            installed = true;
+
+            if(predicted_dead){
+                cache_demote(sys->l2cache, line_addr);
+                sys->l2_dbp->stat_lru_insert++;
+            }
+        }
     }
 
-    if(sys->l2cache->last_evicted_line.valid && sys->l2cache->last_evicted_line.dirty && !l2_output){
+    if(sys->l2cache->last_evicted_line.valid && sys->l2cache->last_evicted_line.dirty && installed){
         uint64_t index_bits = __builtin_log2(sys->l2cache->number_of_sets);
         uint64_t ind = extract_index_mem(line_addr, index_bits);
         uint64_t evicted_line_address = find_line_address_from_tag_index_mem(sys->l2cache->last_evicted_line.tag, ind, index_bits);
@@ -421,104 +869,134 @@ uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
             printf("\tEvicted L2 entry was dirty! Performing writeback (addr: %ld)\n", evicted_line_address);
         #endif
 
-        dram_access(sys->dram, evicted_line_address, sys->l2cache->last_evicted_line.dirty);
+        dram_access(sys->dram, evicted_line_address, sys->l2cache->last_evicted_line.dirty, core_id);
     }
 
+    selfprof_end(SELFPROF_L2, prof_start);
     return delay;
 }
 
 /**
- * In mode D, E, or F, access the given virtual address from an instruction
- * fetch or load/store.
- * 
- * Note that you will need to access the per-core icache and dcache. Also note
- * that all caches are physically indexed and physically tagged.
- * 
- * Return the delay in cycles incurred by this memory access. It is intended
- * that the calling function will be responsible for updating the statistics
- * accordingly.
- * 
- * This is intended to be implemented in part D.
- * 
- * @param sys The memory system to use for the access.
- * @param v_line_addr The virtual address of the cache line to access (in units
- *                    of the cache line size, i.e., excluding the line offset
- *                    bits).
- * @param type The type of memory access.
- * @param core_id The CPU core ID that requested this access.
- * @return The delay in cycles incurred by this memory access.
+ * Read one page table entry during a page walk, through the caches below the
+ * L1s.
+ *
+ * The page tables of each address space and level live in their own region of
+ * physical memory above PT_BASE_FRAME. Within a level, the table covering a
+ * VPN is found from the VPN bits above that level, and the entry from the
+ * PT_INDEX_BITS bits at that level.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number (of a 4 KB page) being translated.
+ * @param level The level of the entry, 0 being the last level for 4 KB pages.
+ * @param core_id The CPU core ID whose page table is walked.
+ * @param pc The address of the instruction that caused the walk.
+ * @return The delay in cycles of the read.
  */
-uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
-                               AccessType type, unsigned int core_id)
+static uint64_t memsys_walk_read(MemorySystem *sys, uint64_t vpn,
+                                 unsigned int level, unsigned int core_id,
+                                 uint64_t pc)
 {
-    uint64_t delay = 0;
-    uint64_t p_line_addr = 0;
-    //NUM_CORES = 2;
-
-    // TODO: First convert lineaddr from virtual (v) to physical (p) using the
-    //       function memsys_convert_vpn_to_pfn(). Page size is defined to be
-    //       4 KB, as indicated by the PAGE_SIZE constant.
-    // Note: memsys_convert_vpn_to_pfn() operates at page granularity and
-    //       returns a page number.
-
-    //virtual page number - vpn
-    uint64_t vpn = v_line_addr/(PAGE_SIZE/CACHE_LINESIZE);
-
-    //Physical page number - pfn
-    uint64_t pfn = memsys_convert_vpn_to_pfn(sys, vpn, core_id);
-
-    //physical line address
-    p_line_addr = (pfn * (PAGE_SIZE / CACHE_LINESIZE)) + (v_line_addr % (PAGE_SIZE / CACHE_LINESIZE));
-
-    CacheResult l1_output;
-
-    if (type == ACCESS_TYPE_IFETCH)
+    uint64_t table = vpn >> (PT_INDEX_BITS * (level + 1));
+    uint64_t index = (vpn >> (PT_INDEX_BITS * level)) &
+                     ((1ULL << PT_INDEX_BITS) - 1);
+    uint64_t region = (uint64_t)sys->asid[core_id] * PT_LEVELS + level;
+    uint64_t frame = PT_BASE_FRAME + (region << 28) + table;
+    uint64_t line_addr = (frame * PAGE_SIZE + index * PT_ENTRY_SIZE) /
+                         CACHE_LINESIZE;
+
+    sys->stat_walk_reads++;
+    if (sys->hier != NULL)
     {
-        // TODO: Simulate the instruction fetch and update delay accordingly.
-        l1_output = cache_access(sys->icache_coreid[core_id], p_line_addr, false, core_id);
-        delay += ICACHE_HIT_LATENCY;
-
-        if (l1_output == MISS){
-            //accessing L2 cache
-            delay += memsys_l2_access(sys, p_line_addr, false, core_id);
+        return hier_access(sys->hier, line_addr, ACCESS_TYPE_LOAD, core_id);
+    }
+    return memsys_l2_access(sys, line_addr, false, core_id, pc);
+}
 
-            #ifdef DEBUG
-                printf("\tInstalling line in L1 cache!\n");
-            #endif
-            cache_install(sys->icache_coreid[core_id], p_line_addr, false, core_id);
+/**
+ * Walk the page table of a core to translate a virtual page, one dependent
+ * read per level.
+ *
+ * The walk starts below the deepest upper-level entry held by the core's
+ * page-walk cache, and the entries it reads are added to that cache. With
+ * 2 MB pages the walk ends one level early.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number (of a 4 KB page) to translate.
+ * @param core_id The CPU core ID whose page table is walked.
+ * @param pc The address of the instruction that caused the walk.
+ * @return The delay in cycles of the walk.
+ */
+static uint64_t memsys_page_walk(MemorySystem *sys, uint64_t vpn,
+                                 unsigned int core_id, uint64_t pc)
+{
+    unsigned int leaf = TLB_LARGE_PAGES ? 1 : 0;
+    unsigned int start = PT_LEVELS;
+    unsigned int asid = sys->asid[core_id];
+    TLB *pwc = sys->pwc[core_id];
+
+    // Page-walk cache entries are tagged with their level in the top bits.
+    for (unsigned int level = leaf + 1; pwc != NULL && level < PT_LEVELS;
+         level++)
+    {
+        uint64_t tag = ((uint64_t)level << 56) |
+                       (vpn >> (PT_INDEX_BITS * level));
+        if (tlb_lookup(pwc, tag, asid))
+        {
+            start = level;
+            break;
         }
     }
-    //if(type == ACCESS_TYPE_LOAD || type == ACCESS_TYPE_STORE)
-    else{
-        bool is_write = (type == ACCESS_TYPE_STORE);
-        l1_output = cache_access(sys->dcache_coreid[core_id], p_line_addr, is_write, core_id);
-        delay += DCACHE_HIT_LATENCY;
-
-        if(l1_output == MISS){
-            delay += memsys_l2_access(sys, p_line_addr, false, core_id);
 
-            #ifdef DEBUG
-                printf("\tInstalling line in L1 cache!\n");
-            #endif
-            cache_install(sys->dcache_coreid[core_id], p_line_addr, is_write, core_id);
+    uint64_t delay = 0;
+    for (unsigned int level = start; level-- > leaf;)
+    {
+        delay += memsys_walk_read(sys, vpn, level, core_id, pc);
+        if (pwc != NULL && level > leaf)
+        {
+            tlb_install(pwc, ((uint64_t)level << 56) |
+                                 (vpn >> (PT_INDEX_BITS * level)),
+                        asid);
         }
+    }
 
-        //Write back to L2 cache - Using Victim Line
-        if(sys->dcache_coreid[core_id]->last_evicted_line.valid && sys->dcache_coreid[core_id]->last_evicted_line.dirty && !l1_output){
-            uint64_t index_bits = __builtin_log2(sys->dcache_coreid[core_id]->number_of_sets);
-            uint64_t ind = extract_index_mem(p_line_addr, index_bits);
-            uint64_t evicted_line_address = find_line_address_from_tag_index_mem(sys->dcache_coreid[core_id]->last_evicted_line.tag, ind, index_bits);
-
-            #ifdef DEBUG
-                //printf("\tline addr: %ld, tag: %ld, index: %ld\n", line_addr, sys->dcache->last_evicted_line.tag, ind);
-                printf("\tEvicted L1 entry was dirty! Performing writeback (addr: %ld)\n", evicted_line_address);
-            #endif
+    sys->stat_walks++;
+    sys->stat_walk_cycles += delay;
+    return delay;
+}
 
-            //cache_install(sys->l2cache, evicted_line_address, sys->dcache->last_evicted_line.dirty, core_id);
-            memsys_l2_access(sys, evicted_line_address, true, core_id);
-        }
+/**
+ * Translate a virtual page through the TLBs, walking the page table on a
+ * miss in both levels.
+ *
+ * Return the delay in cycles the translation adds to the access. L1 TLB hits
+ * are overlapped with the L1 cache access and add nothing.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number (of a 4 KB page) to translate.
+ * @param type The type of memory access.
+ * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
+ * @return The delay in cycles incurred by the translation.
+ */
+uint64_t memsys_translate(MemorySystem *sys, uint64_t vpn, AccessType type,
+                          unsigned int core_id, uint64_t pc)
+{
+    uint64_t page = TLB_LARGE_PAGES ? (vpn >> PT_INDEX_BITS) : vpn;
+    unsigned int asid = sys->asid[core_id];
+    TLB *l1 = (type == ACCESS_TYPE_IFETCH) ? sys->itlb[core_id]
+                                           : sys->dtlb[core_id];
+    if (tlb_lookup(l1, page, asid))
+    {
+        return 0;
     }
 
+    uint64_t delay = STLB_HIT_LATENCY;
+    if (!tlb_lookup(sys->stlb, page, asid))
+    {
+        delay += memsys_page_walk(sys, vpn, core_id, pc);
+        tlb_install(sys->stlb, page, asid);
+    }
+    tlb_install(l1, page, asid);
     return delay;
 }
 
@@ -533,19 +1011,293 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
  * 
  * @param sys The memory system being used.
  * @param vpn The virtual page number to convert.
- * @param core_id The CPU core ID that requested this access.
+ * @param core_id The CPU core ID that requested this access, whose current
+ *                address space the page belongs to.
  * @return The physical frame number corresponding to the given VPN.
  */
 uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
                                    unsigned int core_id)
 {
-    assert(NUM_CORES == 2);
+    uint64_t asid = sys->asid[core_id];
+    if (sys->page_alloc != NULL)
+    {
+        return page_alloc_translate(sys->page_alloc, vpn, asid, core_id);
+    }
+
+    // Trace addresses are 32 bits wide, so head is always 0 and every
+    // address space gets frames of its own, however many cores there are.
     uint64_t tail = vpn & 0x000fffff;
     uint64_t head = vpn >> 20;
-    uint64_t pfn = tail + (core_id << 21) + (head << 21);
+    uint64_t pfn = tail + (asid << 21) + (head << 21);
     return pfn;
 }
 
+/**
+ * Defer every access to the shared levels, so that cores may access their
+ * private L1 caches from their own threads.
+ *
+ * @param sys The memory system.
+ * @param max_requests The most requests a core may queue between two calls
+ *                     to memsys_resolve_shared().
+ */
+void memsys_defer_shared(MemorySystem *sys, uint64_t max_requests)
+{
+    assert(SIM_MODE == SIM_MODE_DEF && sys->hier == NULL && !TLB_ENABLED &&
+           sys->page_alloc == NULL);
+
+    uint64_t size = 1;
+    while (size < max_requests)
+    {
+        size *= 2;
+    }
+
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        SharedQueue *q = (SharedQueue *)calloc(1, sizeof(SharedQueue));
+        q->entries = (SharedRequest *)calloc(size, sizeof(SharedRequest));
+        q->size = size;
+        sys->shared_queue[i] = q;
+    }
+
+    sys->access = memsys_access_l1<true, false, true>;
+}
+
+/**
+ * Perform the queued requests to the shared levels, in the order of the
+ * cycle they were made in and then of core ID.
+ *
+ * @param sys The memory system, whose shared levels are deferred.
+ * @param stall Incremented, per core, by the cycles that its instruction
+ *              fetches and loads took beyond the assumed L2 hit.
+ */
+void memsys_resolve_shared(MemorySystem *sys, uint64_t *stall)
+{
+    uint64_t saved_cycle = current_cycle;
+
+    while (true)
+    {
+        // Take the oldest request at the head of any queue, the lowest core
+        // ID first among requests of the same cycle.
+        SharedQueue *next = NULL;
+        unsigned int core_id = 0;
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            SharedQueue *q = sys->shared_queue[i];
+            uint64_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+            if (q->head == tail)
+            {
+                continue;
+            }
+            SharedRequest *req = &q->entries[q->head & (q->size - 1)];
+            if (next == NULL ||
+                req->cycle < next->entries[next->head & (next->size - 1)].cycle)
+            {
+                next = q;
+                core_id = i;
+            }
+        }
+        if (next == NULL)
+        {
+            break;
+        }
+
+        SharedRequest *req = &next->entries[next->head & (next->size - 1)];
+        current_cycle = req->cycle;
+        uint64_t delay = memsys_l2_access(sys, req->line_addr,
+                                          req->is_writeback, core_id, req->pc);
+        if (!req->is_writeback)
+        {
+            uint64_t extra = delay - L2CACHE_HIT_LATENCY;
+            if (req->type == ACCESS_TYPE_IFETCH)
+            {
+                sys->stat_ifetch_delay[core_id] += extra;
+                stall[core_id] += extra;
+            }
+            if (req->type == ACCESS_TYPE_LOAD)
+            {
+                sys->stat_load_delay[core_id] += extra;
+                stall[core_id] += extra;
+            }
+            if (req->type == ACCESS_TYPE_STORE)
+            {
+                sys->stat_store_delay[core_id] += extra;
+            }
+        }
+        __atomic_store_n(&next->head, next->head + 1, __ATOMIC_RELEASE);
+    }
+
+    current_cycle = saved_cycle;
+}
+
+/**
+ * Switch a core to another address space, as on a context switch.
+ *
+ * Optionally flush the core's L1 caches, writing their dirty lines back to
+ * the L2 cache, and its L1 TLBs and page-walk cache. The flushes take no
+ * simulated time; their cost is part of the switch cost.
+ *
+ * @param sys The memory system.
+ * @param core_id The CPU core ID that switches.
+ * @param asid The address space the core runs in from now on.
+ * @param flush_caches Whether to flush the L1 caches of the core.
+ * @param flush_tlbs Whether to flush the L1 TLBs and page-walk cache of the
+ *                   core.
+ * @return The number of dirty lines written back by the flush.
+ */
+uint64_t memsys_switch(MemorySystem *sys, unsigned int core_id,
+                       unsigned int asid, bool flush_caches, bool flush_tlbs)
+{
+    // A fetch run belongs to the old address space.
+    sys->end_ifetch_run(sys, core_id);
+    sys->asid[core_id] = asid;
+
+    uint64_t writebacks = 0;
+    for (unsigned int is_data = 0; flush_caches && is_data < 2; is_data++)
+    {
+        Cache *l1 = sys->l1[core_id][is_data];
+        uint64_t *dirty_lines = (uint64_t *)calloc(
+            l1->number_of_sets * l1->number_of_ways, sizeof(uint64_t));
+        uint64_t dirty_count = cache_flush(l1, dirty_lines);
+        for (uint64_t i = 0; i < dirty_count; i++)
+        {
+            memsys_l2_access(sys, dirty_lines[i], true, core_id, 0);
+        }
+        writebacks += dirty_count;
+        free(dirty_lines);
+    }
+
+    if (flush_tlbs && TLB_ENABLED)
+    {
+        tlb_flush(sys->itlb[core_id]);
+        tlb_flush(sys->dtlb[core_id]);
+        if (sys->pwc[core_id] != NULL)
+        {
+            tlb_flush(sys->pwc[core_id]);
+        }
+    }
+
+    return writebacks;
+}
+
+/**
+ * Freeze the statistics of a core, i.e. its memory access counts and those
+ * of its L1 caches and TLBs, as it reaches its instruction target.
+ *
+ * @param sys The memory system.
+ * @param core_id The CPU core ID.
+ */
+void memsys_freeze_core(MemorySystem *sys, unsigned int core_id)
+{
+    sys->end_ifetch_run(sys, core_id);
+
+    FrozenStats *f = &sys->frozen[core_id];
+    f->valid = true;
+    f->ifetch_access = sys->stat_ifetch_access[core_id];
+    f->load_access = sys->stat_load_access[core_id];
+    f->store_access = sys->stat_store_access[core_id];
+    f->ifetch_delay = sys->stat_ifetch_delay[core_id];
+    f->load_delay = sys->stat_load_delay[core_id];
+    f->store_delay = sys->stat_store_delay[core_id];
+    for (unsigned int is_data = 0; is_data < 2; is_data++)
+    {
+        if (sys->l1[core_id][is_data] != NULL)
+        {
+            f->l1[is_data] = *sys->l1[core_id][is_data];
+        }
+    }
+    if (sys->itlb[core_id] != NULL)
+    {
+        f->itlb = *sys->itlb[core_id];
+        f->dtlb = *sys->dtlb[core_id];
+    }
+}
+
+/**
+ * Put the frozen statistics of each core back in place of its final ones.
+ *
+ * @param sys The memory system.
+ */
+static void memsys_restore_frozen(MemorySystem *sys)
+{
+    for (unsigned int i = 0; i < MAX_CORES; i++)
+    {
+        FrozenStats *f = &sys->frozen[i];
+        if (!f->valid)
+        {
+            continue;
+        }
+
+        sys->stat_ifetch_access[i] = f->ifetch_access;
+        sys->stat_load_access[i] = f->load_access;
+        sys->stat_store_access[i] = f->store_access;
+        sys->stat_ifetch_delay[i] = f->ifetch_delay;
+        sys->stat_load_delay[i] = f->load_delay;
+        sys->stat_store_delay[i] = f->store_delay;
+        for (unsigned int is_data = 0; is_data < 2; is_data++)
+        {
+            Cache *l1 = sys->l1[i][is_data];
+            if (l1 != NULL)
+            {
+                l1->stat_read_access = f->l1[is_data].stat_read_access;
+                l1->stat_read_miss = f->l1[is_data].stat_read_miss;
+                l1->stat_write_access = f->l1[is_data].stat_write_access;
+                l1->stat_write_miss = f->l1[is_data].stat_write_miss;
+                l1->stat_dirty_evicts = f->l1[is_data].stat_dirty_evicts;
+            }
+        }
+        if (sys->itlb[i] != NULL)
+        {
+            sys->itlb[i]->stat_access = f->itlb.stat_access;
+            sys->itlb[i]->stat_miss = f->itlb.stat_miss;
+            sys->dtlb[i]->stat_access = f->dtlb.stat_access;
+            sys->dtlb[i]->stat_miss = f->dtlb.stat_miss;
+        }
+    }
+}
+
+/**
+ * Print the statistics of the TLBs, page-walk caches and page walks, if TLBs
+ * are enabled.
+ *
+ * @param sys The memory system to print the statistics of.
+ */
+static void memsys_print_tlb_stats(MemorySystem *sys)
+{
+    if (!TLB_ENABLED)
+    {
+        return;
+    }
+
+    char header[32];
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        snprintf(header, sizeof(header), "ITLB_%u", i);
+        tlb_print_stats(sys->itlb[i], header);
+        snprintf(header, sizeof(header), "DTLB_%u", i);
+        tlb_print_stats(sys->dtlb[i], header);
+        if (sys->pwc[i] != NULL)
+        {
+            snprintf(header, sizeof(header), "PWC_%u", i);
+            tlb_print_stats(sys->pwc[i], header);
+        }
+    }
+    tlb_print_stats(sys->stlb, "STLB");
+
+    double reads_avg = 0.0;
+    double cycles_avg = 0.0;
+    if (sys->stat_walks)
+    {
+        reads_avg = (double)(sys->stat_walk_reads) / (double)(sys->stat_walks);
+        cycles_avg = (double)(sys->stat_walk_cycles) /
+                     (double)(sys->stat_walks);
+    }
+
+    printf("\n");
+    printf("PTW_WALKS              \t\t : %10llu\n", sys->stat_walks);
+    printf("PTW_READS_AVG          \t\t : %10.3f\n", reads_avg);
+    printf("PTW_CYCLES_AVG         \t\t : %10.3f\n", cycles_avg);
+}
+
 /**
  * Print the statistics of the memory system.
  * 
@@ -559,29 +1311,66 @@ void memsys_print_stats(MemorySystem *sys)
     double load_delay_avg = 0;
     double store_delay_avg = 0;
 
-    if (sys->stat_ifetch_access)
+    unsigned long long ifetch_access = 0;
+    unsigned long long load_access = 0;
+    unsigned long long store_access = 0;
+    uint64_t ifetch_delay = 0;
+    uint64_t load_delay = 0;
+    uint64_t store_delay = 0;
+
+    for (unsigned int i = 0; i < NUM_CORES; i++)
     {
-        ifetch_delay_avg = (double)(sys->stat_ifetch_delay) / (double)(sys->stat_ifetch_access);
+        sys->end_ifetch_run(sys, i);
     }
+    memsys_restore_frozen(sys);
 
-    if (sys->stat_load_access)
+    for (unsigned int i = 0; i < MAX_CORES; i++)
     {
-        load_delay_avg = (double)(sys->stat_load_delay) / (double)(sys->stat_load_access);
+        ifetch_access += sys->stat_ifetch_access[i];
+        load_access += sys->stat_load_access[i];
+        store_access += sys->stat_store_access[i];
+        ifetch_delay += sys->stat_ifetch_delay[i];
+        load_delay += sys->stat_load_delay[i];
+        store_delay += sys->stat_store_delay[i];
     }
 
-    if (sys->stat_store_access)
+    if (ifetch_access)
     {
-        store_delay_avg = (double)(sys->stat_store_delay) / (double)(sys->stat_store_access);
+        ifetch_delay_avg = (double)(ifetch_delay) / (double)(ifetch_access);
+    }
+
+    if (load_access)
+    {
+        load_delay_avg = (double)(load_delay) / (double)(load_access);
+    }
+
+    if (store_access)
+    {
+        store_delay_avg = (double)(store_delay) / (double)(store_access);
     }
 
     printf("\n");
-    printf("MEMSYS_IFETCH_ACCESS   \t\t : %10llu\n", sys->stat_ifetch_access);
-    printf("MEMSYS_LOAD_ACCESS     \t\t : %10llu\n", sys->stat_load_access);
-    printf("MEMSYS_STORE_ACCESS    \t\t : %10llu\n", sys->stat_store_access);
+    printf("MEMSYS_IFETCH_ACCESS   \t\t : %10llu\n", ifetch_access);
+    printf("MEMSYS_LOAD_ACCESS     \t\t : %10llu\n", load_access);
+    printf("MEMSYS_STORE_ACCESS    \t\t : %10llu\n", store_access);
     printf("MEMSYS_IFETCH_AVGDELAY \t\t : %10.3f\n", ifetch_delay_avg);
     printf("MEMSYS_LOAD_AVGDELAY   \t\t : %10.3f\n", load_delay_avg);
     printf("MEMSYS_STORE_AVGDELAY  \t\t : %10.3f\n", store_delay_avg);
 
+    if (sys->hier != NULL)
+    {
+        hier_print_stats(sys->hier);
+        if (sys->hier_translate)
+        {
+            memsys_print_tlb_stats(sys);
+        }
+        if (sys->page_alloc != NULL)
+        {
+            page_alloc_print_stats(sys->page_alloc);
+        }
+        return;
+    }
+
     if (SIM_MODE == SIM_MODE_A)
     {
         cache_print_stats(sys->dcache, "DCACHE");
@@ -592,17 +1381,266 @@ void memsys_print_stats(MemorySystem *sys)
         cache_print_stats(sys->icache, "ICACHE");
         cache_print_stats(sys->dcache, "DCACHE");
         cache_print_stats(sys->l2cache, "L2CACHE");
+        if (sys->l2_dbp != NULL)
+        {
+            dbp_print_stats(sys->l2_dbp, "L2CACHE");
+        }
         dram_print_stats(sys->dram);
     }
 
     if (SIM_MODE == SIM_MODE_DEF)
     {
-        assert(NUM_CORES == 2);
-        cache_print_stats(sys->icache_coreid[0], "ICACHE_0");
-        cache_print_stats(sys->dcache_coreid[0], "DCACHE_0");
-        cache_print_stats(sys->icache_coreid[1], "ICACHE_1");
-        cache_print_stats(sys->dcache_coreid[1], "DCACHE_1");
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            cache_print_stats(sys->icache_coreid[i], sys->l1_name[i][0]);
+            cache_print_stats(sys->dcache_coreid[i], sys->l1_name[i][1]);
+        }
         cache_print_stats(sys->l2cache, "L2CACHE");
+        if (sys->l2_dbp != NULL)
+        {
+            dbp_print_stats(sys->l2_dbp, "L2CACHE");
+        }
+        memsys_print_tlb_stats(sys);
+        if (sys->page_alloc != NULL)
+        {
+            page_alloc_print_stats(sys->page_alloc);
+        }
         dram_print_stats(sys->dram);
     }
 }
+
+/**
+ * Add an entry to a list of caches.
+ *
+ * @param caches The list.
+ * @param count The number of entries so far, which is incremented.
+ * @param name The label of the cache.
+ * @param cache The cache.
+ * @param owner The core the cache is private to, or MAX_CORES.
+ */
+static void memsys_add_cache(MemsysCache *caches, unsigned int *count,
+                             const char *name, Cache *cache,
+                             unsigned int owner)
+{
+    assert(*count < STATS_MAX_CACHES);
+    caches[*count].name = name;
+    caches[*count].cache = cache;
+    caches[*count].owner = owner;
+    (*count)++;
+}
+
+/**
+ * List the caches of the memory system in the order memsys_print_stats()
+ * prints them.
+ *
+ * @param sys The memory system.
+ * @param caches The array to fill, with room for STATS_MAX_CACHES entries.
+ * @return The number of caches.
+ */
+unsigned int memsys_list_caches(MemorySystem *sys, MemsysCache *caches)
+{
+    unsigned int count = 0;
+
+    if (sys->hier != NULL)
+    {
+        for (unsigned int i = 0; i < sys->hier->num_caches; i++)
+        {
+            HierCache *hc = &sys->hier->caches[i];
+            memsys_add_cache(caches, &count, hc->name, hc->cache, hc->owner);
+        }
+        return count;
+    }
+
+    if (SIM_MODE == SIM_MODE_A)
+    {
+        memsys_add_cache(caches, &count, "DCACHE", sys->dcache, 0);
+    }
+
+    if ((SIM_MODE == SIM_MODE_B) || (SIM_MODE == SIM_MODE_C))
+    {
+        memsys_add_cache(caches, &count, "ICACHE", sys->icache, 0);
+        memsys_add_cache(caches, &count, "DCACHE", sys->dcache, 0);
+        memsys_add_cache(caches, &count, "L2CACHE", sys->l2cache, 0);
+    }
+
+    if (SIM_MODE == SIM_MODE_DEF)
+    {
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            memsys_add_cache(caches, &count, sys->l1_name[i][0],
+                             sys->icache_coreid[i], i);
+            memsys_add_cache(caches, &count, sys->l1_name[i][1],
+                             sys->dcache_coreid[i], i);
+        }
+        memsys_add_cache(caches, &count, "L2CACHE", sys->l2cache, MAX_CORES);
+    }
+
+    return count;
+}
+
+/**
+ * Label the delay histogram of a core and access type.
+ *
+ * @param label The buffer to write the label to.
+ * @param size The size of the buffer.
+ * @param index The index of the histogram in sys->delay_hist.
+ */
+static void memsys_hist_label(char *label, size_t size, unsigned int index)
+{
+    static const char *type_names[] = {"IFETCH", "LOAD", "STORE"};
+    snprintf(label, size, "CORE_%u_%s_LAT", index / 3,
+             type_names[index % 3]);
+}
+
+/**
+ * Add the statistics of the TLBs, page-walk caches and page walks to a
+ * registry, if TLBs are enabled.
+ *
+ * @param sys The memory system to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+static void memsys_collect_tlb_stats(MemorySystem *sys, StatsRegistry *reg)
+{
+    if (!TLB_ENABLED)
+    {
+        return;
+    }
+
+    char header[32];
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        snprintf(header, sizeof(header), "ITLB_%u", i);
+        tlb_collect_stats(sys->itlb[i], header, reg);
+        snprintf(header, sizeof(header), "DTLB_%u", i);
+        tlb_collect_stats(sys->dtlb[i], header, reg);
+        if (sys->pwc[i] != NULL)
+        {
+            snprintf(header, sizeof(header), "PWC_%u", i);
+            tlb_collect_stats(sys->pwc[i], header, reg);
+        }
+    }
+    tlb_collect_stats(sys->stlb, "STLB", reg);
+
+    double reads_avg = 0.0;
+    double cycles_avg = 0.0;
+    if (sys->stat_walks)
+    {
+        reads_avg = (double)(sys->stat_walk_reads) / (double)(sys->stat_walks);
+        cycles_avg = (double)(sys->stat_walk_cycles) /
+                     (double)(sys->stat_walks);
+    }
+
+    stats_add_count(reg, "PTW", "WALKS", sys->stat_walks);
+    stats_add_real(reg, "PTW", "READS_AVG", reads_avg);
+    stats_add_real(reg, "PTW", "CYCLES_AVG", cycles_avg);
+}
+
+/**
+ * Add the statistics of the memory system to a registry, under the names
+ * memsys_print_stats() prints them with.
+ *
+ * @param sys The memory system to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void memsys_collect_stats(MemorySystem *sys, StatsRegistry *reg)
+{
+    unsigned long long access[3] = {0, 0, 0};
+    uint64_t delay[3] = {0, 0, 0};
+    for (unsigned int i = 0; i < MAX_CORES; i++)
+    {
+        access[0] += sys->stat_ifetch_access[i];
+        access[1] += sys->stat_load_access[i];
+        access[2] += sys->stat_store_access[i];
+        delay[0] += sys->stat_ifetch_delay[i];
+        delay[1] += sys->stat_load_delay[i];
+        delay[2] += sys->stat_store_delay[i];
+    }
+
+    const char *names[3] = {"IFETCH", "LOAD", "STORE"};
+    char name[32];
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        snprintf(name, sizeof(name), "%s_ACCESS", names[i]);
+        stats_add_count(reg, "MEMSYS", name, access[i]);
+    }
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        double delay_avg = 0.0;
+        if (access[i])
+        {
+            delay_avg = (double)(delay[i]) / (double)(access[i]);
+        }
+        snprintf(name, sizeof(name), "%s_AVGDELAY", names[i]);
+        stats_add_real(reg, "MEMSYS", name, delay_avg);
+    }
+    for (unsigned int i = 0; sys->delay_hist != NULL && i < NUM_CORES * 3;
+         i++)
+    {
+        memsys_hist_label(name, sizeof(name), i);
+        histogram_collect_stats(&sys->delay_hist[i], name, reg);
+    }
+
+    if (sys->hier != NULL)
+    {
+        hier_collect_stats(sys->hier, reg);
+        if (sys->hier_translate)
+        {
+            memsys_collect_tlb_stats(sys, reg);
+        }
+        if (sys->page_alloc != NULL)
+        {
+            page_alloc_collect_stats(sys->page_alloc, reg);
+        }
+        return;
+    }
+
+    MemsysCache caches[STATS_MAX_CACHES];
+    unsigned int num_caches = memsys_list_caches(sys, caches);
+    for (unsigned int i = 0; i < num_caches; i++)
+    {
+        cache_collect_stats(caches[i].cache, caches[i].name, reg);
+    }
+    if (sys->l2_dbp != NULL)
+    {
+        dbp_collect_stats(sys->l2_dbp, "L2CACHE", reg);
+    }
+
+    if (SIM_MODE == SIM_MODE_DEF)
+    {
+        memsys_collect_tlb_stats(sys, reg);
+        if (sys->page_alloc != NULL)
+        {
+            page_alloc_collect_stats(sys->page_alloc, reg);
+        }
+    }
+
+    if (sys->dram != NULL)
+    {
+        dram_collect_stats(sys->dram, reg);
+    }
+}
+
+/**
+ * Print the percentiles of the delays of each core's instruction fetches,
+ * loads and stores, and of DRAM reads and writes, if they are recorded.
+ *
+ * @param sys The memory system to print the statistics of.
+ */
+void memsys_print_hist_stats(MemorySystem *sys)
+{
+    if (sys->delay_hist == NULL)
+    {
+        return;
+    }
+
+    char label[32];
+    for (unsigned int i = 0; i < NUM_CORES * 3; i++)
+    {
+        memsys_hist_label(label, sizeof(label), i);
+        histogram_print_stats(&sys->delay_hist[i], label);
+    }
+    if (sys->dram != NULL)
+    {
+        dram_print_hist_stats(sys->dram);
+    }
+}
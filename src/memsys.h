@@ -12,11 +12,103 @@
 #include "types.h"
 #include "cache.h"
 #include "dram.h"
+#include "hierarchy.h"
+#include "deadblock.h"
+#include "tlb.h"
+#include "pagealloc.h"
+#include "pcprof.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of bytes in a page. */
+#define PAGE_SIZE 4096
 
 ///////////////////////////////////////////////////////////////////////////////
 //                              DATA STRUCTURES                              //
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A run of consecutive instruction fetches by one core from the same line.
+ * Every fetch after the first hits the L1 instruction cache (and L1 TLB),
+ * so those hits are counted here and charged to them in bulk when the run
+ * ends.
+ */
+typedef struct IfetchRun
+{
+    bool valid;
+
+    /** The line fetched, as seen by the core (virtual in mode 4). */
+    uint64_t line_addr;
+
+    /** The hits not yet charged, and the cycle of the last one. */
+    unsigned long long hits;
+    uint64_t last_cycle;
+} IfetchRun;
+
+/** A request made by a core of the shared levels (L2 cache and DRAM). */
+typedef struct SharedRequest
+{
+    /** The cycle at which the core made the request. */
+    uint64_t cycle;
+
+    uint64_t line_addr;
+    uint64_t pc;
+
+    /** The access that caused the request, for its statistics. */
+    AccessType type;
+
+    /** Whether this writes back a dirty line evicted from the L1. */
+    bool is_writeback;
+} SharedRequest;
+
+/**
+ * A lock-free single-producer, single-consumer ring of requests. The core's
+ * thread appends at the tail and the main thread removes from the head.
+ */
+typedef struct SharedQueue
+{
+    SharedRequest *entries;
+
+    /** The number of entries (a power of 2). */
+    uint64_t size;
+
+    /** Ever-increasing positions; entries are indexed modulo size. */
+    uint64_t head;
+    uint64_t tail;
+} SharedQueue;
+
+/**
+ * The statistics of one core, as they were when it reached its instruction
+ * target in replay mode.
+ */
+typedef struct FrozenStats
+{
+    bool valid;
+    unsigned long long ifetch_access;
+    unsigned long long load_access;
+    unsigned long long store_access;
+    uint64_t ifetch_delay;
+    uint64_t load_delay;
+    uint64_t store_delay;
+
+    /** Copies of the core's L1 caches and TLBs, for their statistics. */
+    Cache l1[2];
+    TLB itlb;
+    TLB dtlb;
+} FrozenStats;
+
+/** A cache of the memory system, as its statistics are labelled. */
+typedef struct MemsysCache
+{
+    const char *name;
+    Cache *cache;
+
+    /** The core the cache is private to, or MAX_CORES if it is shared. */
+    unsigned int owner;
+} MemsysCache;
+
 typedef struct MemorySystem
 {
     /** A cache for data accesses. Used in parts A, B, and C. */
@@ -28,48 +120,156 @@ typedef struct MemorySystem
      * The data caches for each core in a multicore system. Used in parts D,
      * E, and F.
      */
-    Cache *dcache_coreid[2];
+    Cache *dcache_coreid[MAX_CORES];
     /**
      * The instruction caches for each core in a multicore system. Used in
      * parts D, E, and F.
      */
-    Cache *icache_coreid[2];
+    Cache *icache_coreid[MAX_CORES];
+
+    /**
+     * The statistics labels of the per-core caches, such as ICACHE_0, indexed
+     * like l1. Used in parts D, E, and F.
+     */
+    char l1_name[MAX_CORES][2][HIER_NAME_LEN];
+
+    /**
+     * The L1 cache used by each core in modes B through F, indexed by core ID
+     * and then by whether the access is for data (0 for instruction fetches).
+     */
+    Cache *l1[MAX_CORES][2];
 
     /** The shared L2 cache. Used in parts B, C, D, E, and F. */
     Cache *l2cache;
     /** The DRAM module. Used in parts B, C, D, E, and F. */
     DRAM *dram;
 
+    /**
+     * The dead-block predictor deciding how the L2 cache handles fills, or
+     * NULL if every fill is installed normally.
+     */
+    DeadBlockPredictor *l2_dbp;
+
+    /**
+     * A cache hierarchy built from a configuration file. When this is set, it
+     * replaces the caches above, and all accesses are routed through it.
+     */
+    Hierarchy *hier;
+    /**
+     * Whether accesses to the hierarchy are translated from virtual to
+     * physical addresses first, as in parts D, E, and F.
+     */
+    bool hier_translate;
+
+    /**
+     * The access path for the mode and configuration, chosen once in
+     * memsys_new() so that memsys_access() does not re-check them.
+     */
+    uint64_t (*access)(struct MemorySystem *sys, uint64_t line_addr,
+                       AccessType type, unsigned int core_id, uint64_t pc);
+
+    /**
+     * Ends the instruction fetch run of a core, likewise chosen for the mode
+     * and whether TLBs are enabled.
+     */
+    void (*end_ifetch_run)(struct MemorySystem *sys, unsigned int core_id);
+
+    /**
+     * Whether same-line instruction fetch runs take the fast path. This holds
+     * where nothing but the core's own fetches touches its L1 instruction
+     * cache and TLB: the private L1s of modes D through F, and the shared L1
+     * of modes B and C with a single core. A configured hierarchy may
+     * back-invalidate them, so it does not use it.
+     */
+    bool ifetch_runs;
+    IfetchRun ifetch_run[MAX_CORES];
+
+    /**
+     * When TLBs are enabled, the L1 instruction and data TLBs of each core,
+     * the L2 TLB shared by all cores, and each core's page-walk cache (NULL
+     * if disabled). Used wherever virtual addresses are translated.
+     */
+    TLB *itlb[MAX_CORES];
+    TLB *dtlb[MAX_CORES];
+    TLB *stlb;
+    TLB *pwc[MAX_CORES];
+
+    /**
+     * The allocator choosing the frame of each virtual page, or NULL to use
+     * the fixed mapping of memsys_convert_vpn_to_pfn().
+     */
+    PageAllocator *page_alloc;
+
+    /**
+     * The address space each core is running in, which selects its page
+     * table and tags its translations. This is the core's own ID unless a
+     * scheduler switches traces between cores (see memsys_switch()).
+     */
+    unsigned int asid[MAX_CORES];
+
+    /**
+     * The statistics of each core that has reached its instruction target,
+     * which memsys_print_stats() reports in place of the final ones.
+     */
+    FrozenStats frozen[MAX_CORES];
+
+    /**
+     * The profiler that attributes misses and stall cycles to the PCs of
+     * the accesses, or NULL. Profiling needs the shared levels accessed
+     * synchronously, so it is not used with the parallel engine.
+     */
+    PCProfiler *pc_prof;
+
+    /**
+     * The histograms of the delays of each core's accesses, indexed by core
+     * ID times 3 plus the access type, or NULL if they are not recorded.
+     */
+    Histogram *delay_hist;
+
+    /**
+     * The number of page walks, the page table entries they read, and the
+     * cycles they took.
+     */
+    unsigned long long stat_walks;
+    unsigned long long stat_walk_reads;
+    unsigned long long stat_walk_cycles;
+
+    /**
+     * When the shared levels are accessed from the main thread only (see
+     * memsys_defer_shared()), the requests each core has made of them.
+     */
+    SharedQueue *shared_queue[MAX_CORES];
+
     /**
      * The total number of times the memory system was accessed for an
-     * instruction fetch. This is updated for you in memsys_access().
+     * instruction fetch, per core. This is updated for you in memsys_access().
      */
-    unsigned long long stat_ifetch_access;
+    unsigned long long stat_ifetch_access[MAX_CORES];
     /**
      * The total number of times the memory system was accessed for a data
-     * load. This is updated for you in memsys_access().
+     * load, per core. This is updated for you in memsys_access().
      */
-    unsigned long long stat_load_access;
+    unsigned long long stat_load_access[MAX_CORES];
     /**
      * The total number of times the memory system was accessed for a data
-     * store. This is updated for you in memsys_access().
+     * store, per core. This is updated for you in memsys_access().
      */
-    unsigned long long stat_store_access;
+    unsigned long long stat_store_access[MAX_CORES];
     /**
-     * The total number of cycles spent on instruction fetches. This is updated
-     * for you in memsys_access().
+     * The total number of cycles spent on instruction fetches, per core. This
+     * is updated for you in memsys_access().
      */
-    uint64_t stat_ifetch_delay;
+    uint64_t stat_ifetch_delay[MAX_CORES];
     /**
-     * The total number of cycles spent on data loads. This is updated for you
-     * in memsys_access().
+     * The total number of cycles spent on data loads, per core. This is
+     * updated for you in memsys_access().
      */
-    uint64_t stat_load_delay;
+    uint64_t stat_load_delay[MAX_CORES];
     /**
-     * The total number of cycles spent on data stores. This is updated for you
-     * in memsys_access().
+     * The total number of cycles spent on data stores, per core. This is
+     * updated for you in memsys_access().
      */
-    uint64_t stat_store_delay;
+    uint64_t stat_store_delay[MAX_CORES];
 } MemorySystem;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -81,7 +281,9 @@ typedef struct MemorySystem
  * 
  * This is implemented for you, but you may modify it as needed.
  * 
- * @return A pointer to the memory system.
+ * @return A pointer to the memory system, or NULL if the cache hierarchy
+ *         configuration could not be loaded or the page allocation policy
+ *         cannot be used.
  */
 MemorySystem *memsys_new();
 
@@ -97,10 +299,11 @@ MemorySystem *memsys_new();
  * @param addr The address to access (in bytes).
  * @param type The type of memory access.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return The delay in cycles incurred by this memory access.
  */
 uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
-                       unsigned int core_id);
+                       unsigned int core_id, uint64_t pc);
 
 /**
  * In mode A, access the given memory address from a load or store.
@@ -115,30 +318,12 @@ uint64_t memsys_access(MemorySystem *sys, uint64_t addr, AccessType type,
  *                  cache line size, i.e., excluding the line offset bits).
  * @param type The type of memory access.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return Always 0 in this mode.
  */
 uint64_t memsys_access_modeA(MemorySystem *sys, uint64_t line_addr,
-                             AccessType type, unsigned int core_id);
-
-/**
- * In mode B or C, access the given memory address from an instruction fetch or
- * load/store.
- * 
- * Return the delay in cycles incurred by this memory access. It is intended
- * that the calling function will be responsible for updating the statistics
- * accordingly.
- * 
- * This is intended to be implemented in part B.
- * 
- * @param sys The memory system to use for the access.
- * @param line_addr The address of the cache line to access (in units of the
- *                  cache line size, i.e., excluding the line offset bits).
- * @param type The type of memory access.
- * @param core_id The CPU core ID that requested this access.
- * @return The delay in cycles incurred by this memory access.
- */
-uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
-                              AccessType type, unsigned int core_id);
+                             AccessType type, unsigned int core_id,
+                             uint64_t pc);
 
 /**
  * Access the given address through the shared L2 cache.
@@ -154,34 +339,29 @@ uint64_t memsys_access_modeBC(MemorySystem *sys, uint64_t line_addr,
  *                  offset bits).
  * @param is_writeback Whether this access is a writeback from an L1 cache.
  * @param core_id The CPU core ID that requested this access.
+ * @param pc The address of the instruction that caused this access.
  * @return The delay in cycles incurred by this access.
  */
 uint64_t memsys_l2_access(MemorySystem *sys, uint64_t line_addr,
-                          bool is_writeback, unsigned int core_id);
+                          bool is_writeback, unsigned int core_id,
+                          uint64_t pc);
 
 /**
- * In mode D, E, or F, access the given virtual address from an instruction
- * fetch or load/store.
- * 
- * Note that you will need to access the per-core icache and dcache. Also note
- * that all caches are physically indexed and physically tagged.
- * 
- * Return the delay in cycles incurred by this memory access. It is intended
- * that the calling function will be responsible for updating the statistics
- * accordingly.
- * 
- * This is intended to be implemented in part D.
- * 
- * @param sys The memory system to use for the access.
- * @param v_line_addr The virtual address of the cache line to access (in units
- *                    of the cache line size, i.e., excluding the line offset
- *                    bits).
+ * Translate a virtual page through the TLBs, walking the page table on a
+ * miss in both levels.
+ *
+ * Return the delay in cycles the translation adds to the access. L1 TLB hits
+ * are overlapped with the L1 cache access and add nothing.
+ *
+ * @param sys The memory system being used.
+ * @param vpn The virtual page number (of a 4 KB page) to translate.
  * @param type The type of memory access.
  * @param core_id The CPU core ID that requested this access.
- * @return The delay in cycles incurred by this memory access.
+ * @param pc The address of the instruction that caused this access.
+ * @return The delay in cycles incurred by the translation.
  */
-uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
-                               AccessType type, unsigned int core_id);
+uint64_t memsys_translate(MemorySystem *sys, uint64_t vpn, AccessType type,
+                          unsigned int core_id, uint64_t pc);
 
 /**
  * Convert the given virtual page number (VPN) to its corresponding physical
@@ -194,12 +374,71 @@ uint64_t memsys_access_modeDEF(MemorySystem *sys, uint64_t v_line_addr,
  * 
  * @param sys The memory system being used.
  * @param vpn The virtual page number to convert.
- * @param core_id The CPU core ID that requested this access.
+ * @param core_id The CPU core ID that requested this access, whose current
+ *                address space the page belongs to.
  * @return The physical frame number corresponding to the given VPN.
  */
 uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
                                    unsigned int core_id);
 
+/**
+ * Defer every access to the shared levels, so that cores may access their
+ * private L1 caches from their own threads.
+ *
+ * Afterwards, an L1 miss or dirty eviction is queued for the main thread,
+ * and a miss is assumed to hit the L2 cache. memsys_resolve_shared() then
+ * performs the queued requests and reports how much longer they took.
+ *
+ * Only the fixed hierarchy of mode 4 without TLBs or a page allocator can be
+ * deferred, since everything else it touches is private to a core.
+ *
+ * @param sys The memory system.
+ * @param max_requests The most requests a core may queue between two calls
+ *                     to memsys_resolve_shared().
+ */
+void memsys_defer_shared(MemorySystem *sys, uint64_t max_requests);
+
+/**
+ * Perform the queued requests to the shared levels, in the order of the
+ * cycle they were made in and then of core ID, as if each core's accesses of
+ * a cycle had been simulated one core after another.
+ *
+ * @param sys The memory system, whose shared levels are deferred.
+ * @param stall Incremented, per core, by the cycles that its instruction
+ *              fetches and loads took beyond the assumed L2 hit.
+ */
+void memsys_resolve_shared(MemorySystem *sys, uint64_t *stall);
+
+/**
+ * Switch a core to another address space, as on a context switch.
+ *
+ * Optionally flush the core's L1 caches, writing their dirty lines back to
+ * the L2 cache, and its L1 TLBs and page-walk cache, as an OS without
+ * address space tags or with flush-on-switch mitigations would. The flushes
+ * take no simulated time; their cost is part of the switch cost.
+ *
+ * @param sys The memory system.
+ * @param core_id The CPU core ID that switches.
+ * @param asid The address space the core runs in from now on.
+ * @param flush_caches Whether to flush the L1 caches of the core. Only the
+ *                     fixed hierarchy of mode 4 can be flushed.
+ * @param flush_tlbs Whether to flush the L1 TLBs and page-walk cache of the
+ *                   core.
+ * @return The number of dirty lines written back by the flush.
+ */
+uint64_t memsys_switch(MemorySystem *sys, unsigned int core_id,
+                       unsigned int asid, bool flush_caches, bool flush_tlbs);
+
+/**
+ * Freeze the statistics of a core, i.e. its memory access counts and those
+ * of its L1 caches and TLBs, as it reaches its instruction target. The
+ * shared levels keep counting until the simulation ends.
+ *
+ * @param sys The memory system.
+ * @param core_id The CPU core ID.
+ */
+void memsys_freeze_core(MemorySystem *sys, unsigned int core_id);
+
 /**
  * Print the statistics of the memory system.
  * 
@@ -209,4 +448,32 @@ uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
  */
 void memsys_print_stats(MemorySystem *sys);
 
+/**
+ * List the caches of the memory system in the order memsys_print_stats()
+ * prints them.
+ *
+ * @param sys The memory system.
+ * @param caches The array to fill, with room for STATS_MAX_CACHES entries.
+ * @return The number of caches.
+ */
+unsigned int memsys_list_caches(MemorySystem *sys, MemsysCache *caches);
+
+/**
+ * Add the statistics of the memory system to a registry, under the names
+ * memsys_print_stats() prints them with. Call this after
+ * memsys_print_stats(), which settles the final statistics.
+ *
+ * @param sys The memory system to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void memsys_collect_stats(MemorySystem *sys, StatsRegistry *reg);
+
+/**
+ * Print the percentiles of the delays of each core's instruction fetches,
+ * loads and stores, and of DRAM reads and writes, if they are recorded.
+ *
+ * @param sys The memory system to print the statistics of.
+ */
+void memsys_print_hist_stats(MemorySystem *sys);
+
 #endif // __MEMSYS_H__
@@ -0,0 +1,313 @@
+// pagealloc.cpp
+// Defines the functions used to implement the page-frame allocators.
+
+#include "pagealloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The initial number of entries of the table of allocated pages. */
+#define PAGE_MAP_INITIAL_SIZE 4096
+
+/**
+ * How many frames are searched for one owned by each core before a policy
+ * is judged unusable with the configured geometry.
+ */
+#define PAGE_ALLOC_PROBE_FRAMES 65536
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The number of cores being simulated. */
+extern unsigned int NUM_CORES;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Check whether a frame may be given to a core under the policy of the
+ * allocator.
+ *
+ * Colors and banks are split into NUM_CORES contiguous ranges, one per core.
+ * Under bank partitioning every line of the frame must fall in a bank of the
+ * core, since the DRAM address mapping may spread a page over several banks.
+ *
+ * @param pa The allocator.
+ * @param pfn The physical frame number.
+ * @param core_id The CPU core ID.
+ * @return Whether the core owns the frame.
+ */
+static bool page_alloc_owns(PageAllocator *pa, uint64_t pfn,
+                            unsigned int core_id)
+{
+    if (pa->policy == PAGE_ALLOC_COLOR)
+    {
+        uint64_t color = pfn % pa->num_colors;
+        return (color * NUM_CORES) / pa->num_colors == core_id;
+    }
+
+    if (pa->policy == PAGE_ALLOC_BANK)
+    {
+        for (uint64_t i = 0; i < pa->lines_per_page; i++)
+        {
+            DRAMAddress loc;
+            dram_map(pa->dram, pfn * pa->lines_per_page + i, &loc);
+            uint64_t bank = loc.channel * pa->dram->banks_per_channel +
+                            loc.rank * pa->dram->banks_per_rank + loc.bank;
+            if ((bank * NUM_CORES) / pa->num_banks != core_id)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Check whether a frame is in use.
+ *
+ * @param pa The allocator.
+ * @param pfn The physical frame number.
+ * @return Whether the frame has been allocated.
+ */
+static bool page_alloc_used(PageAllocator *pa, uint64_t pfn)
+{
+    return (pa->used[pfn / 64] >> (pfn % 64)) & 1;
+}
+
+/**
+ * Allocate and initialize a page-frame allocator.
+ *
+ * @param policy How frames are chosen.
+ * @param num_frames The number of frames of physical memory.
+ * @param num_colors The number of page colors of the shared cache.
+ * @param dram The DRAM module holding the frames.
+ * @param lines_per_page The number of cache lines in a page.
+ * @return A pointer to the allocator, or NULL if the policy cannot be used.
+ */
+PageAllocator *page_alloc_new(PageAllocPolicy policy, uint64_t num_frames,
+                              uint64_t num_colors, DRAM *dram,
+                              uint64_t lines_per_page)
+{
+    if (policy == PAGE_ALLOC_COLOR && num_colors < NUM_CORES)
+    {
+        fprintf(stderr, "Error: the shared cache has %llu page colors, too "
+                        "few to give each core its own\n",
+                (unsigned long long)num_colors);
+        return NULL;
+    }
+
+    PageAllocator *pa = (PageAllocator *)calloc(1, sizeof(PageAllocator));
+    pa->policy = policy;
+    pa->num_frames = num_frames;
+    pa->used = (uint64_t *)calloc((num_frames + 63) / 64, sizeof(uint64_t));
+    pa->map_size = PAGE_MAP_INITIAL_SIZE;
+    pa->map = (PageMapping *)calloc(pa->map_size, sizeof(PageMapping));
+    pa->rng = 0x9e3779b97f4a7c15ULL;
+    pa->num_colors = num_colors;
+    pa->dram = dram;
+    pa->num_banks = (uint64_t)dram->num_channels * dram->banks_per_channel;
+    pa->lines_per_page = lines_per_page;
+
+    // Start each core at its first frame, which also checks that the DRAM
+    // address mapping lets whole pages stay within one core's banks.
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        uint64_t limit = num_frames < PAGE_ALLOC_PROBE_FRAMES
+                             ? num_frames
+                             : PAGE_ALLOC_PROBE_FRAMES;
+        while (pa->cursor[i] < limit && !page_alloc_owns(pa, pa->cursor[i], i))
+        {
+            pa->cursor[i]++;
+        }
+        if (pa->cursor[i] == limit)
+        {
+            fprintf(stderr, "Error: no frame lies in the DRAM banks of core "
+                            "%u; use an address mapping that keeps a page "
+                            "in fewer banks\n", i);
+            free(pa->map);
+            free(pa->used);
+            free(pa);
+            return NULL;
+        }
+    }
+
+    return pa;
+}
+
+/**
+ * Find the slot of a page in the table of allocated pages, which is either
+ * the slot holding it or the empty slot where it belongs.
+ *
+ * @param pa The allocator.
+ * @param vpn The virtual page number.
+ * @param asid The address space the page belongs to.
+ * @return The slot.
+ */
+static PageMapping *page_alloc_slot(PageAllocator *pa, uint64_t vpn,
+                                    unsigned int asid)
+{
+    uint64_t hash = (vpn ^ ((uint64_t)asid << 48)) * 0x9e3779b97f4a7c15ULL;
+    uint64_t index = (hash >> 20) & (pa->map_size - 1);
+    while (pa->map[index].valid &&
+           (pa->map[index].vpn != vpn || pa->map[index].asid != asid))
+    {
+        index = (index + 1) & (pa->map_size - 1);
+    }
+    return &pa->map[index];
+}
+
+/**
+ * Double the size of the table of allocated pages.
+ *
+ * @param pa The allocator.
+ */
+static void page_alloc_grow(PageAllocator *pa)
+{
+    PageMapping *old = pa->map;
+    uint64_t old_size = pa->map_size;
+
+    pa->map_size *= 2;
+    pa->map = (PageMapping *)calloc(pa->map_size, sizeof(PageMapping));
+    for (uint64_t i = 0; i < old_size; i++)
+    {
+        if (old[i].valid)
+        {
+            *page_alloc_slot(pa, old[i].vpn, old[i].asid) = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Choose a free frame for a core under the policy of the allocator.
+ *
+ * @param pa The allocator.
+ * @param core_id The CPU core ID.
+ * @return The physical frame number.
+ */
+static uint64_t page_alloc_frame(PageAllocator *pa, unsigned int core_id)
+{
+    uint64_t *cursor = &pa->cursor[core_id];
+    if (pa->policy == PAGE_ALLOC_SEQUENTIAL)
+    {
+        cursor = &pa->cursor[0];
+    }
+    else if (pa->policy == PAGE_ALLOC_RANDOM)
+    {
+        // Probe linearly from a random frame (xorshift64).
+        pa->rng ^= pa->rng << 13;
+        pa->rng ^= pa->rng >> 7;
+        pa->rng ^= pa->rng << 17;
+        pa->cursor[core_id] = pa->rng % pa->num_frames;
+    }
+
+    for (uint64_t n = 0; n < pa->num_frames; n++)
+    {
+        uint64_t pfn = *cursor;
+        *cursor = (*cursor + 1) % pa->num_frames;
+        if (!page_alloc_used(pa, pfn) && page_alloc_owns(pa, pfn, core_id))
+        {
+            return pfn;
+        }
+    }
+
+    fprintf(stderr, "Error: out of physical memory for core %u\n", core_id);
+    exit(1);
+}
+
+/**
+ * Find the frame backing a virtual page, allocating one on the first touch.
+ *
+ * @param pa The allocator to use.
+ * @param vpn The virtual page number.
+ * @param asid The address space the page belongs to.
+ * @param core_id The CPU core ID that touched the page, which the policy
+ *                chooses the frame for.
+ * @return The physical frame number.
+ */
+uint64_t page_alloc_translate(PageAllocator *pa, uint64_t vpn,
+                              unsigned int asid, unsigned int core_id)
+{
+    PageMapping *slot = page_alloc_slot(pa, vpn, asid);
+    if (slot->valid)
+    {
+        return slot->pfn;
+    }
+
+    uint64_t pfn = page_alloc_frame(pa, core_id);
+    pa->used[pfn / 64] |= 1ULL << (pfn % 64);
+    pa->stat_frames[core_id]++;
+
+    slot->valid = true;
+    slot->asid = asid;
+    slot->vpn = vpn;
+    slot->pfn = pfn;
+    if (++pa->map_count * 2 > pa->map_size)
+    {
+        page_alloc_grow(pa);
+    }
+
+#ifdef DEBUG
+    printf("\tAllocated frame %lu to page %lu of address space %u on core "
+           "%u\n", pfn, vpn, asid, core_id);
+#endif
+
+    return pfn;
+}
+
+/**
+ * Print the statistics of the given allocator.
+ *
+ * @param pa The allocator to print the statistics of.
+ */
+void page_alloc_print_stats(PageAllocator *pa)
+{
+    printf("\n");
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        printf("PAGE_ALLOC_FRAMES_%u    \t\t : %10llu\n", i,
+               pa->stat_frames[i]);
+    }
+    if (pa->policy == PAGE_ALLOC_COLOR)
+    {
+        printf("PAGE_ALLOC_COLORS      \t\t : %10llu\n",
+               (unsigned long long)pa->num_colors);
+    }
+    if (pa->policy == PAGE_ALLOC_BANK)
+    {
+        printf("PAGE_ALLOC_BANKS       \t\t : %10llu\n",
+               (unsigned long long)pa->num_banks);
+    }
+}
+
+/**
+ * Add the statistics of the given allocator to a registry, under the names
+ * page_alloc_print_stats() prints them with.
+ *
+ * @param pa The allocator to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void page_alloc_collect_stats(PageAllocator *pa, StatsRegistry *reg)
+{
+    for (unsigned int i = 0; i < NUM_CORES; i++)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "FRAMES_%u", i);
+        stats_add_count(reg, "PAGE_ALLOC", name, pa->stat_frames[i]);
+    }
+    if (pa->policy == PAGE_ALLOC_COLOR)
+    {
+        stats_add_count(reg, "PAGE_ALLOC", "COLORS", pa->num_colors);
+    }
+    if (pa->policy == PAGE_ALLOC_BANK)
+    {
+        stats_add_count(reg, "PAGE_ALLOC", "BANKS", pa->num_banks);
+    }
+}
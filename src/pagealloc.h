@@ -0,0 +1,132 @@
+// pagealloc.h
+// Declares the page-frame allocators, which decide the physical frame backing
+// each virtual page the first time a core touches it.
+//
+// Because the frame number supplies the upper bits of every physical address,
+// the allocator decides which shared cache sets and which DRAM banks a core's
+// pages can use. Page coloring and bank partitioning exploit this to isolate
+// cores from each other in software: each core is only given frames whose
+// cache sets (colors) or DRAM banks belong to it.
+
+#ifndef __PAGEALLOC_H__
+#define __PAGEALLOC_H__
+
+#include "types.h"
+#include "dram.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** How physical frames are chosen for virtual pages. */
+typedef enum PageAllocPolicyEnum
+{
+    PAGE_ALLOC_FIXED = 0,      // The fixed per-core mapping of the lab.
+    PAGE_ALLOC_SEQUENTIAL = 1, // The next free frame, in first-touch order.
+    PAGE_ALLOC_RANDOM = 2,     // A random free frame.
+    PAGE_ALLOC_COLOR = 3,      // A free frame of a cache color of the core.
+    PAGE_ALLOC_BANK = 4,       // A free frame in DRAM banks of the core.
+} PageAllocPolicy;
+
+/** The frame allocated to one virtual page of one address space. */
+typedef struct PageMapping
+{
+    bool valid;
+    unsigned int asid;
+    uint64_t vpn;
+    uint64_t pfn;
+} PageMapping;
+
+/** A page-frame allocator for all cores. */
+typedef struct PageAllocator
+{
+    PageAllocPolicy policy;
+
+    /** The number of frames of physical memory, and which are in use. */
+    uint64_t num_frames;
+    uint64_t *used;
+
+    /**
+     * The open-addressed table of allocated pages, its size (a power of 2)
+     * and the number of entries in use.
+     */
+    PageMapping *map;
+    uint64_t map_size;
+    uint64_t map_count;
+
+    /**
+     * Where each core continues its search for a free frame. The sequential
+     * policy shares the cursor of core 0 between all cores.
+     */
+    uint64_t cursor[MAX_CORES];
+
+    /** The state of the random number generator of the random policy. */
+    uint64_t rng;
+
+    /** The number of page colors of the shared cache. */
+    uint64_t num_colors;
+
+    /** The DRAM module whose banks are partitioned, and its bank count. */
+    DRAM *dram;
+    uint64_t num_banks;
+    uint64_t lines_per_page;
+
+    /** The number of frames allocated to each core. */
+    unsigned long long stat_frames[MAX_CORES];
+} PageAllocator;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a page-frame allocator.
+ *
+ * Print a message to stderr if the policy cannot give every core frames of
+ * its own, e.g. when there are fewer colors than cores or when the DRAM
+ * address mapping spreads each page over the banks of several cores.
+ *
+ * @param policy How frames are chosen.
+ * @param num_frames The number of frames of physical memory.
+ * @param num_colors The number of page colors of the shared cache, i.e. its
+ *                   size divided by its associativity and the page size.
+ * @param dram The DRAM module holding the frames.
+ * @param lines_per_page The number of cache lines in a page.
+ * @return A pointer to the allocator, or NULL if the policy cannot be used.
+ */
+PageAllocator *page_alloc_new(PageAllocPolicy policy, uint64_t num_frames,
+                              uint64_t num_colors, DRAM *dram,
+                              uint64_t lines_per_page);
+
+/**
+ * Find the frame backing a virtual page, allocating one on the first touch.
+ *
+ * Exit with a message on stderr if physical memory is exhausted.
+ *
+ * @param pa The allocator to use.
+ * @param vpn The virtual page number.
+ * @param asid The address space the page belongs to.
+ * @param core_id The CPU core ID that touched the page, which the policy
+ *                chooses the frame for.
+ * @return The physical frame number.
+ */
+uint64_t page_alloc_translate(PageAllocator *pa, uint64_t vpn,
+                              unsigned int asid, unsigned int core_id);
+
+/**
+ * Print the statistics of the given allocator.
+ *
+ * @param pa The allocator to print the statistics of.
+ */
+void page_alloc_print_stats(PageAllocator *pa);
+
+/**
+ * Add the statistics of the given allocator to a registry, under the names
+ * page_alloc_print_stats() prints them with.
+ *
+ * @param pa The allocator to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void page_alloc_collect_stats(PageAllocator *pa, StatsRegistry *reg);
+
+#endif // __PAGEALLOC_H__
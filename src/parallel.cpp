@@ -0,0 +1,184 @@
+// parallel.cpp
+// Defines the functions used to implement the parallel simulation engine.
+
+#include "parallel.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * How many times a thread polls the barrier before yielding the processor,
+ * so that waiting stays cheap when there are fewer processors than threads.
+ */
+#define PARALLEL_SPIN_LIMIT 256
+
+/**
+ * The most requests a core can make of the shared levels in one cycle: a
+ * fetch miss, and a data miss with the writeback of a dirty victim.
+ */
+#define PARALLEL_REQUESTS_PER_CYCLE 3
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number of this thread. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Wait until every thread has reached the barrier.
+ *
+ * @param b The barrier.
+ * @param sense The sense of the calling thread, which is flipped for the
+ *              next phase.
+ */
+static void parallel_barrier_wait(ParallelBarrier *b, bool *sense)
+{
+    *sense = !*sense;
+
+    if (__atomic_add_fetch(&b->waiting, 1, __ATOMIC_ACQ_REL) == b->count)
+    {
+        __atomic_store_n(&b->waiting, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->sense, *sense, __ATOMIC_RELEASE);
+        return;
+    }
+
+    for (unsigned int spins = 0;
+         __atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) != *sense; spins++)
+    {
+        if (spins >= PARALLEL_SPIN_LIMIT)
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Run the cycles of each quantum for one core until the engine stops.
+ *
+ * @param arg The worker of the core.
+ * @return NULL.
+ */
+static void *parallel_worker(void *arg)
+{
+    ParallelWorker *w = (ParallelWorker *)arg;
+    ParallelEngine *pe = w->engine;
+
+    while (true)
+    {
+        parallel_barrier_wait(&pe->barrier, &w->sense);
+        if (pe->stop)
+        {
+            break;
+        }
+
+        uint64_t end = pe->quantum_start + pe->quantum;
+        for (uint64_t cycle = pe->quantum_start; cycle < end && !w->core->done;
+             cycle++)
+        {
+            current_cycle = cycle;
+            core_cycle(w->core);
+        }
+
+        parallel_barrier_wait(&pe->barrier, &w->sense);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start a thread for each core, and defer the shared levels of the memory
+ * system to the main thread.
+ *
+ * @param cores The cores to simulate.
+ * @param num_cores The number of cores.
+ * @param sys The memory system shared by the cores.
+ * @param quantum The number of cycles the cores advance between barriers.
+ * @return A pointer to the engine.
+ */
+ParallelEngine *parallel_new(Core **cores, unsigned int num_cores,
+                             MemorySystem *sys, uint64_t quantum)
+{
+    ParallelEngine *pe = (ParallelEngine *)calloc(1, sizeof(ParallelEngine));
+    pe->sys = sys;
+    pe->num_cores = num_cores;
+    pe->quantum = quantum;
+    pe->barrier.count = num_cores + 1;
+
+    memsys_defer_shared(sys, quantum * PARALLEL_REQUESTS_PER_CYCLE);
+
+    for (unsigned int i = 0; i < num_cores; i++)
+    {
+        ParallelWorker *w = &pe->workers[i];
+        w->engine = pe;
+        w->core = cores[i];
+        if (pthread_create(&w->thread, NULL, parallel_worker, w) != 0)
+        {
+            fprintf(stderr, "Error: could not start the thread of core %u\n",
+                    i);
+            exit(1);
+        }
+    }
+
+    return pe;
+}
+
+/**
+ * Simulate one quantum of cycles starting at current_cycle, then perform
+ * the requests the cores made of the shared levels.
+ *
+ * @param pe The engine to run.
+ * @param all_done Set to whether every core has finished its trace.
+ * @return The cycle after the last one simulated.
+ */
+uint64_t parallel_run_quantum(ParallelEngine *pe, bool *all_done)
+{
+    pe->quantum_start = current_cycle;
+
+    // The workers run the quantum between these two barriers.
+    parallel_barrier_wait(&pe->barrier, &pe->sense);
+    parallel_barrier_wait(&pe->barrier, &pe->sense);
+
+    uint64_t stall[MAX_CORES] = {0};
+    memsys_resolve_shared(pe->sys, stall);
+
+    *all_done = true;
+    uint64_t last_done = 0;
+    for (unsigned int i = 0; i < pe->num_cores; i++)
+    {
+        Core *core = pe->workers[i].core;
+        core->snooze_end_cycle += stall[i];
+        *all_done = *all_done && core->done;
+        if (core->done && core->done_cycle_count > last_done)
+        {
+            last_done = core->done_cycle_count;
+        }
+    }
+
+    return *all_done ? last_done + 1 : pe->quantum_start + pe->quantum;
+}
+
+/**
+ * Stop and join the threads of the engine, and free it.
+ *
+ * @param pe The engine to free.
+ */
+void parallel_free(ParallelEngine *pe)
+{
+    pe->stop = true;
+    parallel_barrier_wait(&pe->barrier, &pe->sense);
+
+    for (unsigned int i = 0; i < pe->num_cores; i++)
+    {
+        pthread_join(pe->workers[i].thread, NULL);
+    }
+    free(pe);
+}
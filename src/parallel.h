@@ -0,0 +1,107 @@
+// parallel.h
+// Declares the parallel simulation engine, which runs each core and its
+// private L1 caches on a thread of its own.
+//
+// The cores advance together one quantum of cycles at a time. Within a
+// quantum they only touch private state, and queue their requests to the
+// shared L2 cache and DRAM (see memsys_defer_shared()), assuming each L1 miss
+// hits the L2. At the barrier that ends the quantum, the main thread performs
+// the queued requests in cycle order and stalls each core by however much
+// longer its requests took.
+//
+// With a quantum of one cycle (lockstep), this reproduces the serial
+// simulation exactly. Longer quanta synchronize less often, at the cost of
+// charging part of a miss's latency after instructions that would have
+// waited for it.
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include "types.h"
+#include "core.h"
+#include "memsys.h"
+#include <pthread.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A sense-reversing barrier that spins before yielding the processor. */
+typedef struct ParallelBarrier
+{
+    /** The number of threads that meet at the barrier. */
+    unsigned int count;
+
+    /** The number of threads waiting, and the sense of the current phase. */
+    unsigned int waiting;
+    bool sense;
+} ParallelBarrier;
+
+/** The thread simulating one core. */
+typedef struct ParallelWorker
+{
+    struct ParallelEngine *engine;
+    Core *core;
+    pthread_t thread;
+
+    /** The sense of the barrier phase this thread is in. */
+    bool sense;
+} ParallelWorker;
+
+/** The parallel engine for all cores. */
+typedef struct ParallelEngine
+{
+    MemorySystem *sys;
+    unsigned int num_cores;
+    ParallelWorker workers[MAX_CORES];
+
+    /** The number of cycles the cores advance between barriers. */
+    uint64_t quantum;
+
+    /** The barrier met by the workers and the main thread. */
+    ParallelBarrier barrier;
+    bool sense;
+
+    /** The first cycle of the quantum being run. */
+    uint64_t quantum_start;
+
+    /** Whether the workers should exit at the next barrier. */
+    bool stop;
+} ParallelEngine;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Start a thread for each core, and defer the shared levels of the memory
+ * system to the main thread.
+ *
+ * @param cores The cores to simulate.
+ * @param num_cores The number of cores.
+ * @param sys The memory system shared by the cores.
+ * @param quantum The number of cycles the cores advance between barriers.
+ * @return A pointer to the engine.
+ */
+ParallelEngine *parallel_new(Core **cores, unsigned int num_cores,
+                             MemorySystem *sys, uint64_t quantum);
+
+/**
+ * Simulate one quantum of cycles starting at current_cycle, then perform
+ * the requests the cores made of the shared levels.
+ *
+ * @param pe The engine to run.
+ * @param all_done Set to whether every core has finished its trace.
+ * @return The cycle after the last one simulated, which is the cycle after
+ *         the last core finished if all have.
+ */
+uint64_t parallel_run_quantum(ParallelEngine *pe, bool *all_done);
+
+/**
+ * Stop and join the threads of the engine, and free it.
+ *
+ * @param pe The engine to free.
+ */
+void parallel_free(ParallelEngine *pe);
+
+#endif // __PARALLEL_H__
@@ -0,0 +1,209 @@
+// pcprof.cpp
+// Defines the functions used to implement the per-PC profiler.
+
+#include "pcprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize an empty profiler.
+ *
+ * @return A pointer to the profiler.
+ */
+PCProfiler *pcprof_new()
+{
+    PCProfiler *p = (PCProfiler *)calloc(1, sizeof(PCProfiler));
+    p->num_slots = PCPROF_INITIAL_SLOTS;
+    p->slots = (PCProfEntry *)calloc(p->num_slots, sizeof(PCProfEntry));
+    return p;
+}
+
+/**
+ * Find the slot of an instruction, or the empty slot where it belongs.
+ *
+ * @param slots The slots of the hash table.
+ * @param num_slots The number of slots (a power of 2).
+ * @param pc The address of the instruction.
+ * @param asid The address space the instruction runs in.
+ * @param type The type of memory access.
+ * @return The slot.
+ */
+static PCProfEntry *pcprof_find(PCProfEntry *slots, uint64_t num_slots,
+                                uint64_t pc, unsigned int asid,
+                                AccessType type)
+{
+    uint64_t key = pc ^ ((uint64_t)asid << 48) ^ ((uint64_t)type << 60);
+    uint64_t index = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+    for (;; index++)
+    {
+        PCProfEntry *e = &slots[index & (num_slots - 1)];
+        if (!e->valid ||
+            (e->pc == pc && e->asid == asid && e->type == type))
+        {
+            return e;
+        }
+    }
+}
+
+/**
+ * Double the slots of the hash table, moving every entry.
+ *
+ * @param p The profiler.
+ */
+static void pcprof_grow(PCProfiler *p)
+{
+    uint64_t num_slots = p->num_slots * 2;
+    PCProfEntry *slots = (PCProfEntry *)calloc(num_slots,
+                                               sizeof(PCProfEntry));
+    for (uint64_t i = 0; i < p->num_slots; i++)
+    {
+        PCProfEntry *e = &p->slots[i];
+        if (e->valid)
+        {
+            *pcprof_find(slots, num_slots, e->pc, e->asid, e->type) = *e;
+        }
+    }
+
+    free(p->slots);
+    p->slots = slots;
+    p->num_slots = num_slots;
+}
+
+/**
+ * Count one access against the instruction that made it.
+ *
+ * @param p The profiler.
+ * @param pc The address of the instruction.
+ * @param asid The address space the instruction runs in.
+ * @param type The type of memory access.
+ * @param l1_miss The L1 misses of the access (0 or 1).
+ * @param l2_miss The L2 misses of the access, including page walk reads.
+ * @param dram_read The DRAM reads of the access.
+ * @param delay The delay in cycles of the access.
+ * @param stall The part of the delay beyond an L1 hit.
+ */
+void pcprof_record(PCProfiler *p, uint64_t pc, unsigned int asid,
+                   AccessType type, uint64_t l1_miss, uint64_t l2_miss,
+                   uint64_t dram_read, uint64_t delay, uint64_t stall)
+{
+    PCProfEntry *e = pcprof_find(p->slots, p->num_slots, pc, asid, type);
+    if (!e->valid)
+    {
+        // Keep the table at most half full so that probes stay short.
+        if (2 * (p->num_entries + 1) > p->num_slots)
+        {
+            pcprof_grow(p);
+            e = pcprof_find(p->slots, p->num_slots, pc, asid, type);
+        }
+        e->valid = true;
+        e->pc = pc;
+        e->asid = asid;
+        e->type = type;
+        p->num_entries++;
+    }
+
+    e->stat_access++;
+    e->stat_l1_miss += l1_miss;
+    e->stat_l2_miss += l2_miss;
+    e->stat_dram_read += dram_read;
+    e->stat_delay += delay;
+    e->stat_stall += stall;
+    p->stat_stall += stall;
+}
+
+/**
+ * Order entries by decreasing stall cycles, then by decreasing L1 misses,
+ * then by address, for qsort().
+ *
+ * @param a A pointer to the first entry pointer.
+ * @param b A pointer to the second entry pointer.
+ * @return Negative if the first entry ranks higher, positive if lower.
+ */
+static int pcprof_compare(const void *a, const void *b)
+{
+    const PCProfEntry *x = *(const PCProfEntry *const *)a;
+    const PCProfEntry *y = *(const PCProfEntry *const *)b;
+    if (x->stat_stall != y->stat_stall)
+    {
+        return (x->stat_stall > y->stat_stall) ? -1 : 1;
+    }
+    if (x->stat_l1_miss != y->stat_l1_miss)
+    {
+        return (x->stat_l1_miss > y->stat_l1_miss) ? -1 : 1;
+    }
+    if (x->asid != y->asid)
+    {
+        return (x->asid < y->asid) ? -1 : 1;
+    }
+    if (x->pc != y->pc)
+    {
+        return (x->pc < y->pc) ? -1 : 1;
+    }
+    return (int)x->type - (int)y->type;
+}
+
+/**
+ * Print the PCs with the most stall cycles, with their miss rates, average
+ * latency and share of all stall cycles.
+ *
+ * @param p The profiler to print the statistics of.
+ * @param top_n The number of PCs to print.
+ */
+void pcprof_print_stats(PCProfiler *p, unsigned int top_n)
+{
+    static const char *type_names[] = {"IFETCH", "LOAD", "STORE"};
+
+    PCProfEntry **ranked = (PCProfEntry **)malloc(
+        (p->num_entries + 1) * sizeof(PCProfEntry *));
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < p->num_slots; i++)
+    {
+        if (p->slots[i].valid)
+        {
+            ranked[count++] = &p->slots[i];
+        }
+    }
+    qsort(ranked, count, sizeof(PCProfEntry *), pcprof_compare);
+
+    printf("\n");
+    printf("PCPROF_PCS           \t\t : %10llu\n",
+           (unsigned long long)p->num_entries);
+    printf("PCPROF_STALL_CYCLES  \t\t : %10llu\n", p->stat_stall);
+    printf("\n");
+    printf("%4s %4s %-6s %18s %10s %8s %8s %10s %9s %7s\n", "RANK", "ASID",
+           "TYPE", "PC", "ACCESS", "L1_MISS%", "L2_MISS%", "DRAM_READ",
+           "AVG_LAT", "STALL%");
+
+    for (uint64_t i = 0; i < count && i < top_n; i++)
+    {
+        PCProfEntry *e = ranked[i];
+        double l1_miss_percent = 100.0 * (double)(e->stat_l1_miss) /
+                                 (double)(e->stat_access);
+        double l2_miss_percent = 0.0;
+        double stall_percent = 0.0;
+        if (e->stat_l1_miss)
+        {
+            l2_miss_percent = 100.0 * (double)(e->stat_l2_miss) /
+                              (double)(e->stat_l1_miss);
+        }
+        if (p->stat_stall)
+        {
+            stall_percent = 100.0 * (double)(e->stat_stall) /
+                            (double)(p->stat_stall);
+        }
+
+        printf("%4llu %4u %-6s 0x%016llx %10llu %8.3f %8.3f %10llu %9.3f "
+               "%7.3f\n", (unsigned long long)(i + 1), e->asid,
+               type_names[e->type], (unsigned long long)e->pc,
+               e->stat_access, l1_miss_percent, l2_miss_percent,
+               e->stat_dram_read,
+               (double)(e->stat_delay) / (double)(e->stat_access),
+               stall_percent);
+    }
+
+    free(ranked);
+}
@@ -0,0 +1,96 @@
+// pcprof.h
+// Declares the per-PC profiler, which attributes the misses and stall cycles
+// of the memory system to the instructions that cause them.
+//
+// Every access is counted against its (address space, access type, PC) in an
+// open-addressing hash table that grows as new PCs appear. The report ranks
+// the PCs by the cycles their accesses took beyond an L1 hit, so that the
+// loads and stores worth prefetching for or laying out differently come
+// first.
+
+#ifndef __PCPROF_H__
+#define __PCPROF_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The initial number of slots of the hash table (a power of 2). */
+#define PCPROF_INITIAL_SLOTS 4096
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The accesses of one instruction of one address space. */
+typedef struct PCProfEntry
+{
+    bool valid;
+
+    uint64_t pc;
+    unsigned int asid;
+    AccessType type;
+
+    unsigned long long stat_access;
+    unsigned long long stat_l1_miss;
+    unsigned long long stat_l2_miss;
+    unsigned long long stat_dram_read;
+
+    /** The total delay of the accesses, and the part beyond an L1 hit. */
+    unsigned long long stat_delay;
+    unsigned long long stat_stall;
+} PCProfEntry;
+
+/** A per-PC profiler. */
+typedef struct PCProfiler
+{
+    PCProfEntry *slots;
+
+    /** The number of slots (a power of 2), and how many are used. */
+    uint64_t num_slots;
+    uint64_t num_entries;
+
+    /** The stall cycles of all accesses, for each PC's share. */
+    unsigned long long stat_stall;
+} PCProfiler;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize an empty profiler.
+ *
+ * @return A pointer to the profiler.
+ */
+PCProfiler *pcprof_new();
+
+/**
+ * Count one access against the instruction that made it.
+ *
+ * @param p The profiler.
+ * @param pc The address of the instruction.
+ * @param asid The address space the instruction runs in.
+ * @param type The type of memory access.
+ * @param l1_miss The L1 misses of the access (0 or 1).
+ * @param l2_miss The L2 misses of the access, including page walk reads.
+ * @param dram_read The DRAM reads of the access.
+ * @param delay The delay in cycles of the access.
+ * @param stall The part of the delay beyond an L1 hit.
+ */
+void pcprof_record(PCProfiler *p, uint64_t pc, unsigned int asid,
+                   AccessType type, uint64_t l1_miss, uint64_t l2_miss,
+                   uint64_t dram_read, uint64_t delay, uint64_t stall);
+
+/**
+ * Print the PCs with the most stall cycles, with their miss rates, average
+ * latency and share of all stall cycles.
+ *
+ * @param p The profiler to print the statistics of.
+ * @param top_n The number of PCs to print.
+ */
+void pcprof_print_stats(PCProfiler *p, unsigned int top_n);
+
+#endif // __PCPROF_H__
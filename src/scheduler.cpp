@@ -0,0 +1,300 @@
+// scheduler.cpp
+// Defines the functions used to implement the OS scheduler.
+
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number. */
+extern thread_local uint64_t current_cycle;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a scheduler, opening every trace.
+ *
+ * @param sys The memory system shared by the cores.
+ * @param cores The core slots of the simulation, which are set to the
+ *              running tasks.
+ * @param num_cores The number of cores.
+ * @param trace_filenames The traces to run.
+ * @param num_tasks The number of traces, at least num_cores.
+ * @param quantum The cycles a task runs before it may be preempted.
+ * @param switch_cost The cycles a core is stalled by a context switch.
+ * @param flush_caches Whether a context switch flushes the core's L1
+ *                     caches.
+ * @param flush_tlbs Whether a context switch flushes the core's TLBs.
+ * @return A pointer to the scheduler, or NULL if a trace cannot be opened.
+ */
+Scheduler *scheduler_new(MemorySystem *sys, Core **cores,
+                         unsigned int num_cores,
+                         const char **trace_filenames, unsigned int num_tasks,
+                         uint64_t quantum, uint64_t switch_cost,
+                         bool flush_caches, bool flush_tlbs)
+{
+    Scheduler *s = (Scheduler *)calloc(1, sizeof(Scheduler));
+    s->sys = sys;
+    s->cores = cores;
+    s->num_cores = num_cores;
+    s->num_tasks = num_tasks;
+    s->quantum = quantum;
+    s->switch_cost = switch_cost;
+    s->flush_caches = flush_caches;
+    s->flush_tlbs = flush_tlbs;
+
+    for (unsigned int i = 0; i < num_tasks; i++)
+    {
+        SchedTask *task = &s->tasks[i];
+        unsigned int core_id = (i < num_cores) ? i : 0;
+        task->core = core_new(sys, trace_filenames[i], core_id);
+        if (task->core == NULL)
+        {
+            fprintf(stderr, "Error: could not open trace %s\n",
+                    trace_filenames[i]);
+            return NULL;
+        }
+        task->asid = i;
+
+        if (i < num_cores)
+        {
+            cores[i] = task->core;
+            s->running[i] = i;
+        }
+        else
+        {
+            s->queue[s->queue_count++] = i;
+        }
+    }
+
+    return s;
+}
+
+/**
+ * End the time slice of the task running on a core, charging the slice to
+ * the task and the core.
+ *
+ * @param s The scheduler.
+ * @param core_id The CPU core ID.
+ * @return The task whose slice ended.
+ */
+static SchedTask *scheduler_end_slice(Scheduler *s, unsigned int core_id)
+{
+    SchedTask *task = &s->tasks[s->running[core_id]];
+    uint64_t cycles = current_cycle + 1 - task->slice_start;
+    unsigned long long inst = task->core->inst_count - task->slice_inst;
+
+    task->stat_run_cycles += cycles;
+    s->stat_busy_cycles[core_id] += cycles;
+    s->stat_inst[core_id] += inst;
+    s->running[core_id] = -1;
+    return task;
+}
+
+/**
+ * Switch a core to the task at the head of the run queue. The core starts
+ * running it once the switch cost has passed.
+ *
+ * @param s The scheduler.
+ * @param core_id The CPU core ID.
+ */
+static void scheduler_switch_in(Scheduler *s, unsigned int core_id)
+{
+    unsigned int index = s->queue[s->queue_head];
+    s->queue_head = (s->queue_head + 1) % SCHEDULER_MAX_TASKS;
+    s->queue_count--;
+
+    SchedTask *task = &s->tasks[index];
+    s->stat_flush_writebacks[core_id] += memsys_switch(
+        s->sys, core_id, task->asid, s->flush_caches, s->flush_tlbs);
+
+    Core *core = task->core;
+    core->core_id = core_id;
+    core->snooze_end_cycle = current_cycle + s->switch_cost +
+                             task->stall_left;
+    task->stall_left = 0;
+    task->slice_start = current_cycle + 1;
+    task->slice_inst = core->inst_count;
+    task->stat_switches++;
+
+    s->cores[core_id] = core;
+    s->running[core_id] = index;
+    s->stat_switches[core_id]++;
+
+#ifdef DEBUG
+    printf("\tCore %u switched to task %u\n", core_id, index);
+#endif
+}
+
+/**
+ * Retire a finished task, or preempt one whose quantum has expired, after a
+ * core has simulated the current cycle, and switch the core to the next
+ * waiting task.
+ *
+ * @param s The scheduler.
+ * @param core_id The CPU core ID.
+ */
+void scheduler_tick(Scheduler *s, unsigned int core_id)
+{
+    if (s->running[core_id] >= 0)
+    {
+        SchedTask *task = &s->tasks[s->running[core_id]];
+        if (task->core->done)
+        {
+            scheduler_end_slice(s, core_id);
+        }
+        else if (s->queue_count == 0 ||
+                 current_cycle + 1 - task->slice_start < s->quantum)
+        {
+            return;
+        }
+        else
+        {
+            // Preempt the task, which resumes any wait for memory when it
+            // runs again.
+            scheduler_end_slice(s, core_id);
+            if (task->core->snooze_end_cycle > current_cycle)
+            {
+                task->stall_left = task->core->snooze_end_cycle -
+                                   current_cycle;
+            }
+            unsigned int tail = (s->queue_head + s->queue_count) %
+                                SCHEDULER_MAX_TASKS;
+            s->queue[tail] = task - s->tasks;
+            s->queue_count++;
+        }
+    }
+
+    if (s->queue_count > 0)
+    {
+        scheduler_switch_in(s, core_id);
+    }
+}
+
+/**
+ * Print the statistics of the scheduler, its cores and its tasks, and close
+ * the traces.
+ *
+ * @param s The scheduler to print the statistics of.
+ */
+void scheduler_print_stats(Scheduler *s)
+{
+    char label[32];
+
+    printf("\n");
+    for (unsigned int i = 0; i < s->num_cores; i++)
+    {
+        double ipc = 0.0;
+        if (s->stat_busy_cycles[i])
+        {
+            ipc = (double)(s->stat_inst[i]) /
+                  (double)(s->stat_busy_cycles[i]);
+        }
+
+        snprintf(label, sizeof(label), "CORE_%u_INST", i);
+        printf("%-20s\t\t : %10llu\n", label, s->stat_inst[i]);
+        snprintf(label, sizeof(label), "CORE_%u_BUSY_CYCLES", i);
+        printf("%-20s\t\t : %10llu\n", label, s->stat_busy_cycles[i]);
+        snprintf(label, sizeof(label), "CORE_%u_IPC", i);
+        printf("%-20s\t\t : %10.3f\n", label, ipc);
+        snprintf(label, sizeof(label), "CORE_%u_SWITCHES", i);
+        printf("%-20s\t\t : %10llu\n", label, s->stat_switches[i]);
+        if (s->flush_caches)
+        {
+            snprintf(label, sizeof(label), "CORE_%u_FLUSH_WB", i);
+            printf("%-20s\t\t : %10llu\n", label,
+                   s->stat_flush_writebacks[i]);
+        }
+    }
+
+    for (unsigned int i = 0; i < s->num_tasks; i++)
+    {
+        SchedTask *task = &s->tasks[i];
+        double ipc = 0.0;
+        double slowdown = 0.0;
+        if (task->stat_run_cycles)
+        {
+            ipc = (double)(task->core->done_inst_count) /
+                  (double)(task->stat_run_cycles);
+            slowdown = (double)(task->core->done_cycle_count + 1) /
+                       (double)(task->stat_run_cycles);
+        }
+
+        printf("\n");
+        snprintf(label, sizeof(label), "TASK_%u_INST", i);
+        printf("%-20s\t\t : %10llu\n", label, task->core->done_inst_count);
+        snprintf(label, sizeof(label), "TASK_%u_RUN_CYCLES", i);
+        printf("%-20s\t\t : %10llu\n", label, task->stat_run_cycles);
+        snprintf(label, sizeof(label), "TASK_%u_FINISH", i);
+        printf("%-20s\t\t : %10llu\n", label,
+               task->core->done_cycle_count);
+        snprintf(label, sizeof(label), "TASK_%u_SWITCHES", i);
+        printf("%-20s\t\t : %10llu\n", label, task->stat_switches);
+        snprintf(label, sizeof(label), "TASK_%u_IPC", i);
+        printf("%-20s\t\t : %10.3f\n", label, ipc);
+        snprintf(label, sizeof(label), "TASK_%u_SLOWDOWN", i);
+        printf("%-20s\t\t : %10.3f\n", label, slowdown);
+
+        core_close_trace(task->core);
+    }
+}
+
+/**
+ * Add the statistics of the scheduler, its cores and its tasks to a
+ * registry, under the names scheduler_print_stats() prints them with.
+ *
+ * @param s The scheduler to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void scheduler_collect_stats(Scheduler *s, StatsRegistry *reg)
+{
+    char prefix[16];
+
+    for (unsigned int i = 0; i < s->num_cores; i++)
+    {
+        double ipc = 0.0;
+        if (s->stat_busy_cycles[i])
+        {
+            ipc = (double)(s->stat_inst[i]) /
+                  (double)(s->stat_busy_cycles[i]);
+        }
+
+        snprintf(prefix, sizeof(prefix), "CORE_%u", i);
+        stats_add_count(reg, prefix, "INST", s->stat_inst[i]);
+        stats_add_count(reg, prefix, "BUSY_CYCLES", s->stat_busy_cycles[i]);
+        stats_add_real(reg, prefix, "IPC", ipc);
+        stats_add_count(reg, prefix, "SWITCHES", s->stat_switches[i]);
+        if (s->flush_caches)
+        {
+            stats_add_count(reg, prefix, "FLUSH_WB",
+                            s->stat_flush_writebacks[i]);
+        }
+    }
+
+    for (unsigned int i = 0; i < s->num_tasks; i++)
+    {
+        SchedTask *task = &s->tasks[i];
+        double ipc = 0.0;
+        double slowdown = 0.0;
+        if (task->stat_run_cycles)
+        {
+            ipc = (double)(task->core->done_inst_count) /
+                  (double)(task->stat_run_cycles);
+            slowdown = (double)(task->core->done_cycle_count + 1) /
+                       (double)(task->stat_run_cycles);
+        }
+
+        snprintf(prefix, sizeof(prefix), "TASK_%u", i);
+        stats_add_count(reg, prefix, "INST", task->core->done_inst_count);
+        stats_add_count(reg, prefix, "RUN_CYCLES", task->stat_run_cycles);
+        stats_add_count(reg, prefix, "FINISH", task->core->done_cycle_count);
+        stats_add_count(reg, prefix, "SWITCHES", task->stat_switches);
+        stats_add_real(reg, prefix, "IPC", ipc);
+        stats_add_real(reg, prefix, "SLOWDOWN", slowdown);
+    }
+}
@@ -0,0 +1,166 @@
+// scheduler.h
+// Declares the OS scheduler, which time-slices a pool of traces across the
+// cores of a multiprogrammed system.
+//
+// Each trace runs as a task in an address space of its own. A core runs its
+// task until the task finishes or its quantum expires while another task
+// waits, and then switches to the task at the head of a round-robin run
+// queue. A switch stalls the core for the context-switch cost, and may flush
+// the core's L1 caches and TLBs (see memsys_switch()), so that the pollution
+// left by one task is paid for by the next.
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "types.h"
+#include "core.h"
+#include "memsys.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The maximum number of traces that can be scheduled. */
+#define SCHEDULER_MAX_TASKS 64
+
+/** The number of cores the traces are scheduled on unless -cores is given. */
+#define SCHEDULER_DEFAULT_CORES 2
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** One trace being scheduled. */
+typedef struct SchedTask
+{
+    /**
+     * The trace and its progress. Its core ID is that of the core it last
+     * ran on.
+     */
+    Core *core;
+
+    /** The address space of the trace. */
+    unsigned int asid;
+
+    /** The first cycle of the task's current time slice. */
+    uint64_t slice_start;
+
+    /** The instruction count of the task when the time slice began. */
+    unsigned long long slice_inst;
+
+    /**
+     * The cycles the task still had to wait for memory when it was
+     * preempted, which it waits once it runs again.
+     */
+    uint64_t stall_left;
+
+    /** The cycles the task spent on a core, including switching to it. */
+    unsigned long long stat_run_cycles;
+
+    /** The number of times the task was switched to. */
+    unsigned long long stat_switches;
+} SchedTask;
+
+/** The scheduler for all cores. */
+typedef struct Scheduler
+{
+    MemorySystem *sys;
+
+    /**
+     * The core slots of the simulation, which point to the task each core
+     * runs (or last ran, if it is idle).
+     */
+    Core **cores;
+    unsigned int num_cores;
+
+    SchedTask tasks[SCHEDULER_MAX_TASKS];
+    unsigned int num_tasks;
+
+    /** The task each core runs, or -1 if it is idle. */
+    int running[MAX_CORES];
+
+    /** The run queue of waiting tasks, a ring of task indices. */
+    unsigned int queue[SCHEDULER_MAX_TASKS];
+    unsigned int queue_head;
+    unsigned int queue_count;
+
+    /** The cycles a task runs before it may be preempted. */
+    uint64_t quantum;
+
+    /** The cycles a core is stalled by a context switch. */
+    uint64_t switch_cost;
+
+    /** Whether a context switch flushes the L1 caches and the TLBs. */
+    bool flush_caches;
+    bool flush_tlbs;
+
+    /** The instructions and busy cycles of each core, summed over tasks. */
+    unsigned long long stat_inst[MAX_CORES];
+    unsigned long long stat_busy_cycles[MAX_CORES];
+
+    /** The context switches of each core, and the writebacks they caused. */
+    unsigned long long stat_switches[MAX_CORES];
+    unsigned long long stat_flush_writebacks[MAX_CORES];
+} Scheduler;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a scheduler, opening every trace.
+ *
+ * The first num_cores traces start on the cores without a switch, in
+ * address spaces numbered like the cores, and the rest wait in the run
+ * queue in order.
+ *
+ * @param sys The memory system shared by the cores.
+ * @param cores The core slots of the simulation, which are set to the
+ *              running tasks.
+ * @param num_cores The number of cores.
+ * @param trace_filenames The traces to run.
+ * @param num_tasks The number of traces, at least num_cores.
+ * @param quantum The cycles a task runs before it may be preempted.
+ * @param switch_cost The cycles a core is stalled by a context switch.
+ * @param flush_caches Whether a context switch flushes the core's L1
+ *                     caches.
+ * @param flush_tlbs Whether a context switch flushes the core's TLBs.
+ * @return A pointer to the scheduler, or NULL if a trace cannot be opened.
+ */
+Scheduler *scheduler_new(MemorySystem *sys, Core **cores,
+                         unsigned int num_cores,
+                         const char **trace_filenames, unsigned int num_tasks,
+                         uint64_t quantum, uint64_t switch_cost,
+                         bool flush_caches, bool flush_tlbs);
+
+/**
+ * Retire a finished task, or preempt one whose quantum has expired, after a
+ * core has simulated the current cycle, and switch the core to the next
+ * waiting task.
+ *
+ * @param s The scheduler.
+ * @param core_id The CPU core ID.
+ */
+void scheduler_tick(Scheduler *s, unsigned int core_id);
+
+/**
+ * Print the statistics of the scheduler, its cores and its tasks, and close
+ * the traces.
+ *
+ * A task's slowdown is its turnaround time over the cycles it ran, i.e. how
+ * much sharing the cores with the other tasks stretched it.
+ *
+ * @param s The scheduler to print the statistics of.
+ */
+void scheduler_print_stats(Scheduler *s);
+
+/**
+ * Add the statistics of the scheduler, its cores and its tasks to a
+ * registry, under the names scheduler_print_stats() prints them with.
+ *
+ * @param s The scheduler to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void scheduler_collect_stats(Scheduler *s, StatsRegistry *reg);
+
+#endif // __SCHEDULER_H__
@@ -0,0 +1,390 @@
+// selfprof.cpp
+// Defines the functions used to implement the self-profiler.
+
+#include "selfprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The hardware counters, in the order of SelfProfiler.counter_fd. */
+#define SELFPROF_COUNTER_INST 0
+#define SELFPROF_COUNTER_CYCLES 1
+#define SELFPROF_COUNTER_CACHE_REFS 2
+#define SELFPROF_COUNTER_CACHE_MISSES 3
+
+/** The names of the components, as printed. */
+static const char *selfprof_names[SELFPROF_NUM_COMPONENTS + 1] = {
+    "DECODE", "L1", "L2", "DRAM", "MAIN"};
+
+/** The names of the hardware counters, as printed. */
+static const char *selfprof_counter_names[SELFPROF_NUM_COUNTERS] = {
+    "HOST_INST", "HOST_CYCLES", "HOST_CACHE_REFS", "HOST_CACHE_MISSES"};
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number of this thread. */
+extern thread_local uint64_t current_cycle;
+
+/** The timers of each thread, so the alone runs do not count as the run. */
+thread_local SelfProfTimer selfprof_timers[SELFPROF_NUM_COMPONENTS];
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read the monotonic clock.
+ *
+ * @return The current time in seconds.
+ */
+static double selfprof_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Find the number of instructions simulated so far, which is the number of
+ * trace records the calling thread has decoded.
+ *
+ * @return The number of instructions.
+ */
+static unsigned long long selfprof_inst()
+{
+    return selfprof_timers[SELFPROF_DECODE].calls;
+}
+
+/**
+ * Open the hardware counters of the calling thread and start them. The
+ * counters the kernel refuses, for instance under a restrictive
+ * perf_event_paranoid setting, are left at -1.
+ *
+ * @param p The self-profiler.
+ */
+static void selfprof_open_counters(SelfProfiler *p)
+{
+#ifdef __linux__
+    static const uint64_t configs[SELFPROF_NUM_COUNTERS] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+
+    bool any_refused = false;
+    for (unsigned int i = 0; i < SELFPROF_NUM_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        p->counter_fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+                                        -1, 0);
+        if (p->counter_fd[i] < 0)
+        {
+            any_refused = true;
+            continue;
+        }
+        ioctl(p->counter_fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->counter_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    if (any_refused)
+    {
+        fprintf(stderr, "Warning: some hardware counters are unavailable "
+                        "for self-profiling\n");
+    }
+#else
+    fprintf(stderr, "Warning: hardware counters are unavailable for "
+                    "self-profiling\n");
+#endif
+}
+
+/**
+ * Allocate a self-profiler and start timing the run.
+ *
+ * @param period The length of an interval in cycles.
+ * @param use_counters Whether to also read the hardware counters of the
+ *                     simulator.
+ * @return A pointer to the self-profiler.
+ */
+SelfProfiler *selfprof_new(uint64_t period, bool use_counters)
+{
+    SelfProfiler *p = (SelfProfiler *)calloc(1, sizeof(SelfProfiler));
+    p->period = period;
+    p->next_cycle = current_cycle + period;
+
+    for (unsigned int i = 0; i < SELFPROF_NUM_COUNTERS; i++)
+    {
+        p->counter_fd[i] = -1;
+    }
+    if (use_counters)
+    {
+        selfprof_open_counters(p);
+    }
+
+    // The records decoded while the cores were set up are not part of the
+    // run.
+    memset(selfprof_timers, 0, sizeof(selfprof_timers));
+    p->start_seconds = selfprof_seconds();
+    p->start_ticks = selfprof_ticks();
+    p->last_seconds = p->start_seconds;
+    return p;
+}
+
+/**
+ * Record an interval ending now.
+ *
+ * @param p The self-profiler.
+ * @param seconds The current host time.
+ */
+static void selfprof_add_interval(SelfProfiler *p, double seconds)
+{
+    if (p->num_intervals == p->capacity)
+    {
+        p->capacity = (p->capacity == 0) ? 64 : 2 * p->capacity;
+        p->intervals = (SelfProfInterval *)realloc(
+            p->intervals, p->capacity * sizeof(SelfProfInterval));
+    }
+
+    unsigned long long inst = selfprof_inst();
+    SelfProfInterval *interval = &p->intervals[p->num_intervals++];
+    interval->cycle_end = current_cycle;
+    interval->inst = inst - p->last_inst;
+    interval->seconds = seconds - p->last_seconds;
+
+    p->last_inst = inst;
+    p->last_seconds = seconds;
+}
+
+/**
+ * End an interval if one is due at the current cycle.
+ *
+ * @param p The self-profiler.
+ */
+void selfprof_sample(SelfProfiler *p)
+{
+    if (current_cycle < p->next_cycle)
+    {
+        return;
+    }
+
+    selfprof_add_interval(p, selfprof_seconds());
+    p->next_cycle += p->period;
+}
+
+/**
+ * Stop timing the run, ending the last partial interval.
+ *
+ * @param p The self-profiler.
+ */
+void selfprof_finish(SelfProfiler *p)
+{
+    p->total_ticks = selfprof_ticks() - p->start_ticks;
+    double seconds = selfprof_seconds();
+    p->total_seconds = seconds - p->start_seconds;
+    p->total_inst = selfprof_inst();
+
+    if (p->num_intervals == 0 ||
+        p->intervals[p->num_intervals - 1].cycle_end != current_cycle)
+    {
+        selfprof_add_interval(p, seconds);
+    }
+
+    for (unsigned int i = 0; i < SELFPROF_NUM_COUNTERS; i++)
+    {
+        if (p->counter_fd[i] < 0)
+        {
+            continue;
+        }
+        uint64_t value = 0;
+        if (read(p->counter_fd[i], &value, sizeof(value)) == sizeof(value))
+        {
+            p->counter_value[i] = value;
+        }
+        close(p->counter_fd[i]);
+        p->counter_fd[i] = -1;
+    }
+}
+
+/**
+ * Estimate the ticks spent in a component, scaling the sampled calls up to
+ * all calls.
+ *
+ * @param component The component.
+ * @return The estimated ticks, including the components it calls.
+ */
+static double selfprof_estimate(SelfProfComponent component)
+{
+    SelfProfTimer *t = &selfprof_timers[component];
+    if (t->sampled_calls == 0)
+    {
+        return 0.0;
+    }
+    return (double)(t->sampled_ticks) * (double)(t->calls) /
+           (double)(t->sampled_calls);
+}
+
+/**
+ * Split the ticks of the run between the components, each without the
+ * components it calls, and the rest of the main loop.
+ *
+ * @param p The self-profiler.
+ * @param percent Set to the share of the ticks of each component, indexed by
+ *                component and then the main loop last.
+ */
+static void selfprof_split(SelfProfiler *p,
+                           double percent[SELFPROF_NUM_COMPONENTS + 1])
+{
+    double dram = selfprof_estimate(SELFPROF_DRAM);
+    double l2 = selfprof_estimate(SELFPROF_L2) - dram;
+    l2 = (l2 > 0.0) ? l2 : 0.0;
+
+    // DRAM writebacks can come from outside the lower levels' timer.
+    double l1 = selfprof_estimate(SELFPROF_L1) - l2 - dram;
+    l1 = (l1 > 0.0) ? l1 : 0.0;
+
+    double decode = selfprof_estimate(SELFPROF_DECODE);
+    double main_loop = (double)(p->total_ticks) - decode - l1 - l2 - dram;
+    main_loop = (main_loop > 0.0) ? main_loop : 0.0;
+
+    double ticks[SELFPROF_NUM_COMPONENTS + 1] = {decode, l1, l2, dram,
+                                                 main_loop};
+    for (unsigned int i = 0; i <= SELFPROF_NUM_COMPONENTS; i++)
+    {
+        percent[i] = 0.0;
+        if (p->total_ticks)
+        {
+            percent[i] = 100.0 * ticks[i] / (double)(p->total_ticks);
+        }
+    }
+}
+
+/**
+ * Find the simulated kilo-instructions per host second.
+ *
+ * @param inst The number of instructions.
+ * @param seconds The host time they took.
+ * @return The speed, or 0 if no time passed.
+ */
+static double selfprof_kips(unsigned long long inst, double seconds)
+{
+    if (seconds <= 0.0)
+    {
+        return 0.0;
+    }
+    return (double)inst / seconds / 1000.0;
+}
+
+/**
+ * Print the simulation speed, the split of the host time between the
+ * components, the hardware counters and the speed of every interval.
+ *
+ * @param p The self-profiler to print the statistics of.
+ */
+void selfprof_print_stats(SelfProfiler *p)
+{
+    char label[48];
+    double percent[SELFPROF_NUM_COMPONENTS + 1];
+    selfprof_split(p, percent);
+
+    printf("\n");
+    printf("SELFPROF_HOST_SEC    \t\t : %10.3f\n", p->total_seconds);
+    printf("SELFPROF_INST        \t\t : %10llu\n", p->total_inst);
+    printf("SELFPROF_KIPS        \t\t : %10.3f\n",
+           selfprof_kips(p->total_inst, p->total_seconds));
+    for (unsigned int i = 0; i <= SELFPROF_NUM_COMPONENTS; i++)
+    {
+        snprintf(label, sizeof(label), "SELFPROF_%s_PERC", selfprof_names[i]);
+        printf("%-20s\t\t : %10.3f\n", label, percent[i]);
+    }
+
+    bool any_counter = false;
+    for (unsigned int i = 0; i < SELFPROF_NUM_COUNTERS; i++)
+    {
+        if (p->counter_value[i])
+        {
+            if (!any_counter)
+            {
+                printf("\n");
+                any_counter = true;
+            }
+            snprintf(label, sizeof(label), "SELFPROF_%s",
+                     selfprof_counter_names[i]);
+            printf("%-20s\t\t : %10llu\n", label, p->counter_value[i]);
+        }
+    }
+    if (p->counter_value[SELFPROF_COUNTER_INST] &&
+        p->counter_value[SELFPROF_COUNTER_CYCLES])
+    {
+        printf("SELFPROF_HOST_IPC    \t\t : %10.3f\n",
+               (double)(p->counter_value[SELFPROF_COUNTER_INST]) /
+                   (double)(p->counter_value[SELFPROF_COUNTER_CYCLES]));
+    }
+    if (p->counter_value[SELFPROF_COUNTER_CACHE_REFS])
+    {
+        unsigned long long *value = p->counter_value;
+        printf("SELFPROF_HOST_MISS_PERC\t\t : %10.3f\n",
+               100.0 * (double)(value[SELFPROF_COUNTER_CACHE_MISSES]) /
+                   (double)(value[SELFPROF_COUNTER_CACHE_REFS]));
+    }
+
+    printf("\n");
+    printf("%8s %14s %12s %10s %10s\n", "INTERVAL", "CYCLE_END", "INST",
+           "HOST_SEC", "KIPS");
+    for (unsigned int i = 0; i < p->num_intervals; i++)
+    {
+        SelfProfInterval *interval = &p->intervals[i];
+        printf("%8u %14llu %12llu %10.3f %10.3f\n", i,
+               (unsigned long long)interval->cycle_end, interval->inst,
+               interval->seconds,
+               selfprof_kips(interval->inst, interval->seconds));
+    }
+}
+
+/**
+ * Add the simulation speed, time split and hardware counters to a registry,
+ * under the names selfprof_print_stats() prints them with.
+ *
+ * @param p The self-profiler to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void selfprof_collect_stats(SelfProfiler *p, StatsRegistry *reg)
+{
+    char name[48];
+    double percent[SELFPROF_NUM_COMPONENTS + 1];
+    selfprof_split(p, percent);
+
+    stats_add_real(reg, "SELFPROF", "HOST_SEC", p->total_seconds);
+    stats_add_count(reg, "SELFPROF", "INST", p->total_inst);
+    stats_add_real(reg, "SELFPROF", "KIPS",
+                   selfprof_kips(p->total_inst, p->total_seconds));
+    for (unsigned int i = 0; i <= SELFPROF_NUM_COMPONENTS; i++)
+    {
+        snprintf(name, sizeof(name), "%s_PERC", selfprof_names[i]);
+        stats_add_real(reg, "SELFPROF", name, percent[i]);
+    }
+    for (unsigned int i = 0; i < SELFPROF_NUM_COUNTERS; i++)
+    {
+        if (p->counter_value[i])
+        {
+            stats_add_count(reg, "SELFPROF", selfprof_counter_names[i],
+                            p->counter_value[i]);
+        }
+    }
+}
@@ -0,0 +1,243 @@
+// selfprof.h
+// Declares the self-profiler, which measures how fast the simulator itself
+// runs and where its host time goes.
+//
+// The speed is the number of simulated instructions per host second, for the
+// whole run and for every interval of simulated cycles. The instructions are
+// counted as the trace records the main thread decodes, which follows tasks
+// across context switches and replays. The host time is
+// split between decoding the traces, the L1 caches and TLBs, the lower cache
+// levels, DRAM and the rest of the main loop. Timing every call would cost
+// more than many of the calls themselves, so only about one call in
+// SELFPROF_SAMPLE_PERIOD to each component reads the time stamp counter, and
+// its time is scaled by the number of calls. The gaps between sampled calls
+// vary, since a fixed gap would keep sampling the same core when the cores
+// take turns. The components nest (an L1 miss
+// goes on to L2 and DRAM), so each is timed inclusively and the time of the
+// components below it is subtracted when reporting.
+//
+// The hardware counters of the simulator process, such as its IPC and cache
+// misses, are optionally read through perf_event_open(2) where the kernel
+// allows it.
+
+#ifndef __SELFPROF_H__
+#define __SELFPROF_H__
+
+#include "types.h"
+#include "stats.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * About one call in this many to each component is timed. The gaps between
+ * timed calls range from 1 to twice this (a power of 2).
+ */
+#define SELFPROF_SAMPLE_PERIOD 16
+
+/** The number of hardware counters read through perf_event_open(2). */
+#define SELFPROF_NUM_COUNTERS 4
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The parts of the simulator whose host time is measured. */
+typedef enum SelfProfComponentEnum
+{
+    /** Reading and decoding trace records. */
+    SELFPROF_DECODE = 0,
+
+    /** A memory access, from the L1 caches and TLBs down. */
+    SELFPROF_L1,
+
+    /** An access to the cache levels below L1, down to DRAM. */
+    SELFPROF_L2,
+
+    /** A DRAM access, including its controller. */
+    SELFPROF_DRAM,
+
+    SELFPROF_NUM_COMPONENTS
+} SelfProfComponent;
+
+/** The sampled timing of one component. */
+typedef struct SelfProfTimer
+{
+    unsigned long long calls;
+    unsigned long long sampled_calls;
+
+    /** The number of calls left before the next sampled one. */
+    uint32_t countdown;
+
+    /** The time stamp counter ticks of the sampled calls. */
+    unsigned long long sampled_ticks;
+} SelfProfTimer;
+
+/** The simulation speed over one interval. */
+typedef struct SelfProfInterval
+{
+    uint64_t cycle_end;
+    unsigned long long inst;
+    double seconds;
+} SelfProfInterval;
+
+/** The self-profiler of a run. */
+typedef struct SelfProfiler
+{
+    /** The length of an interval in cycles, and when the next one ends. */
+    uint64_t period;
+    uint64_t next_cycle;
+
+    /** The host time, ticks and instructions at the start of the run. */
+    double start_seconds;
+    uint64_t start_ticks;
+
+    /** The host time and instructions at the end of the last interval. */
+    double last_seconds;
+    unsigned long long last_inst;
+
+    /** The host time, ticks and instructions over the whole run. */
+    double total_seconds;
+    uint64_t total_ticks;
+    unsigned long long total_inst;
+
+    /** The intervals so far. */
+    SelfProfInterval *intervals;
+    unsigned int num_intervals;
+    unsigned int capacity;
+
+    /**
+     * The perf_event_open(2) file descriptors of the hardware counters, or -1
+     * for those the kernel refused, and their values at the end of the run.
+     */
+    int counter_fd[SELFPROF_NUM_COUNTERS];
+    unsigned long long counter_value[SELFPROF_NUM_COUNTERS];
+} SelfProfiler;
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Whether the simulator profiles itself: 0 for no, 1 for its speed and time
+ * split, 2 to also read its hardware counters.
+ */
+extern unsigned int SELF_PROF;
+
+/** The timers of the calling thread, indexed by component. */
+extern thread_local SelfProfTimer selfprof_timers[SELFPROF_NUM_COMPONENTS];
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read the time stamp counter, or the monotonic clock in nanoseconds where
+ * there is none.
+ *
+ * @return The current tick.
+ */
+static inline uint64_t selfprof_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Count a call to a component, and start timing it if it is sampled.
+ *
+ * This is on the path of every memory access, so it is defined here to be
+ * inlined.
+ *
+ * @param component The component being called.
+ * @return The tick the call starts at if it is sampled, or 0.
+ */
+static inline uint64_t selfprof_begin(SelfProfComponent component)
+{
+    if (!SELF_PROF)
+    {
+        return 0;
+    }
+
+    SelfProfTimer *t = &selfprof_timers[component];
+    t->calls++;
+    if (t->countdown > 0)
+    {
+        t->countdown--;
+        return 0;
+    }
+
+    // A multiplicative hash of the call count picks the next gap.
+    t->countdown = ((uint32_t)(t->calls) * 2654435761U) >>
+                   (32 - __builtin_ctz(2 * SELFPROF_SAMPLE_PERIOD));
+    return selfprof_ticks();
+}
+
+/**
+ * Finish timing a call to a component.
+ *
+ * @param component The component being called.
+ * @param start The value selfprof_begin() returned for the call.
+ */
+static inline void selfprof_end(SelfProfComponent component, uint64_t start)
+{
+    if (start != 0)
+    {
+        SelfProfTimer *t = &selfprof_timers[component];
+        t->sampled_ticks += selfprof_ticks() - start;
+        t->sampled_calls++;
+    }
+}
+
+/**
+ * Allocate a self-profiler and start timing the run.
+ *
+ * @param period The length of an interval in cycles.
+ * @param use_counters Whether to also read the hardware counters of the
+ *                     simulator.
+ * @return A pointer to the self-profiler.
+ */
+SelfProfiler *selfprof_new(uint64_t period, bool use_counters);
+
+/**
+ * End an interval if one is due at the current cycle.
+ *
+ * @param p The self-profiler.
+ */
+void selfprof_sample(SelfProfiler *p);
+
+/**
+ * Stop timing the run, ending the last partial interval.
+ *
+ * @param p The self-profiler.
+ */
+void selfprof_finish(SelfProfiler *p);
+
+/**
+ * Print the simulation speed, the split of the host time between the
+ * components, the hardware counters and the speed of every interval.
+ *
+ * @param p The self-profiler to print the statistics of.
+ */
+void selfprof_print_stats(SelfProfiler *p);
+
+/**
+ * Add the simulation speed, time split and hardware counters to a registry,
+ * under the names selfprof_print_stats() prints them with.
+ *
+ * @param p The self-profiler to collect the statistics of.
+ * @param reg The registry to add the statistics to.
+ */
+void selfprof_collect_stats(SelfProfiler *p, StatsRegistry *reg);
+
+#endif // __SELFPROF_H__
@@ -9,11 +9,16 @@
 #include "types.h"
 #include "memsys.h"
 #include "core.h"
+#include "parallel.h"
+#include "scheduler.h"
+#include "fairness.h"
+#include "stats.h"
+#include "analyze.h"
+#include "selfprof.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
 
-#define MAX_CORES 2
 #define PRINT_DOTS 1
 #define DOT_INTERVAL 100000
 
@@ -66,21 +71,248 @@ unsigned int NUM_CORES = 0;
 /** Which page policy the DRAM should use. */
 DRAMPolicy DRAM_PAGE_POLICY = OPEN_PAGE;
 
+/** For PAGE_TIMEOUT, the idle cycles after which a bank closes its row. */
+uint64_t DRAM_PAGE_TIMEOUT = 200;
+
+/** For PAGE_OPEN_ADAPTIVE, the most hits served before a row is closed. */
+unsigned int DRAM_PAGE_CAP = 4;
+
+/** Which scheduler the DRAM controller should use. */
+DRAMScheduler DRAM_SCHEDULER = SCHED_NONE;
+
+/**
+ * For SCHED_FRFCFS_CAP, the number of younger row hits that may be served
+ * ahead of an older request to the same bank.
+ */
+unsigned int DRAM_SCHED_CAP = 4;
+
+/**
+ * The number of waiting writes at which a DRAM channel starts draining its
+ * write queues, or 0 to schedule reads and writes together.
+ */
+unsigned int DRAM_WQ_HIGH = 0;
+
+/** The number of waiting writes at which a write drain ends. */
+unsigned int DRAM_WQ_LOW = 0;
+
+/** How the DRAM controller refreshes the banks. */
+DRAMRefresh DRAM_REFRESH = REFRESH_OFF;
+
+/**
+ * Whether refreshes are postponed while a rank is busy and pulled in while it
+ * is idle.
+ */
+bool DRAM_REFRESH_AWARE = false;
+
+/** The name of the DRAM timing preset to use. */
+const char *DRAM_PRESET = "lab";
+
+/** The CPU clock frequency in MHz, used to convert DRAM clocks to cycles. */
+unsigned int CPU_FREQ_MHZ = 3200;
+
+/** The DRAM geometry: channels, ranks per channel, and banks per rank. */
+unsigned int DRAM_CHANNELS = 1;
+unsigned int DRAM_RANKS = 1;
+unsigned int DRAM_BANK_GROUPS = 4;
+unsigned int DRAM_BANKS_PER_GROUP = 4;
+
+/** The row buffer size, in bytes. */
+uint64_t DRAM_ROW_SIZE = 1024;
+
+/**
+ * The DRAM address mapping, from the most to the least significant bits of
+ * the line address. See dram_map_valid().
+ */
+const char *DRAM_ADDR_MAP = "RoChRaBaCo";
+
+/** Whether to XOR the bank index with the low bits of the row. */
+bool DRAM_XOR_BANKS = false;
+
+/**
+ * Whether the unscheduled DRAM model serializes data transfers on each
+ * channel's bus. The controllers always do.
+ */
+bool DRAM_BUS_MODEL = false;
+
+/** Whether DRAM energy and power are reported. */
+bool DRAM_ENERGY = false;
+
+/**
+ * The cycles a DRAM rank stays idle before powering down, or 0 to never power
+ * down.
+ */
+uint64_t DRAM_POWERDOWN = 0;
+
+/** Whether per-bank, per-core and bank parallelism DRAM statistics are printed. */
+bool DRAM_STATS = false;
+
+/** The cycles in each DRAM bandwidth sample, or 0 for no samples. */
+uint64_t DRAM_INTERVAL = 0;
+
+/**
+ * The cache hierarchy configuration file, or NULL to use the fixed hierarchy
+ * of the current mode.
+ */
+const char *HIER_CONFIG = NULL;
+
+/**
+ * The number of entries in each core's reorder buffer, or 0 for the blocking
+ * in-order core.
+ */
+unsigned int CORE_ROB_SIZE = 0;
+
+/** For the out-of-order core, the instructions dispatched and retired per cycle. */
+unsigned int CORE_ISSUE_WIDTH = 4;
+
+/** For the out-of-order core, the most loads that can be in the ROB. */
+unsigned int CORE_LQ_SIZE = 32;
+
+/**
+ * The number of entries in each core's store buffer, or 0 for stores to
+ * access the memory system at once and never stall.
+ */
+unsigned int CORE_SB_SIZE = 0;
+
+/** Whether mode 4 runs each core and its L1 caches on a thread of its own. */
+bool PARALLEL_SIM = false;
+
+/** The cycles the parallel cores advance between barriers (1 is lockstep). */
+uint64_t PARALLEL_QUANTUM = 1000;
+
+/**
+ * Whether each core that finishes its trace replays it until every core has
+ * retired its instruction target, with its statistics frozen at the target.
+ */
+bool CORE_REPLAY = false;
+
+/**
+ * In replay mode, the instructions each core must retire, or 0 for the
+ * length of its trace.
+ */
+unsigned long long CORE_INST_TARGET = 0;
+
+/**
+ * Whether mode 4 also simulates each trace alone to report the weighted and
+ * harmonic speedups and the maximum slowdown of the mix.
+ */
+bool ALONE_RUNS = false;
+
+/**
+ * Whether mode 4 time-slices any number of traces across the cores, instead
+ * of running one trace per core.
+ */
+bool OS_SCHED = false;
+
+/**
+ * The number of cores the OS scheduler time-slices the traces across, or 0
+ * for SCHEDULER_DEFAULT_CORES.
+ */
+unsigned int OS_CORES = 0;
+
+/** The cycles a scheduled trace runs before it may be preempted. */
+uint64_t OS_QUANTUM = 1000000;
+
+/** The cycles a core is stalled by a context switch. */
+uint64_t OS_SWITCH_COST = 5000;
+
+/**
+ * What a context switch flushes: 1 for the core's L1 caches, 2 for its TLBs,
+ * or 3 for both.
+ */
+unsigned int OS_FLUSH = 0;
+
+/**
+ * Whether to analyze the traces (their footprint, reuse distances and
+ * working sets) instead of simulating them.
+ */
+bool ANALYZE_TRACES = false;
+
+/** The number of instructions in each working set window of the analysis. */
+uint64_t ANALYZE_WINDOW = 1000000;
+
+/**
+ * Whether the delays of each core's accesses and of DRAM are recorded in
+ * histograms, to report their percentiles.
+ */
+bool LATENCY_HIST = false;
+
+/**
+ * The number of PCs the per-PC profiler reports, ranked by the stall cycles
+ * of their accesses, or 0 to not profile.
+ */
+unsigned int PC_PROF_TOP = 0;
+
+/**
+ * Whether the simulator profiles itself: 0 for no, 1 for its speed and time
+ * split, 2 to also read its hardware counters.
+ */
+unsigned int SELF_PROF = 0;
+
+/** The length in cycles of the intervals whose speed is reported. */
+uint64_t SELF_PROF_INTERVAL = 1000000;
+
+/** The files the statistics are also written to as JSON and CSV, or NULL. */
+const char *STATS_JSON = NULL;
+const char *STATS_CSV = NULL;
+
+/**
+ * The length of the intervals whose IPC, MPKI and DRAM bandwidth are
+ * recorded in the JSON and CSV files, or 0 for no intervals.
+ */
+uint64_t STATS_INTERVAL = 0;
+
+/** Whether STATS_INTERVAL counts instructions of all cores, not cycles. */
+bool STATS_INTERVAL_INST = false;
+
+/** Whether translations in mode 4 go through TLBs and page walks. */
+bool TLB_ENABLED = false;
+
+/** The entries of each L1 ITLB and DTLB, and their associativity. */
+uint64_t ITLB_ENTRIES = 64;
+uint64_t DTLB_ENTRIES = 64;
+uint64_t L1TLB_ASSOC = 4;
+
+/** The entries of the shared L2 TLB, and its associativity. */
+uint64_t STLB_ENTRIES = 1536;
+uint64_t STLB_ASSOC = 12;
+
+/** The entries of each core's fully associative page-walk cache, or 0. */
+uint64_t PWC_ENTRIES = 32;
+
+/** Whether pages are 2 MB instead of 4 KB. */
+bool TLB_LARGE_PAGES = false;
+
+/** How physical frames are chosen for virtual pages in mode 4. */
+PageAllocPolicy PAGE_ALLOC_POLICY = PAGE_ALLOC_FIXED;
+
+/** The size of physical memory in MB, for the page allocators. */
+uint64_t PHYS_MEM_MB = 16384;
+
+/** What the L2 cache does with fills that are predicted dead. */
+DeadBlockPolicy L2_DBP_POLICY = DBP_OFF;
+
 /**
  * The current clock cycle number.
  * 
  * This can be used as a timestamp for implementing the LRU replacement policy.
+ * Each thread of the parallel engine has its own.
  */
-uint64_t current_cycle;
+thread_local uint64_t current_cycle;
 
 MemorySystem *memsys;
 Core *core[MAX_CORES];
-const char *trace_filename[MAX_CORES];
+const char *trace_filename[SCHEDULER_MAX_TASKS];
+unsigned int num_traces;
+Scheduler *scheduler;
+Fairness *fairness;
+StatsSampler *sampler;
+SelfProfiler *selfprof;
 uint64_t last_printdot_cycle;
 
 int parse_args(int argc, char **argv);
 void print_dots();
 void print_stats();
+void write_stats();
 void print_usage(const char *program_name);
 
 int main(int argc, char **argv)
@@ -91,25 +323,106 @@ int main(int argc, char **argv)
         return status;
     }
 
+    if (ANALYZE_TRACES)
+    {
+        Analysis *analysis = analyze_traces(trace_filename, num_traces,
+                                            ANALYZE_WINDOW);
+        analyze_print_stats(analysis);
+        return 0;
+    }
+
+    // With random replacement, the alone runs finish first so that they and
+    // the mix each see the sequence of rand() they would on their own.
+    if (ALONE_RUNS)
+    {
+        bool serial = (REPL_POLICY == RANDOM || L2CACHE_REPL == RANDOM ||
+                       HIER_CONFIG != NULL);
+        fairness = fairness_start(trace_filename, NUM_CORES, serial);
+    }
+
     srand(42);
     memsys = memsys_new();
-    for (unsigned int i = 0; i < NUM_CORES; i++)
+    if (memsys == NULL)
+    {
+        return 1;
+    }
+    if (PC_PROF_TOP)
+    {
+        memsys->pc_prof = pcprof_new();
+    }
+    if (OS_SCHED)
+    {
+        scheduler = scheduler_new(memsys, core, NUM_CORES, trace_filename,
+                                  num_traces, OS_QUANTUM, OS_SWITCH_COST,
+                                  OS_FLUSH & 1, OS_FLUSH & 2);
+        if (scheduler == NULL)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            core[i] = core_new(memsys, trace_filename[i], i);
+        }
+    }
+
+    ParallelEngine *engine = NULL;
+    if (PARALLEL_SIM)
     {
-        core[i] = core_new(memsys, trace_filename[i], i);
+        engine = parallel_new(core, NUM_CORES, memsys, PARALLEL_QUANTUM);
+    }
+    if (STATS_INTERVAL)
+    {
+        sampler = stats_sampler_new(memsys, core, NUM_CORES, STATS_INTERVAL,
+                                    STATS_INTERVAL_INST);
     }
 
     print_dots();
+    if (SELF_PROF)
+    {
+        selfprof = selfprof_new(SELF_PROF_INTERVAL, SELF_PROF == 2);
+    }
 
     // Iterate until all cores are done.
     bool all_cores_done = false;
     while (!all_cores_done)
     {
+        if (engine != NULL)
+        {
+            uint64_t next_cycle = parallel_run_quantum(engine,
+                                                       &all_cores_done);
+            if (current_cycle - last_printdot_cycle >= DOT_INTERVAL)
+            {
+                print_dots();
+            }
+            current_cycle = next_cycle;
+            if (sampler != NULL)
+            {
+                stats_sample(sampler);
+            }
+            continue;
+        }
+
         all_cores_done = true;
 
         for (unsigned int i = 0; i < NUM_CORES; i++)
         {
             core_cycle(core[i]);
-            all_cores_done = all_cores_done && core[i]->done;
+            if (scheduler != NULL)
+            {
+                scheduler_tick(scheduler, i);
+            }
+            if (CORE_REPLAY)
+            {
+                core_check_target(core[i]);
+                all_cores_done = all_cores_done && core[i]->frozen;
+            }
+            else
+            {
+                all_cores_done = all_cores_done && core[i]->done;
+            }
         }
 
         if (current_cycle - last_printdot_cycle >= DOT_INTERVAL)
@@ -118,9 +431,32 @@ int main(int argc, char **argv)
         }
 
         current_cycle++;
+        if (sampler != NULL)
+        {
+            stats_sample(sampler);
+        }
+        if (selfprof != NULL)
+        {
+            selfprof_sample(selfprof);
+        }
+    }
+
+    if (selfprof != NULL)
+    {
+        selfprof_finish(selfprof);
+    }
+
+    if (engine != NULL)
+    {
+        parallel_free(engine);
+    }
+    if (fairness != NULL)
+    {
+        fairness_wait(fairness);
     }
 
     print_stats();
+    write_stats();
     return 0;
 }
 
@@ -132,6 +468,10 @@ int parse_args(int argc, char **argv)
         return 2;
     }
 
+    // Both set the parallel quantum, so they are checked after parsing.
+    bool quantum_given = false;
+    bool lockstep_given = false;
+
     for (int i = 1; i < argc; i++)
     {
         if (argv[i][0] == '-')
@@ -269,98 +609,1151 @@ int parse_args(int argc, char **argv)
                 }
 
                 int dram_policy = atoi(argv[i]);
-                if (dram_policy < 0 || dram_policy > 1)
+                if (dram_policy < 0 || dram_policy > 4)
                 {
-                    fprintf(stderr, "Error: dram_policy must be between 0 and 1\n");
+                    fprintf(stderr, "Error: dram_policy must be between 0 and 4\n");
                     return 2;
                 }
 
                 DRAM_PAGE_POLICY = (DRAMPolicy)dram_policy;
             }
 
-            else
+            else if (strcasecmp(argv[i], "-dram_timeout") == 0)
             {
-                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
-                return 2;
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_timeout\n");
+                    return 2;
+                }
+                DRAM_PAGE_TIMEOUT = atoi(argv[i]);
             }
-        }
-        else
-        {
-            // Parse trace file name.
-            if (NUM_CORES >= MAX_CORES)
+
+            else if (strcasecmp(argv[i], "-dram_page_cap") == 0)
             {
-                fprintf(stderr, "Error: too many trace files specified\n");
-                return 2;
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_page_cap\n");
+                    return 2;
+                }
+                DRAM_PAGE_CAP = atoi(argv[i]);
             }
 
-            trace_filename[NUM_CORES] = argv[i];
-            NUM_CORES++;
-        }
-    }
+            else if (strcasecmp(argv[i], "-dram_sched") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_sched\n");
+                    return 2;
+                }
 
-    if (NUM_CORES == 0)
-    {
-        fprintf(stderr, "Error: no trace file specified\n");
-        return 2;
-    }
+                int dram_sched = atoi(argv[i]);
+                if (dram_sched < 0 || dram_sched > 3)
+                {
+                    fprintf(stderr, "Error: dram_sched must be between 0 and 3\n");
+                    return 2;
+                }
 
-    return 0;
-}
+                DRAM_SCHEDULER = (DRAMScheduler)dram_sched;
+            }
 
-void print_dots()
-{
-    unsigned int LINE_INTERVAL = 50 * DOT_INTERVAL;
-    last_printdot_cycle = current_cycle;
+            else if (strcasecmp(argv[i], "-dram_cap") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_cap\n");
+                    return 2;
+                }
+                DRAM_SCHED_CAP = atoi(argv[i]);
+            }
 
-    if (!PRINT_DOTS)
-    {
-        return;
-    }
+            else if (strcasecmp(argv[i], "-dram_wq_high") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_wq_high\n");
+                    return 2;
+                }
+                DRAM_WQ_HIGH = atoi(argv[i]);
+            }
 
-    if (current_cycle % LINE_INTERVAL == 0)
-    {
-        if (current_cycle != 0)
-        {
-            printf("\n");
-        }
-        printf("%4llu M\t", (unsigned long long)current_cycle / 1000000);
-        fflush(stdout);
-    }
-    else
-    {
-        printf(".");
-        fflush(stdout);
-    }
-}
+            else if (strcasecmp(argv[i], "-dram_wq_low") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_wq_low\n");
+                    return 2;
+                }
+                DRAM_WQ_LOW = atoi(argv[i]);
+            }
 
-void print_stats()
-{
-    printf("\n\n");
-    printf("CYCLES              \t\t : %10llu\n",
-           (unsigned long long)current_cycle);
+            else if (strcasecmp(argv[i], "-dram_refresh") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_refresh\n");
+                    return 2;
+                }
 
-    for (unsigned int i = 0; i < NUM_CORES; i++)
-    {
-        core_print_stats(core[i]);
-    }
+                int dram_refresh = atoi(argv[i]);
+                if (dram_refresh < 0 || dram_refresh > 2)
+                {
+                    fprintf(stderr, "Error: dram_refresh must be between 0 and 2\n");
+                    return 2;
+                }
 
-    memsys_print_stats(memsys);
-}
+                DRAM_REFRESH = (DRAMRefresh)dram_refresh;
+            }
 
-void print_usage(const char *program_name)
-{
-    fprintf(stderr, "Usage: %s [-option <value>] trace_0 <trace_1>\n",
-            program_name);
-    fprintf(stderr, "\n");
-    fprintf(stderr, "Trace driven memory system simulator\n");
-    fprintf(stderr, "\n");
-    fprintf(stderr, "    -mode <num>             Set mode of the simulator "
-                    "[1: part A, 2: part B,\n");
-    fprintf(stderr, "                            3: part C, 4: part D/E/F] "
-                    "(default: 1)\n");
-    fprintf(stderr, "    -linesize <num>         Set cache line size in bytes "
-                    "for all caches\n");
-    fprintf(stderr, "                            (default: 64)\n");
+            else if (strcasecmp(argv[i], "-dram_refresh_aware") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_refresh_aware\n");
+                    return 2;
+                }
+                DRAM_REFRESH_AWARE = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_preset") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-dram_preset\n");
+                    return 2;
+                }
+
+                if (!dram_preset_exists(argv[i]))
+                {
+                    fprintf(stderr, "Error: unknown DRAM preset %s\n",
+                            argv[i]);
+                    return 2;
+                }
+
+                DRAM_PRESET = argv[i];
+            }
+
+            else if (strcasecmp(argv[i], "-cpu_mhz") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -cpu_mhz\n");
+                    return 2;
+                }
+
+                int cpu_mhz = atoi(argv[i]);
+                if (cpu_mhz <= 0)
+                {
+                    fprintf(stderr, "Error: cpu_mhz must be positive\n");
+                    return 2;
+                }
+
+                CPU_FREQ_MHZ = cpu_mhz;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_channels") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_channels\n");
+                    return 2;
+                }
+
+                int value = atoi(argv[i]);
+                if (value <= 0 || (value & (value - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: dram_channels must be a power of 2\n");
+                    return 2;
+                }
+
+                DRAM_CHANNELS = value;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_ranks") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_ranks\n");
+                    return 2;
+                }
+
+                int value = atoi(argv[i]);
+                if (value <= 0 || (value & (value - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: dram_ranks must be a power of 2\n");
+                    return 2;
+                }
+
+                DRAM_RANKS = value;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_bankgroups") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_bankgroups\n");
+                    return 2;
+                }
+
+                int value = atoi(argv[i]);
+                if (value <= 0 || (value & (value - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: dram_bankgroups must be a power of 2\n");
+                    return 2;
+                }
+
+                DRAM_BANK_GROUPS = value;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_banks") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_banks\n");
+                    return 2;
+                }
+
+                int value = atoi(argv[i]);
+                if (value <= 0 || (value & (value - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: dram_banks must be a power of 2\n");
+                    return 2;
+                }
+
+                DRAM_BANKS_PER_GROUP = value;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_rowsize") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_rowsize\n");
+                    return 2;
+                }
+
+                int value = atoi(argv[i]);
+                if (value <= 0 || (value & (value - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: dram_rowsize must be a power of 2\n");
+                    return 2;
+                }
+
+                DRAM_ROW_SIZE = value;
+            }
+
+            else if (strcasecmp(argv[i], "-dram_map") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_map\n");
+                    return 2;
+                }
+                DRAM_ADDR_MAP = argv[i];
+            }
+
+            else if (strcasecmp(argv[i], "-dram_xor") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_xor\n");
+                    return 2;
+                }
+                DRAM_XOR_BANKS = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_bus") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_bus\n");
+                    return 2;
+                }
+                DRAM_BUS_MODEL = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_energy") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_energy\n");
+                    return 2;
+                }
+                DRAM_ENERGY = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_powerdown") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_powerdown\n");
+                    return 2;
+                }
+                DRAM_POWERDOWN = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_stats") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_stats\n");
+                    return 2;
+                }
+                DRAM_STATS = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-dram_interval") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dram_interval\n");
+                    return 2;
+                }
+                DRAM_INTERVAL = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-L2dbp") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -L2dbp\n");
+                    return 2;
+                }
+
+                int l2dbp = atoi(argv[i]);
+                if (l2dbp < 0 || l2dbp > 2)
+                {
+                    fprintf(stderr, "Error: L2dbp must be between 0 and 2\n");
+                    return 2;
+                }
+
+                L2_DBP_POLICY = (DeadBlockPolicy)l2dbp;
+            }
+
+            else if (strcasecmp(argv[i], "-hier") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -hier\n");
+                    return 2;
+                }
+                HIER_CONFIG = argv[i];
+            }
+
+            else if (strcasecmp(argv[i], "-rob") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -rob\n");
+                    return 2;
+                }
+                CORE_ROB_SIZE = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-width") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -width\n");
+                    return 2;
+                }
+                CORE_ISSUE_WIDTH = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-lq") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -lq\n");
+                    return 2;
+                }
+                CORE_LQ_SIZE = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-sb") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -sb\n");
+                    return 2;
+                }
+                CORE_SB_SIZE = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-parallel") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -parallel\n");
+                    return 2;
+                }
+                PARALLEL_SIM = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-quantum") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -quantum\n");
+                    return 2;
+                }
+
+                int quantum = atoi(argv[i]);
+                if (quantum < 1 || quantum > 100000)
+                {
+                    fprintf(stderr, "Error: quantum must be between 1 and "
+                                    "100000\n");
+                    return 2;
+                }
+
+                PARALLEL_QUANTUM = quantum;
+                quantum_given = true;
+            }
+
+            else if (strcasecmp(argv[i], "-lockstep") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -lockstep\n");
+                    return 2;
+                }
+                if (atoi(argv[i]) != 0)
+                {
+                    PARALLEL_QUANTUM = 1;
+                }
+                lockstep_given = true;
+            }
+
+            else if (strcasecmp(argv[i], "-replay") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -replay\n");
+                    return 2;
+                }
+                CORE_REPLAY = atoi(argv[i]) != 0;
+            }
+
+            else if (strcasecmp(argv[i], "-inst_target") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-inst_target\n");
+                    return 2;
+                }
+                CORE_INST_TARGET = strtoull(argv[i], NULL, 10);
+            }
+
+            else if (strcasecmp(argv[i], "-alone") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -alone\n");
+                    return 2;
+                }
+                ALONE_RUNS = atoi(argv[i]) != 0;
+            }
+
+            else if (strcasecmp(argv[i], "-os_sched") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -os_sched\n");
+                    return 2;
+                }
+                OS_SCHED = atoi(argv[i]) != 0;
+            }
+
+            else if (strcasecmp(argv[i], "-cores") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -cores\n");
+                    return 2;
+                }
+
+                int cores = atoi(argv[i]);
+                if (cores < 1 || cores > MAX_CORES)
+                {
+                    fprintf(stderr, "Error: cores must be between 1 and %d\n",
+                            MAX_CORES);
+                    return 2;
+                }
+                OS_CORES = cores;
+            }
+
+            else if (strcasecmp(argv[i], "-os_quantum") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-os_quantum\n");
+                    return 2;
+                }
+
+                int quantum = atoi(argv[i]);
+                if (quantum < 1)
+                {
+                    fprintf(stderr, "Error: os_quantum must be at least 1\n");
+                    return 2;
+                }
+
+                OS_QUANTUM = quantum;
+            }
+
+            else if (strcasecmp(argv[i], "-os_switch_cost") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-os_switch_cost\n");
+                    return 2;
+                }
+                OS_SWITCH_COST = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-os_flush") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -os_flush\n");
+                    return 2;
+                }
+
+                int flush = atoi(argv[i]);
+                if (flush < 0 || flush > 3)
+                {
+                    fprintf(stderr, "Error: os_flush must be between 0 and "
+                                    "3\n");
+                    return 2;
+                }
+
+                OS_FLUSH = flush;
+            }
+
+            else if (strcasecmp(argv[i], "-analyze") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -analyze\n");
+                    return 2;
+                }
+                ANALYZE_TRACES = atoi(argv[i]) != 0;
+            }
+
+            else if (strcasecmp(argv[i], "-analyze_window") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-analyze_window\n");
+                    return 2;
+                }
+
+                ANALYZE_WINDOW = strtoull(argv[i], NULL, 10);
+                if (ANALYZE_WINDOW < 1)
+                {
+                    fprintf(stderr, "Error: analyze_window must be at least "
+                                    "1\n");
+                    return 2;
+                }
+            }
+
+            else if (strcasecmp(argv[i], "-lat_hist") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -lat_hist\n");
+                    return 2;
+                }
+                LATENCY_HIST = atoi(argv[i]) != 0;
+            }
+
+            else if (strcasecmp(argv[i], "-pc_prof") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -pc_prof\n");
+                    return 2;
+                }
+                PC_PROF_TOP = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-selfprof") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -selfprof\n");
+                    return 2;
+                }
+                SELF_PROF = atoi(argv[i]);
+                if (SELF_PROF > 2)
+                {
+                    fprintf(stderr, "Error: selfprof must be 0, 1 or 2\n");
+                    return 2;
+                }
+            }
+
+            else if (strcasecmp(argv[i], "-selfprof_interval") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-selfprof_interval\n");
+                    return 2;
+                }
+                SELF_PROF_INTERVAL = strtoull(argv[i], NULL, 10);
+                if (SELF_PROF_INTERVAL == 0)
+                {
+                    fprintf(stderr, "Error: selfprof_interval must be at "
+                                    "least 1\n");
+                    return 2;
+                }
+            }
+
+            else if (strcasecmp(argv[i], "-stats_json") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-stats_json\n");
+                    return 2;
+                }
+                STATS_JSON = argv[i];
+            }
+
+            else if (strcasecmp(argv[i], "-stats_csv") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to "
+                                    "-stats_csv\n");
+                    return 2;
+                }
+                STATS_CSV = argv[i];
+            }
+
+            else if (strcasecmp(argv[i], "-stats_interval") == 0 ||
+                     strcasecmp(argv[i], "-stats_interval_inst") == 0)
+            {
+                STATS_INTERVAL_INST =
+                    strcasecmp(argv[i], "-stats_interval_inst") == 0;
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to %s\n",
+                            argv[i - 1]);
+                    return 2;
+                }
+                STATS_INTERVAL = strtoull(argv[i], NULL, 10);
+            }
+
+            else if (strcasecmp(argv[i], "-tlb") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -tlb\n");
+                    return 2;
+                }
+                TLB_ENABLED = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-itlb_entries") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -itlb_entries\n");
+                    return 2;
+                }
+                ITLB_ENTRIES = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-dtlb_entries") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -dtlb_entries\n");
+                    return 2;
+                }
+                DTLB_ENTRIES = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-tlb_assoc") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -tlb_assoc\n");
+                    return 2;
+                }
+                L1TLB_ASSOC = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-stlb_entries") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -stlb_entries\n");
+                    return 2;
+                }
+                STLB_ENTRIES = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-stlb_assoc") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -stlb_assoc\n");
+                    return 2;
+                }
+                STLB_ASSOC = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-pwc_entries") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -pwc_entries\n");
+                    return 2;
+                }
+                PWC_ENTRIES = atoi(argv[i]);
+            }
+
+            else if (strcasecmp(argv[i], "-large_pages") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -large_pages\n");
+                    return 2;
+                }
+                TLB_LARGE_PAGES = (atoi(argv[i]) != 0);
+            }
+
+            else if (strcasecmp(argv[i], "-page_alloc") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -page_alloc\n");
+                    return 2;
+                }
+
+                int page_alloc = atoi(argv[i]);
+                if (page_alloc < 0 || page_alloc > 4)
+                {
+                    fprintf(stderr, "Error: page_alloc must be between 0 and "
+                                    "4\n");
+                    return 2;
+                }
+
+                PAGE_ALLOC_POLICY = (PageAllocPolicy)page_alloc;
+            }
+
+            else if (strcasecmp(argv[i], "-phys_mem_mb") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -phys_mem_mb\n");
+                    return 2;
+                }
+
+                int phys_mem_mb = atoi(argv[i]);
+                if (phys_mem_mb <= 0 || phys_mem_mb > (1 << 20))
+                {
+                    fprintf(stderr, "Error: phys_mem_mb must be between 1 and "
+                                    "1048576\n");
+                    return 2;
+                }
+
+                PHYS_MEM_MB = phys_mem_mb;
+            }
+
+            else
+            {
+                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else
+        {
+            // Parse trace file name.
+            if (num_traces >= SCHEDULER_MAX_TASKS)
+            {
+                fprintf(stderr, "Error: too many trace files specified\n");
+                return 2;
+            }
+
+            trace_filename[num_traces] = argv[i];
+            num_traces++;
+        }
+    }
+
+    if (num_traces == 0)
+    {
+        fprintf(stderr, "Error: no trace file specified\n");
+        return 2;
+    }
+
+    // Only the scheduler and the analyzer take more traces than there are
+    // cores.
+    if (!OS_SCHED && !ANALYZE_TRACES && num_traces > MAX_CORES)
+    {
+        fprintf(stderr, "Error: too many trace files specified\n");
+        return 2;
+    }
+
+    // Without the scheduler, every trace runs on a core of its own.
+    if (OS_CORES && !OS_SCHED)
+    {
+        fprintf(stderr, "Error: cores needs -os_sched 1\n");
+        return 2;
+    }
+    if (OS_SCHED && OS_CORES == 0)
+    {
+        OS_CORES = SCHEDULER_DEFAULT_CORES;
+    }
+    NUM_CORES = OS_SCHED ? OS_CORES : num_traces;
+
+    // The way partitioning policies split a cache between cores 0 and 1.
+    if ((REPL_POLICY == SWP || REPL_POLICY == DWP ||
+         L2CACHE_REPL == SWP || L2CACHE_REPL == DWP) && NUM_CORES > 2)
+    {
+        fprintf(stderr, "Error: SWP and DWP split a cache between two "
+                        "cores\n");
+        return 2;
+    }
+
+    if (ANALYZE_TRACES && CORE_REPLAY)
+    {
+        fprintf(stderr, "Error: the analyzer reads each trace once and "
+                        "cannot replay\n");
+        return 2;
+    }
+
+    if (OS_SCHED &&
+        (SIM_MODE != SIM_MODE_DEF || num_traces < OS_CORES || PARALLEL_SIM ||
+         CORE_ROB_SIZE != 0 || CORE_SB_SIZE != 0))
+    {
+        fprintf(stderr, "Error: the OS scheduler needs mode 4, at least %d "
+                        "traces, and in-order cores\n"
+                        "without store buffers outside the parallel "
+                        "engine\n", OS_CORES);
+        return 2;
+    }
+
+    if (CORE_REPLAY && (PARALLEL_SIM || OS_SCHED))
+    {
+        fprintf(stderr, "Error: replay needs the serial engine without the "
+                        "OS scheduler\n");
+        return 2;
+    }
+
+    if (CORE_INST_TARGET && !CORE_REPLAY)
+    {
+        fprintf(stderr, "Error: inst_target needs -replay 1\n");
+        return 2;
+    }
+
+    if (ALONE_RUNS && (SIM_MODE != SIM_MODE_DEF || OS_SCHED))
+    {
+        fprintf(stderr, "Error: alone runs need mode 4 without the OS "
+                        "scheduler\n");
+        return 2;
+    }
+
+    // The parallel engine learns the delay of a shared access only after the
+    // core has moved on, too late for the histogram.
+    if (LATENCY_HIST && PARALLEL_SIM)
+    {
+        fprintf(stderr, "Error: latency histograms need the serial engine\n");
+        return 2;
+    }
+
+    if (PC_PROF_TOP && PARALLEL_SIM)
+    {
+        fprintf(stderr, "Error: the PC profiler needs the serial engine\n");
+        return 2;
+    }
+
+    if (SELF_PROF && (PARALLEL_SIM || ANALYZE_TRACES))
+    {
+        fprintf(stderr, "Error: self-profiling needs the serial engine\n");
+        return 2;
+    }
+
+    if (STATS_INTERVAL && STATS_JSON == NULL && STATS_CSV == NULL)
+    {
+        fprintf(stderr, "Error: stats intervals need -stats_json or "
+                        "-stats_csv\n");
+        return 2;
+    }
+
+    if (STATS_INTERVAL && OS_SCHED)
+    {
+        fprintf(stderr, "Error: stats intervals do not support the OS "
+                        "scheduler\n");
+        return 2;
+    }
+
+    if (OS_SCHED && (OS_FLUSH & 1) && HIER_CONFIG != NULL)
+    {
+        fprintf(stderr, "Error: os_flush can only flush the L1 caches of the "
+                        "fixed hierarchy\n");
+        return 2;
+    }
+
+    if (L2_DBP_POLICY != DBP_OFF &&
+        (SIM_MODE == SIM_MODE_A || HIER_CONFIG != NULL))
+    {
+        fprintf(stderr, "Error: L2dbp needs the L2 cache of modes 2 to 4 "
+                        "without -hier\n");
+        return 2;
+    }
+
+    if (CORE_ROB_SIZE && (CORE_ISSUE_WIDTH == 0 || CORE_LQ_SIZE == 0))
+    {
+        fprintf(stderr, "Error: width and lq must be at least 1\n");
+        return 2;
+    }
+
+    if ((quantum_given || lockstep_given) && !PARALLEL_SIM)
+    {
+        fprintf(stderr, "Error: quantum and lockstep need -parallel 1\n");
+        return 2;
+    }
+
+    if (quantum_given && lockstep_given)
+    {
+        fprintf(stderr, "Error: give either -quantum or -lockstep, not "
+                        "both\n");
+        return 2;
+    }
+
+    if (PARALLEL_SIM &&
+        (SIM_MODE != SIM_MODE_DEF || HIER_CONFIG != NULL || TLB_ENABLED ||
+         PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED || CORE_ROB_SIZE != 0 ||
+         CORE_SB_SIZE != 0 || REPL_POLICY == RANDOM))
+    {
+        fprintf(stderr, "Error: parallel simulation needs mode 4 with the "
+                        "fixed hierarchy, in-order cores\n"
+                        "without store buffers, no TLBs or page allocator, "
+                        "and no random L1 replacement\n");
+        return 2;
+    }
+
+    // Only mode 4 translates virtual addresses, with or without -hier.
+    if (PAGE_ALLOC_POLICY != PAGE_ALLOC_FIXED && SIM_MODE != SIM_MODE_DEF)
+    {
+        fprintf(stderr, "Error: page_alloc needs mode 4\n");
+        return 2;
+    }
+
+    if (TLB_ENABLED && SIM_MODE != SIM_MODE_DEF)
+    {
+        fprintf(stderr, "Error: TLBs need mode 4\n");
+        return 2;
+    }
+
+    if (TLB_LARGE_PAGES && !TLB_ENABLED)
+    {
+        fprintf(stderr, "Error: large_pages needs -tlb 1\n");
+        return 2;
+    }
+
+    if (TLB_ENABLED &&
+        (L1TLB_ASSOC == 0 || STLB_ASSOC == 0 ||
+         ITLB_ENTRIES == 0 || ITLB_ENTRIES % L1TLB_ASSOC != 0 ||
+         DTLB_ENTRIES == 0 || DTLB_ENTRIES % L1TLB_ASSOC != 0 ||
+         STLB_ENTRIES == 0 || STLB_ENTRIES % STLB_ASSOC != 0))
+    {
+        fprintf(stderr, "Error: TLB entries must be a nonzero multiple of "
+                        "the associativity\n");
+        return 2;
+    }
+
+    if (DRAM_SCHEDULER != SCHED_NONE &&
+        SIM_MODE != SIM_MODE_C && SIM_MODE != SIM_MODE_DEF)
+    {
+        fprintf(stderr, "Error: dram_sched needs the DRAM model of mode 3 "
+                        "or 4\n");
+        return 2;
+    }
+
+    // Refresh is modeled by the controllers, which block the ranks it covers.
+    if (DRAM_REFRESH != REFRESH_OFF && DRAM_SCHEDULER == SCHED_NONE)
+    {
+        fprintf(stderr, "Error: dram_refresh needs -dram_sched\n");
+        return 2;
+    }
+
+    if (DRAM_REFRESH_AWARE && DRAM_REFRESH == REFRESH_OFF)
+    {
+        fprintf(stderr, "Error: dram_refresh_aware needs -dram_refresh\n");
+        return 2;
+    }
+
+    if (DRAM_BANK_GROUPS > DRAM_MAX_BANK_GROUPS)
+    {
+        fprintf(stderr, "Error: dram_bankgroups must be at most %d\n",
+                DRAM_MAX_BANK_GROUPS);
+        return 2;
+    }
+
+    // Only the controllers queue writes to drain.
+    if ((DRAM_WQ_HIGH > 0 || DRAM_WQ_LOW > 0) && DRAM_SCHEDULER == SCHED_NONE)
+    {
+        fprintf(stderr, "Error: dram_wq_high and dram_wq_low need "
+                        "-dram_sched\n");
+        return 2;
+    }
+
+    if (DRAM_WQ_LOW > 0 && DRAM_WQ_HIGH == 0)
+    {
+        fprintf(stderr, "Error: dram_wq_low needs -dram_wq_high\n");
+        return 2;
+    }
+
+    if (DRAM_WQ_HIGH > 0 && DRAM_WQ_LOW >= DRAM_WQ_HIGH)
+    {
+        fprintf(stderr, "Error: dram_wq_low must be below dram_wq_high\n");
+        return 2;
+    }
+
+    if (!dram_map_valid(DRAM_ADDR_MAP))
+    {
+        fprintf(stderr, "Error: invalid DRAM address mapping %s\n",
+                DRAM_ADDR_MAP);
+        return 2;
+    }
+
+    return 0;
+}
+
+void print_dots()
+{
+    unsigned int LINE_INTERVAL = 50 * DOT_INTERVAL;
+    last_printdot_cycle = current_cycle;
+
+    if (!PRINT_DOTS)
+    {
+        return;
+    }
+
+    if (current_cycle % LINE_INTERVAL == 0)
+    {
+        if (current_cycle != 0)
+        {
+            printf("\n");
+        }
+        printf("%4llu M\t", (unsigned long long)current_cycle / 1000000);
+        fflush(stdout);
+    }
+    else
+    {
+        printf(".");
+        fflush(stdout);
+    }
+}
+
+void print_stats()
+{
+    printf("\n\n");
+    printf("CYCLES              \t\t : %10llu\n",
+           (unsigned long long)current_cycle);
+
+    if (scheduler != NULL)
+    {
+        scheduler_print_stats(scheduler);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            core_print_stats(core[i]);
+        }
+    }
+
+    if (fairness != NULL)
+    {
+        fairness_print_stats(fairness, core);
+    }
+
+    memsys_print_stats(memsys);
+    memsys_print_hist_stats(memsys);
+
+    if (memsys->pc_prof != NULL)
+    {
+        pcprof_print_stats(memsys->pc_prof, PC_PROF_TOP);
+    }
+
+    if (selfprof != NULL)
+    {
+        selfprof_print_stats(selfprof);
+    }
+}
+
+void write_stats()
+{
+    if (STATS_JSON == NULL && STATS_CSV == NULL)
+    {
+        return;
+    }
+
+    StatsRegistry *reg = stats_new();
+    stats_add_count(reg, NULL, "CYCLES", current_cycle);
+    if (scheduler != NULL)
+    {
+        scheduler_collect_stats(scheduler, reg);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < NUM_CORES; i++)
+        {
+            core_collect_stats(core[i], reg);
+        }
+    }
+    if (fairness != NULL)
+    {
+        fairness_collect_stats(fairness, core, reg);
+    }
+    memsys_collect_stats(memsys, reg);
+    if (selfprof != NULL)
+    {
+        selfprof_collect_stats(selfprof, reg);
+    }
+
+    if (sampler != NULL)
+    {
+        stats_sample_final(sampler);
+    }
+    if (STATS_JSON != NULL)
+    {
+        stats_write_json(STATS_JSON, reg, sampler);
+    }
+    if (STATS_CSV != NULL)
+    {
+        stats_write_csv(STATS_CSV, reg, sampler);
+    }
+}
+
+void print_usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-option <value>] trace_0 <trace_1 ...>\n",
+            program_name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Trace driven memory system simulator\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "    -mode <num>             Set mode of the simulator "
+                    "[1: part A, 2: part B,\n");
+    fprintf(stderr, "                            3: part C, 4: part D/E/F] "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -linesize <num>         Set cache line size in bytes "
+                    "for all caches\n");
+    fprintf(stderr, "                            (default: 64)\n");
     fprintf(stderr, "    -repl <num>             Set replacement policy for "
                     "L1 cache [0: LRU,\n");
     fprintf(stderr, "                            1: random, 2: SWP, 3: DWP] "
@@ -378,7 +1771,195 @@ void print_usage(const char *program_name)
                     "(default: 0)\n");
     fprintf(stderr, "    -SWP_core0ways <num>    Set static quota for core 0 "
                     "in SWP (default: 1)\n");
+    fprintf(stderr, "    -L2dbp <num>            Set handling of L2 fills "
+                    "predicted dead by the\n");
+    fprintf(stderr, "                            PC-based predictor [0: off, "
+                    "1: bypass,\n");
+    fprintf(stderr, "                            2: insert at LRU] "
+                    "(default: 0)\n");
     fprintf(stderr, "    -dram_policy <num>      Set DRAM page policy "
-                    "[0: open-page, 1: close-page]\n");
+                    "[0: open-page, 1: close-page,\n");
+    fprintf(stderr, "                            2: idle timeout, 3: "
+                    "row-hit predictor,\n");
+    fprintf(stderr, "                            4: open-adaptive] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -dram_timeout <num>     Set idle cycles before a row "
+                    "is closed in policy 2\n");
+    fprintf(stderr, "                            (default: 200)\n");
+    fprintf(stderr, "    -dram_page_cap <num>    Set most accesses to a row "
+                    "before it is closed\n");
+    fprintf(stderr, "                            in policy 4 (default: 4)\n");
+    fprintf(stderr, "    -dram_sched <num>       Set DRAM controller "
+                    "scheduler [0: none, 1: FCFS,\n");
+    fprintf(stderr, "                            2: FR-FCFS, 3: FR-FCFS-Cap] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -dram_cap <num>         Set row hits allowed ahead of "
+                    "an older request\n");
+    fprintf(stderr, "                            in FR-FCFS-Cap (default: 4)\n");
+    fprintf(stderr, "    -dram_wq_high <num>     Drain DRAM writes once this "
+                    "many are waiting\n");
+    fprintf(stderr, "                            per channel (default: 0, "
+                    "no write queueing)\n");
+    fprintf(stderr, "    -dram_wq_low <num>      Stop a write drain at this "
+                    "many waiting writes\n");
+    fprintf(stderr, "                            (default: 0)\n");
+    fprintf(stderr, "    -dram_refresh <num>     Set DRAM refresh with a "
+                    "scheduler [0: off,\n");
+    fprintf(stderr, "                            1: all-bank, 2: same-bank] "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -dram_refresh_aware <0|1>  Postpone refreshes while "
+                    "busy and pull them\n");
+    fprintf(stderr, "                            in while idle (default: 0)\n");
+    fprintf(stderr, "    -dram_preset <name>     Set DRAM timings [lab, "
+                    "DDR4-2400, DDR4-3200,\n");
+    fprintf(stderr, "                            DDR5-4800] (default: lab)\n");
+    fprintf(stderr, "    -cpu_mhz <num>          Set CPU clock used to convert "
+                    "DRAM timings\n");
+    fprintf(stderr, "                            (default: 3200)\n");
+    fprintf(stderr, "    -dram_channels <num>    Set number of DRAM channels "
+                    "(default: 1)\n");
+    fprintf(stderr, "    -dram_ranks <num>       Set number of ranks per "
+                    "channel (default: 1)\n");
+    fprintf(stderr, "    -dram_bankgroups <num>  Set number of bank groups "
+                    "per rank (default: 4)\n");
+    fprintf(stderr, "    -dram_banks <num>       Set number of banks per "
+                    "bank group (default: 4)\n");
+    fprintf(stderr, "    -dram_rowsize <num>     Set DRAM row buffer size in "
+                    "bytes (default: 1024)\n");
+    fprintf(stderr, "    -dram_map <string>      Set DRAM address mapping, "
+                    "most significant first,\n");
+    fprintf(stderr, "                            from Ro, Ch, Ra, Bg, Ba, Co "
+                    "(default: RoChRaBaCo)\n");
+    fprintf(stderr, "    -dram_xor <0|1>         XOR bank index with low row "
+                    "bits (default: 0)\n");
+    fprintf(stderr, "    -dram_bus <0|1>         Serialize transfers on the "
+                    "data bus without a\n");
+    fprintf(stderr, "                            scheduler (default: 0)\n");
+    fprintf(stderr, "    -dram_energy <0|1>      Report DRAM energy and power "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -dram_powerdown <num>   Power down DRAM ranks idle "
+                    "for this many cycles,\n");
+    fprintf(stderr, "                            or 0 for never (default: 0)\n");
+    fprintf(stderr, "    -dram_stats <0|1>       Print per-bank, per-core and "
+                    "bank parallelism\n");
+    fprintf(stderr, "                            DRAM statistics (default: 0)\n");
+    fprintf(stderr, "    -dram_interval <num>    Sample DRAM bandwidth every "
+                    "this many cycles,\n");
+    fprintf(stderr, "                            or 0 for never (default: 0)\n");
+    fprintf(stderr, "    -hier <file>            Build the cache hierarchy "
+                    "from a configuration\n");
+    fprintf(stderr, "                            file instead of the mode "
+                    "(see configs/)\n");
+    fprintf(stderr, "    -rob <num>              Use an out-of-order core "
+                    "with this many ROB\n");
+    fprintf(stderr, "                            entries, or 0 for in-order "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -width <num>            Set out-of-order dispatch "
+                    "and retire width\n");
+    fprintf(stderr, "                            (default: 4)\n");
+    fprintf(stderr, "    -lq <num>               Set out-of-order load queue "
+                    "size (default: 32)\n");
+    fprintf(stderr, "    -sb <num>               Set store buffer entries, or "
+                    "0 for none (default: 0)\n");
+    fprintf(stderr, "    -tlb <0|1>              Translate through TLBs and "
+                    "page walks in mode 4\n");
     fprintf(stderr, "                            (default: 0)\n");
+    fprintf(stderr, "    -itlb_entries <num>     Set entries of each L1 ITLB "
+                    "(default: 64)\n");
+    fprintf(stderr, "    -dtlb_entries <num>     Set entries of each L1 DTLB "
+                    "(default: 64)\n");
+    fprintf(stderr, "    -tlb_assoc <num>        Set associativity of the L1 "
+                    "TLBs (default: 4)\n");
+    fprintf(stderr, "    -stlb_entries <num>     Set entries of the shared L2 "
+                    "TLB (default: 1536)\n");
+    fprintf(stderr, "    -stlb_assoc <num>       Set associativity of the L2 "
+                    "TLB (default: 12)\n");
+    fprintf(stderr, "    -pwc_entries <num>      Set entries of each page-walk "
+                    "cache, or 0 for none\n");
+    fprintf(stderr, "                            (default: 32)\n");
+    fprintf(stderr, "    -large_pages <0|1>      Use 2 MB pages instead of "
+                    "4 KB (default: 0)\n");
+    fprintf(stderr, "    -page_alloc <num>       Set page allocation in mode 4 "
+                    "[0: fixed,\n");
+    fprintf(stderr, "                            1: first-touch sequential, "
+                    "2: random,\n");
+    fprintf(stderr, "                            3: page coloring, 4: bank "
+                    "partitioning] (default: 0)\n");
+    fprintf(stderr, "    -phys_mem_mb <num>      Set physical memory size for "
+                    "page allocation\n");
+    fprintf(stderr, "                            (default: 16384)\n");
+    fprintf(stderr, "    -parallel <0|1>         Run each core and its L1 "
+                    "caches on its own thread\n");
+    fprintf(stderr, "                            in mode 4 (default: 0)\n");
+    fprintf(stderr, "    -quantum <num>          Set cycles between parallel "
+                    "barriers (default: 1000)\n");
+    fprintf(stderr, "    -lockstep <0|1>         Synchronize parallel cores "
+                    "every cycle, matching\n");
+    fprintf(stderr, "                            the serial simulation "
+                    "exactly (default: 0)\n");
+    fprintf(stderr, "    -replay <0|1>           Replay finished traces until "
+                    "every core reaches its\n");
+    fprintf(stderr, "                            target, freezing its "
+                    "statistics there (default: 0)\n");
+    fprintf(stderr, "    -inst_target <num>      Set instructions each core "
+                    "retires in replay mode,\n");
+    fprintf(stderr, "                            or 0 for its trace length "
+                    "(default: 0)\n");
+    fprintf(stderr, "    -alone <0|1>            Also run each trace alone "
+                    "and report weighted\n");
+    fprintf(stderr, "                            and harmonic speedup and "
+                    "max slowdown (default: 0)\n");
+    fprintf(stderr, "    -os_sched <0|1>         Time-slice up to %d traces "
+                    "across the cores\n", SCHEDULER_MAX_TASKS);
+    fprintf(stderr, "                            in mode 4 (default: 0)\n");
+    fprintf(stderr, "    -cores <num>            Set cores the OS scheduler "
+                    "runs the traces on\n");
+    fprintf(stderr, "                            (default: %d, at most %d)\n",
+                    SCHEDULER_DEFAULT_CORES, MAX_CORES);
+    fprintf(stderr, "    -os_quantum <num>       Set cycles a trace runs "
+                    "before it may be\n");
+    fprintf(stderr, "                            preempted (default: "
+                    "1000000)\n");
+    fprintf(stderr, "    -os_switch_cost <num>   Set cycles a context switch "
+                    "stalls the core\n");
+    fprintf(stderr, "                            (default: 5000)\n");
+    fprintf(stderr, "    -os_flush <num>         Flush on a context switch "
+                    "[0: nothing,\n");
+    fprintf(stderr, "                            1: L1 caches, 2: TLBs, "
+                    "3: both] (default: 0)\n");
+    fprintf(stderr, "    -analyze <0|1>          Report the footprint, reuse "
+                    "distances and working\n");
+    fprintf(stderr, "                            sets of up to %d traces "
+                    "instead of simulating\n", SCHEDULER_MAX_TASKS);
+    fprintf(stderr, "                            them (default: 0)\n");
+    fprintf(stderr, "    -analyze_window <num>   Set instructions per "
+                    "working set window\n");
+    fprintf(stderr, "                            (default: 1000000)\n");
+    fprintf(stderr, "    -lat_hist <0|1>         Report p50/p90/p99/p99.9 "
+                    "and max delays per core\n");
+    fprintf(stderr, "                            and access type and of "
+                    "DRAM (default: 0)\n");
+    fprintf(stderr, "    -pc_prof <num>          Report the num PCs whose "
+                    "accesses stall the\n");
+    fprintf(stderr, "                            most (default: 0, off)\n");
+    fprintf(stderr, "    -selfprof <0|1|2>       Report the simulator's own "
+                    "speed and where its\n");
+    fprintf(stderr, "                            time goes [1: timing, 2: "
+                    "also hardware\n");
+    fprintf(stderr, "                            counters] (default: 0)\n");
+    fprintf(stderr, "    -selfprof_interval <num>\n");
+    fprintf(stderr, "                            Set cycles per self-profiling "
+                    "interval\n");
+    fprintf(stderr, "                            (default: 1000000)\n");
+    fprintf(stderr, "    -stats_json <file>      Also write the statistics "
+                    "to a JSON file\n");
+    fprintf(stderr, "    -stats_csv <file>       Also write the statistics "
+                    "to a CSV file\n");
+    fprintf(stderr, "    -stats_interval <num>   Record IPC, MPKI and DRAM "
+                    "bandwidth every num\n");
+    fprintf(stderr, "                            cycles in those files "
+                    "(default: 0, off)\n");
+    fprintf(stderr, "    -stats_interval_inst <num>\n");
+    fprintf(stderr, "                            Record them every num "
+                    "instructions instead\n");
 }
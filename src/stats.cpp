@@ -0,0 +1,386 @@
+// stats.cpp
+// Defines the functions used to implement the statistics registry and the
+// interval sampler.
+
+#include "stats.h"
+#include "core.h"
+#include "memsys.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The initial number of entries of a registry. */
+#define STATS_INITIAL_ENTRIES 64
+
+///////////////////////////////////////////////////////////////////////////////
+//                    EXTERNALLY DEFINED GLOBAL VARIABLES                    //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The current clock cycle number of this thread. */
+extern thread_local uint64_t current_cycle;
+
+/** The number of bytes in a cache line. */
+extern uint64_t CACHE_LINESIZE;
+
+/** The CPU clock frequency in MHz. */
+extern unsigned int CPU_FREQ_MHZ;
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize an empty registry.
+ *
+ * @return A pointer to the registry.
+ */
+StatsRegistry *stats_new()
+{
+    return (StatsRegistry *)calloc(1, sizeof(StatsRegistry));
+}
+
+/**
+ * Append an entry to a registry, growing it if needed.
+ *
+ * @param reg The registry.
+ * @param prefix The prefix of the name, or NULL.
+ * @param name The name, which follows the prefix and an underscore.
+ * @return The new entry.
+ */
+static StatsEntry *stats_append(StatsRegistry *reg, const char *prefix,
+                                const char *name)
+{
+    if (reg->num_entries == reg->capacity)
+    {
+        reg->capacity = reg->capacity ? reg->capacity * 2
+                                      : STATS_INITIAL_ENTRIES;
+        reg->entries = (StatsEntry *)realloc(
+            reg->entries, reg->capacity * sizeof(StatsEntry));
+    }
+
+    StatsEntry *e = &reg->entries[reg->num_entries++];
+    memset(e, 0, sizeof(StatsEntry));
+    if (prefix != NULL)
+    {
+        snprintf(e->name, sizeof(e->name), "%s_%s", prefix, name);
+    }
+    else
+    {
+        snprintf(e->name, sizeof(e->name), "%s", name);
+    }
+    return e;
+}
+
+/**
+ * Add a count to a registry.
+ *
+ * @param reg The registry.
+ * @param prefix The prefix of the name, e.g. the label of a cache, or NULL.
+ * @param name The name, which follows the prefix and an underscore.
+ * @param count The value.
+ */
+void stats_add_count(StatsRegistry *reg, const char *prefix, const char *name,
+                     unsigned long long count)
+{
+    stats_append(reg, prefix, name)->count = count;
+}
+
+/**
+ * Add a real number to a registry.
+ *
+ * @param reg The registry.
+ * @param prefix The prefix of the name, e.g. the label of a cache, or NULL.
+ * @param name The name, which follows the prefix and an underscore.
+ * @param real The value.
+ */
+void stats_add_real(StatsRegistry *reg, const char *prefix, const char *name,
+                    double real)
+{
+    StatsEntry *e = stats_append(reg, prefix, name);
+    e->is_real = true;
+    e->real = real;
+}
+
+/**
+ * Find the total number of misses of a cache.
+ *
+ * @param c The cache.
+ * @return Its read and write misses.
+ */
+static unsigned long long stats_cache_misses(Cache *c)
+{
+    return c->stat_read_miss + c->stat_write_miss;
+}
+
+/**
+ * Find the number of lines DRAM has read and written.
+ *
+ * @param sys The memory system.
+ * @return The lines transferred, or 0 if there is no DRAM.
+ */
+static unsigned long long stats_dram_lines(MemorySystem *sys)
+{
+    if (sys->dram == NULL)
+    {
+        return 0;
+    }
+    return sys->dram->stat_read_access + sys->dram->stat_write_access;
+}
+
+/**
+ * Allocate and initialize a sampler, which takes a snapshot at the end of
+ * every interval.
+ *
+ * @param sys The memory system of the run.
+ * @param cores The core slots of the run.
+ * @param num_cores The number of cores.
+ * @param period The length of an interval.
+ * @param by_inst Whether the period counts instructions of all cores
+ *                rather than cycles.
+ * @return A pointer to the sampler.
+ */
+StatsSampler *stats_sampler_new(MemorySystem *sys, Core **cores,
+                                unsigned int num_cores, uint64_t period,
+                                bool by_inst)
+{
+    StatsSampler *s = (StatsSampler *)calloc(1, sizeof(StatsSampler));
+    s->sys = sys;
+    s->cores = cores;
+    s->num_cores = num_cores;
+    s->period = period;
+    s->by_inst = by_inst;
+    s->next = period;
+    return s;
+}
+
+/**
+ * Record a snapshot of the interval since the last one.
+ *
+ * The MPKI of a private cache is relative to the instructions of its core,
+ * and that of a shared cache to the instructions of all cores.
+ *
+ * @param s The sampler.
+ */
+static void stats_snapshot(StatsSampler *s)
+{
+    if (s->num_intervals == s->capacity)
+    {
+        s->capacity = s->capacity ? s->capacity * 2 : STATS_INITIAL_ENTRIES;
+        s->intervals = (StatsRegistry *)realloc(
+            s->intervals, s->capacity * sizeof(StatsRegistry));
+    }
+    StatsRegistry *reg = &s->intervals[s->num_intervals++];
+    memset(reg, 0, sizeof(StatsRegistry));
+
+    uint64_t cycles = current_cycle - s->last_cycle;
+    unsigned long long inst[MAX_CORES];
+    unsigned long long total_inst = 0;
+    stats_add_count(reg, NULL, "CYCLE", current_cycle);
+
+    char prefix[STATS_NAME_LEN];
+    for (unsigned int i = 0; i < s->num_cores; i++)
+    {
+        inst[i] = s->cores[i]->inst_count - s->last_inst[i];
+        s->last_inst[i] = s->cores[i]->inst_count;
+        total_inst += inst[i];
+
+        double ipc = cycles ? (double)(inst[i]) / (double)(cycles) : 0.0;
+        snprintf(prefix, sizeof(prefix), "CORE_%u", i);
+        stats_add_count(reg, prefix, "INST", inst[i]);
+        stats_add_real(reg, prefix, "IPC", ipc);
+    }
+
+    MemsysCache caches[STATS_MAX_CACHES];
+    unsigned int num_caches = memsys_list_caches(s->sys, caches);
+    for (unsigned int i = 0; i < num_caches; i++)
+    {
+        unsigned long long misses = stats_cache_misses(caches[i].cache);
+        unsigned long long owner_inst = (caches[i].owner < s->num_cores)
+                                            ? inst[caches[i].owner]
+                                            : total_inst;
+        double mpki = 0.0;
+        if (owner_inst)
+        {
+            mpki = 1000.0 * (double)(misses - s->last_misses[i]) /
+                   (double)(owner_inst);
+        }
+        s->last_misses[i] = misses;
+        stats_add_real(reg, caches[i].name, "MPKI", mpki);
+    }
+
+    if (s->sys->dram != NULL)
+    {
+        // Bytes per cycle times millions of cycles per second, in GB/s.
+        unsigned long long lines = stats_dram_lines(s->sys);
+        double bandwidth = 0.0;
+        if (cycles)
+        {
+            bandwidth = (double)((lines - s->last_dram_lines) *
+                                 CACHE_LINESIZE) /
+                        (double)(cycles) * CPU_FREQ_MHZ / 1000.0;
+        }
+        s->last_dram_lines = lines;
+        stats_add_real(reg, NULL, "DRAM_BW_GBPS", bandwidth);
+    }
+
+    s->last_cycle = current_cycle;
+}
+
+/**
+ * Take a snapshot if the current interval has ended.
+ *
+ * @param s The sampler.
+ */
+void stats_sample(StatsSampler *s)
+{
+    uint64_t progress = current_cycle;
+    if (s->by_inst)
+    {
+        progress = 0;
+        for (unsigned int i = 0; i < s->num_cores; i++)
+        {
+            progress += s->cores[i]->inst_count;
+        }
+    }
+
+    if (progress >= s->next)
+    {
+        stats_snapshot(s);
+        s->next = progress - progress % s->period + s->period;
+    }
+}
+
+/**
+ * Take a snapshot of the last, partial interval, if it is not empty.
+ *
+ * @param s The sampler.
+ */
+void stats_sample_final(StatsSampler *s)
+{
+    if (current_cycle > s->last_cycle)
+    {
+        stats_snapshot(s);
+    }
+}
+
+/**
+ * Write the entries of a registry as the members of a JSON object.
+ *
+ * @param file The file to write to.
+ * @param reg The registry.
+ * @param indent The indentation of the members.
+ */
+static void stats_write_json_members(FILE *file, StatsRegistry *reg,
+                                     const char *indent)
+{
+    for (unsigned int i = 0; i < reg->num_entries; i++)
+    {
+        StatsEntry *e = &reg->entries[i];
+        const char *sep = (i + 1 < reg->num_entries) ? "," : "";
+        if (e->is_real)
+        {
+            fprintf(file, "%s\"%s\": %.6f%s\n", indent, e->name, e->real, sep);
+        }
+        else
+        {
+            fprintf(file, "%s\"%s\": %llu%s\n", indent, e->name, e->count,
+                    sep);
+        }
+    }
+}
+
+/**
+ * Write the statistics of a run and its interval snapshots as JSON.
+ *
+ * @param filename The file to write.
+ * @param reg The statistics of the run.
+ * @param s The sampler, or NULL if there are no snapshots.
+ * @return Whether the file was written.
+ */
+bool stats_write_json(const char *filename, StatsRegistry *reg,
+                      StatsSampler *s)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        perror("Couldn't write JSON statistics");
+        return false;
+    }
+
+    fprintf(file, "{\n  \"stats\": {\n");
+    stats_write_json_members(file, reg, "    ");
+    fprintf(file, "  },\n  \"intervals\": [");
+    for (unsigned int i = 0; s != NULL && i < s->num_intervals; i++)
+    {
+        fprintf(file, "%s\n    {\n", i ? "," : "");
+        stats_write_json_members(file, &s->intervals[i], "      ");
+        fprintf(file, "    }");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    fclose(file);
+    return true;
+}
+
+/**
+ * Write the entries of a registry as CSV rows.
+ *
+ * @param file The file to write to.
+ * @param reg The registry.
+ * @param interval The value of the interval column.
+ * @param cycle The value of the cycle column.
+ */
+static void stats_write_csv_rows(FILE *file, StatsRegistry *reg,
+                                 const char *interval, uint64_t cycle)
+{
+    for (unsigned int i = 0; i < reg->num_entries; i++)
+    {
+        StatsEntry *e = &reg->entries[i];
+        if (e->is_real)
+        {
+            fprintf(file, "%s,%llu,%s,%.6f\n", interval,
+                    (unsigned long long)cycle, e->name, e->real);
+        }
+        else
+        {
+            fprintf(file, "%s,%llu,%s,%llu\n", interval,
+                    (unsigned long long)cycle, e->name, e->count);
+        }
+    }
+}
+
+/**
+ * Write the statistics of a run and its interval snapshots as CSV.
+ *
+ * @param filename The file to write.
+ * @param reg The statistics of the run.
+ * @param s The sampler, or NULL if there are no snapshots.
+ * @return Whether the file was written.
+ */
+bool stats_write_csv(const char *filename, StatsRegistry *reg,
+                     StatsSampler *s)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        perror("Couldn't write CSV statistics");
+        return false;
+    }
+
+    fprintf(file, "interval,cycle,name,value\n");
+    stats_write_csv_rows(file, reg, "total", current_cycle);
+    for (unsigned int i = 0; s != NULL && i < s->num_intervals; i++)
+    {
+        char interval[16];
+        snprintf(interval, sizeof(interval), "%u", i);
+        stats_write_csv_rows(file, &s->intervals[i], interval,
+                             s->intervals[i].entries[0].count);
+    }
+
+    fclose(file);
+    return true;
+}
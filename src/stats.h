@@ -0,0 +1,165 @@
+// stats.h
+// Declares the statistics registry, which holds the results of a run for
+// machine-readable output, and the sampler of per-interval statistics.
+//
+// Each module adds its statistics to a registry with a *_collect_stats()
+// function next to its *_print_stats() function, under the names of the
+// text report. The registry is then written as JSON or CSV along with the
+// interval snapshots, which capture the IPC of each core, the misses per
+// kilo-instruction (MPKI) of each cache and the DRAM bandwidth every so many
+// cycles or instructions.
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 CONSTANTS                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/** The maximum length of a statistic's name, including the terminator. */
+#define STATS_NAME_LEN 48
+
+/**
+ * The maximum number of caches the sampler tracks, enough for every cache of
+ * a hierarchy (HIER_MAX_CACHES in hierarchy.h).
+ */
+#define STATS_MAX_CACHES (8 * MAX_CORES * 2)
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A single named statistic, either a count or a real number. */
+typedef struct StatsEntry
+{
+    char name[STATS_NAME_LEN];
+    bool is_real;
+    unsigned long long count;
+    double real;
+} StatsEntry;
+
+/** An ordered, growable list of statistics. */
+typedef struct StatsRegistry
+{
+    StatsEntry *entries;
+    unsigned int num_entries;
+    unsigned int capacity;
+} StatsRegistry;
+
+/** The interval snapshots of a run. */
+typedef struct StatsSampler
+{
+    struct MemorySystem *sys;
+    struct Core **cores;
+    unsigned int num_cores;
+
+    /** The length of an interval, in cycles or in instructions of all cores. */
+    uint64_t period;
+    bool by_inst;
+
+    /** The cycle or instruction count at which the next snapshot is due. */
+    uint64_t next;
+
+    /** The counts at the last snapshot, from which intervals are measured. */
+    uint64_t last_cycle;
+    unsigned long long last_inst[MAX_CORES];
+    unsigned long long last_misses[STATS_MAX_CACHES];
+    unsigned long long last_dram_lines;
+
+    /** The snapshots taken so far, one registry each. */
+    StatsRegistry *intervals;
+    unsigned int num_intervals;
+    unsigned int capacity;
+} StatsSampler;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize an empty registry.
+ *
+ * @return A pointer to the registry.
+ */
+StatsRegistry *stats_new();
+
+/**
+ * Add a count to a registry.
+ *
+ * @param reg The registry.
+ * @param prefix The prefix of the name, e.g. the label of a cache, or NULL.
+ * @param name The name, which follows the prefix and an underscore.
+ * @param count The value.
+ */
+void stats_add_count(StatsRegistry *reg, const char *prefix, const char *name,
+                     unsigned long long count);
+
+/**
+ * Add a real number to a registry.
+ *
+ * @param reg The registry.
+ * @param prefix The prefix of the name, e.g. the label of a cache, or NULL.
+ * @param name The name, which follows the prefix and an underscore.
+ * @param real The value.
+ */
+void stats_add_real(StatsRegistry *reg, const char *prefix, const char *name,
+                    double real);
+
+/**
+ * Allocate and initialize a sampler, which takes a snapshot at the end of
+ * every interval.
+ *
+ * @param sys The memory system of the run.
+ * @param cores The core slots of the run.
+ * @param num_cores The number of cores.
+ * @param period The length of an interval.
+ * @param by_inst Whether the period counts instructions of all cores
+ *                rather than cycles.
+ * @return A pointer to the sampler.
+ */
+StatsSampler *stats_sampler_new(struct MemorySystem *sys, struct Core **cores,
+                                unsigned int num_cores, uint64_t period,
+                                bool by_inst);
+
+/**
+ * Take a snapshot if the current interval has ended.
+ *
+ * @param s The sampler.
+ */
+void stats_sample(StatsSampler *s);
+
+/**
+ * Take a snapshot of the last, partial interval, if it is not empty.
+ *
+ * @param s The sampler.
+ */
+void stats_sample_final(StatsSampler *s);
+
+/**
+ * Write the statistics of a run and its interval snapshots as JSON, as an
+ * object with a "stats" object and an "intervals" array of objects.
+ *
+ * @param filename The file to write.
+ * @param reg The statistics of the run.
+ * @param s The sampler, or NULL if there are no snapshots.
+ * @return Whether the file was written.
+ */
+bool stats_write_json(const char *filename, StatsRegistry *reg,
+                      StatsSampler *s);
+
+/**
+ * Write the statistics of a run and its interval snapshots as CSV, one
+ * statistic per row with the columns interval, cycle, name and value. The
+ * statistics of the run have the interval "total".
+ *
+ * @param filename The file to write.
+ * @param reg The statistics of the run.
+ * @param s The sampler, or NULL if there are no snapshots.
+ * @return Whether the file was written.
+ */
+bool stats_write_csv(const char *filename, StatsRegistry *reg,
+                     StatsSampler *s);
+
+#endif // __STATS_H__
@@ -0,0 +1,181 @@
+// tlb.cpp
+// Defines the functions used to implement the translation lookaside buffers
+// and page-walk caches.
+
+#include "tlb.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//                           FUNCTION DEFINITIONS                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a TLB.
+ *
+ * @param entries The total number of entries.
+ * @param assoc The associativity. Equal to entries for a fully associative
+ *              TLB.
+ * @return A pointer to the TLB.
+ */
+TLB *tlb_new(uint64_t entries, uint64_t assoc)
+{
+    TLB *t = (TLB *)calloc(1, sizeof(TLB));
+    t->num_ways = assoc;
+    t->num_sets = entries / assoc;
+    t->entries = (TLBEntry *)calloc(entries, sizeof(TLBEntry));
+    return t;
+}
+
+/**
+ * Find the entry holding the translation of a page.
+ *
+ * @param t The TLB to look in.
+ * @param page The page number to translate.
+ * @param asid The address space the page belongs to.
+ * @return The entry, or NULL if the translation is not present.
+ */
+static TLBEntry *tlb_find(TLB *t, uint64_t page, unsigned int asid)
+{
+    TLBEntry *set = &t->entries[(page % t->num_sets) * t->num_ways];
+    for (uint64_t w = 0; w < t->num_ways; w++)
+    {
+        if (set[w].valid && set[w].page == page && set[w].asid == asid)
+        {
+            return &set[w];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Look up the translation of a page, updating the LRU state on a hit.
+ *
+ * @param t The TLB to look in.
+ * @param page The page number to translate.
+ * @param asid The address space the page belongs to.
+ * @return Whether the translation was found.
+ */
+bool tlb_lookup(TLB *t, uint64_t page, unsigned int asid)
+{
+    t->stat_access++;
+
+    TLBEntry *entry = tlb_find(t, page, asid);
+    if (entry == NULL)
+    {
+        t->stat_miss++;
+        return false;
+    }
+
+    entry->last_access = ++t->clock;
+    return true;
+}
+
+/**
+ * Install the translation of a page, replacing the LRU entry of its set.
+ *
+ * @param t The TLB to install into.
+ * @param page The page number to install.
+ * @param asid The address space the page belongs to.
+ */
+void tlb_install(TLB *t, uint64_t page, unsigned int asid)
+{
+    TLBEntry *set = &t->entries[(page % t->num_sets) * t->num_ways];
+    TLBEntry *victim = &set[0];
+    for (uint64_t w = 0; w < t->num_ways; w++)
+    {
+        if (!set[w].valid)
+        {
+            victim = &set[w];
+            break;
+        }
+        if (set[w].last_access < victim->last_access)
+        {
+            victim = &set[w];
+        }
+    }
+
+    victim->valid = true;
+    victim->page = page;
+    victim->asid = asid;
+    victim->last_access = ++t->clock;
+}
+
+/**
+ * Charge a TLB with hits to a resident translation that were not looked up
+ * one by one, leaving it as if each had called tlb_lookup().
+ *
+ * @param t The TLB holding the translation.
+ * @param page The page number that was hit.
+ * @param asid The address space the page belongs to.
+ * @param count The number of hits.
+ */
+void tlb_charge_hits(TLB *t, uint64_t page, unsigned int asid,
+                     unsigned long long count)
+{
+    t->stat_access += count;
+    t->clock += count;
+
+    TLBEntry *entry = tlb_find(t, page, asid);
+    if (entry != NULL)
+    {
+        entry->last_access = t->clock;
+    }
+}
+
+/**
+ * Invalidate every translation held by a TLB.
+ *
+ * @param t The TLB to flush.
+ */
+void tlb_flush(TLB *t)
+{
+    for (uint64_t i = 0; i < t->num_sets * t->num_ways; i++)
+    {
+        t->entries[i].valid = false;
+    }
+}
+
+/**
+ * Print the statistics of the given TLB.
+ *
+ * @param t The TLB to print the statistics of.
+ * @param header A label for the TLB, which is used as a prefix for each
+ *               statistic.
+ */
+void tlb_print_stats(TLB *t, const char *header)
+{
+    double miss_percent = 0.0;
+    if (t->stat_access)
+    {
+        miss_percent = 100.0 * (double)(t->stat_miss) /
+                       (double)(t->stat_access);
+    }
+
+    printf("\n");
+    printf("%s_ACCESS          \t\t : %10llu\n", header, t->stat_access);
+    printf("%s_MISS            \t\t : %10llu\n", header, t->stat_miss);
+    printf("%s_MISS_PERC       \t\t : %10.3f\n", header, miss_percent);
+}
+
+/**
+ * Add the statistics of the given TLB to a registry.
+ *
+ * @param t The TLB to collect the statistics of.
+ * @param header A label for the TLB, which is used as a prefix for each
+ *               statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void tlb_collect_stats(TLB *t, const char *header, StatsRegistry *reg)
+{
+    double miss_percent = 0.0;
+    if (t->stat_access)
+    {
+        miss_percent = 100.0 * (double)(t->stat_miss) /
+                       (double)(t->stat_access);
+    }
+
+    stats_add_count(reg, header, "ACCESS", t->stat_access);
+    stats_add_count(reg, header, "MISS", t->stat_miss);
+    stats_add_real(reg, header, "MISS_PERC", miss_percent);
+}
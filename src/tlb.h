@@ -0,0 +1,119 @@
+// tlb.h
+// Declares a set-associative translation lookaside buffer (TLB), which caches
+// virtual-to-physical page translations for one or more cores. The same
+// structure also serves as a page-walk cache for upper-level page table
+// entries.
+
+#ifndef __TLB_H__
+#define __TLB_H__
+
+#include "types.h"
+#include "stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//                              DATA STRUCTURES                              //
+///////////////////////////////////////////////////////////////////////////////
+
+/** A single translation held by a TLB. */
+typedef struct TLBEntry
+{
+    bool valid;
+
+    /** The page number, at the granularity the TLB was filled with. */
+    uint64_t page;
+
+    /** The address space the translation belongs to. */
+    unsigned int asid;
+
+    /** Used for LRU replacement within the set. */
+    uint64_t last_access;
+} TLBEntry;
+
+/** A set-associative TLB with LRU replacement. */
+typedef struct TLB
+{
+    uint64_t num_sets;
+    uint64_t num_ways;
+
+    /** The entries, set by set. */
+    TLBEntry *entries;
+
+    /** A timestamp used for LRU replacement. */
+    uint64_t clock;
+
+    unsigned long long stat_access;
+    unsigned long long stat_miss;
+} TLB;
+
+///////////////////////////////////////////////////////////////////////////////
+//                            FUNCTION PROTOTYPES                            //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Allocate and initialize a TLB.
+ *
+ * @param entries The total number of entries.
+ * @param assoc The associativity. Equal to entries for a fully associative
+ *              TLB.
+ * @return A pointer to the TLB.
+ */
+TLB *tlb_new(uint64_t entries, uint64_t assoc);
+
+/**
+ * Look up the translation of a page, updating the LRU state on a hit.
+ *
+ * @param t The TLB to look in.
+ * @param page The page number to translate.
+ * @param asid The address space the page belongs to.
+ * @return Whether the translation was found.
+ */
+bool tlb_lookup(TLB *t, uint64_t page, unsigned int asid);
+
+/**
+ * Install the translation of a page, replacing the LRU entry of its set.
+ *
+ * @param t The TLB to install into.
+ * @param page The page number to install.
+ * @param asid The address space the page belongs to.
+ */
+void tlb_install(TLB *t, uint64_t page, unsigned int asid);
+
+/**
+ * Charge a TLB with hits to a resident translation that were not looked up
+ * one by one, leaving it as if each had called tlb_lookup().
+ *
+ * @param t The TLB holding the translation.
+ * @param page The page number that was hit.
+ * @param asid The address space the page belongs to.
+ * @param count The number of hits.
+ */
+void tlb_charge_hits(TLB *t, uint64_t page, unsigned int asid,
+                     unsigned long long count);
+
+/**
+ * Invalidate every translation held by a TLB.
+ *
+ * @param t The TLB to flush.
+ */
+void tlb_flush(TLB *t);
+
+/**
+ * Print the statistics of the given TLB.
+ *
+ * @param t The TLB to print the statistics of.
+ * @param header A label for the TLB, which is used as a prefix for each
+ *               statistic.
+ */
+void tlb_print_stats(TLB *t, const char *header);
+
+/**
+ * Add the statistics of the given TLB to a registry.
+ *
+ * @param t The TLB to collect the statistics of.
+ * @param header A label for the TLB, which is used as a prefix for each
+ *               statistic.
+ * @param reg The registry to add the statistics to.
+ */
+void tlb_collect_stats(TLB *t, const char *header, StatsRegistry *reg);
+
+#endif // __TLB_H__
@@ -10,6 +10,9 @@
 
 #include <inttypes.h>
 
+/** The maximum number of cores (and hence trace files) that can be simulated. */
+#define MAX_CORES 16
+
 /** Possible types of instructions. */
 typedef enum InstTypeEnum
 {